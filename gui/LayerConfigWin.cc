@@ -38,12 +38,14 @@ using namespace degate;
 
 LayerConfigWin::LayerConfigWin(Gtk::Window * parent,
 			       LogicModel_shptr lmodel,
-			       std::string const& project_dir) :
+			       std::string const& project_dir,
+			       MAP_STORAGE_TYPE tile_storage) :
   GladeFileLoader("layer_config.glade", "layer_config_dialog") {
 
   this->parent = parent;
   this->lmodel = lmodel;
   this->project_dir = project_dir;
+  this->tile_storage = tile_storage;
 
   if(get_dialog()) {
     //Get the Glade-instantiated Button, and connect a signal handler:
@@ -288,7 +290,7 @@ void LayerConfigWin::background_import_thread(image_list l) {
     assert(layer != NULL);
 
     debug(TM, "Load background image %s into layer at position %d.", filename.c_str(), layer->get_layer_pos());
-    load_background_image(layer, project_dir, filename);
+    load_background_image(layer, project_dir, filename, tile_storage);
     debug(TM, "Background image loaded.");
   }
 
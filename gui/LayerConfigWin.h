@@ -79,7 +79,8 @@ class LayerConfigWin : private GladeFileLoader {
 
   LayerConfigWin(Gtk::Window *parent,
 		 degate::LogicModel_shptr lmodel,
-		 std::string const& project_dir);
+		 std::string const& project_dir,
+		 degate::MAP_STORAGE_TYPE tile_storage = degate::MAP_STORAGE_TYPE_PERSISTENT_FILE);
 
   virtual ~LayerConfigWin();
 
@@ -100,6 +101,7 @@ class LayerConfigWin : private GladeFileLoader {
   Gtk::Window * parent;
   degate::LogicModel_shptr lmodel;
   std::string project_dir;
+  degate::MAP_STORAGE_TYPE tile_storage;
 
   InProgressWin * ipWin;
 
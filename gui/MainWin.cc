@@ -129,6 +129,7 @@ MainWin::MainWin() : render_window(editor), is_fullscreen(false) {
   signal_key_release_event().connect(sigc::mem_fun(*this,&MainWin::on_key_release_event_received), false);
   signal_hide().connect(sigc::mem_fun(*this, &MainWin::on_menu_project_close), false);
   signal_project_open_finished_.connect(sigc::mem_fun(*this, &MainWin::on_project_load_finished));
+  signal_bg_import_finished_.connect(sigc::mem_fun(*this, &MainWin::on_background_import_finished));
 
 }
 
@@ -634,7 +635,8 @@ void MainWin::update_gui_for_loaded_project(bool reverted) {
 
 
     lcWin = std::shared_ptr<LayerConfigWin>(new LayerConfigWin(this, main_project->get_logic_model(),
-							    main_project->get_project_directory()));
+							    main_project->get_project_directory(),
+							    main_project->get_tile_storage()));
     lcWin->signal_on_background_import_finished().connect
       (sigc::mem_fun(*this, &MainWin::on_background_import_finished));
 
@@ -1931,18 +1933,28 @@ void MainWin::on_menu_layer_import_background() {
 
   switch(result) {
   case(Gtk::RESPONSE_OK):
+    {
+      std::shared_ptr<ImageReaderBase<BackgroundImage> > reader;
+      try {
+	reader = get_image_reader<BackgroundImage>(filename);
+      }
+      catch(DegateRuntimeException const& ex) {
+	error_dialog("Error: Can't import the background image.", ex.what());
+	break;
+      }
 
-    assert(ipWin == NULL);
-    ipWin = std::shared_ptr<InProgressWin>
-      (new InProgressWin(this, "Importing",
-			 "Please wait while importing background image and calculating the prescaled images."));
-    ipWin->show();
-    project_changed();
-
-    signal_bg_import_finished_.connect(sigc::mem_fun(*this, &MainWin::on_background_import_finished));
-    Glib::Thread::create(sigc::bind<const Glib::ustring>
-			 (sigc::mem_fun(*this, &MainWin::background_import_thread), filename), false);
+      assert(ipWin == NULL);
+      ipWin = std::shared_ptr<InProgressWin>
+	(new InProgressWin(this, "Importing",
+			   "Please wait while importing background image and calculating the prescaled images.",
+			   reader));
+      ipWin->show();
+      project_changed();
 
+      thread_error_msg.clear();
+      Glib::Thread::create(sigc::bind<std::shared_ptr<ImageReaderBase<BackgroundImage> > >
+			   (sigc::mem_fun(*this, &MainWin::background_import_thread), reader), false);
+    }
     break;
   case(Gtk::RESPONSE_CANCEL):
     break;
@@ -1959,6 +1971,11 @@ void MainWin::on_background_import_finished() {
     ipWin->close();
     ipWin.reset();
   }
+
+  // The layer keeps its previous background image.
+  if(!thread_error_msg.empty())
+    error_dialog("Error: Can't import the background image.", thread_error_msg.c_str());
+
   //imgWin.unlock_renderer();
   //imgWin.update_screen();
   LogicModel_shptr lmodel = main_project->get_logic_model();
@@ -1971,12 +1988,19 @@ void MainWin::on_background_import_finished() {
 }
 
 
-void MainWin::background_import_thread(Glib::ustring bg_filename) {
+void MainWin::background_import_thread(std::shared_ptr<ImageReaderBase<BackgroundImage> > reader) {
   debug(TM, "Load background image.");
-  load_background_image(main_project->get_logic_model()->get_current_layer(),
-			main_project->get_project_directory(),
-			bg_filename);
-  debug(TM, "Background image loaded.");
+  try {
+    load_background_image(main_project->get_logic_model()->get_current_layer(),
+			  main_project->get_project_directory(),
+			  reader,
+			  main_project->get_tile_storage());
+    debug(TM, "Background image loaded.");
+  }
+  catch(std::exception const& ex) {
+    debug(TM, "Background image import failed: %s", ex.what());
+    if(!reader->is_canceled()) thread_error_msg = ex.what();
+  }
   signal_bg_import_finished_();
 }
 
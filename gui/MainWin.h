@@ -40,6 +40,7 @@ along with degate. If not, see <http://www.gnu.org/licenses/>.
 #include "LayerConfigWin.h"
 #include <EMarker.h>
 #include <degate.h>
+#include <ImageReaderBase.h>
 #include <AutoNameGates.h>
 #include <BoundingBox.h>
 
@@ -243,7 +244,7 @@ class MainWin : public Gtk::Window  {
   void set_widget_sensitivity(bool state);
 
   void project_open_thread(Glib::ustring project_dir);
-  void background_import_thread(Glib::ustring bg_filename);
+  void background_import_thread(std::shared_ptr<degate::ImageReaderBase<degate::BackgroundImage> > reader);
 
   void algorithm_calc_thread(int slot_pos);
 
@@ -50,7 +50,8 @@ BinaryLineDetection::BinaryLineDetection(unsigned int _min_x, unsigned int _max_
   blur_kernel_size(_blur_kernel_size),
   border(_blur_kernel_size >> 1),
   sigma(_sigma),
-  has_path(false) {
+  has_path(false),
+  tiled(true) {
 
     setup_pipe();
 
@@ -63,7 +64,10 @@ TileImage_GS_DOUBLE_shptr BinaryLineDetection::run(ImageBase_shptr img_in,
 						std::string const& directory) {
 
   set_directory(directory);
+
+  pipe.set_streaming(tiled);
   grayImage = std::dynamic_pointer_cast<TileImage_GS_DOUBLE>(pipe.run(img_in));
+
   save_normalized_image<TileImage_GS_DOUBLE>("/tmp/gray.tif", grayImage);
 
   TileImage_GS_DOUBLE_shptr binOtsu, binMean1_0, binMean1_1, binMean1_2;
@@ -106,10 +110,10 @@ TileImage_GS_DOUBLE_shptr BinaryLineDetection::run(ImageBase_shptr img_in,
 void BinaryLineDetection::setup_pipe() {
 
   debug(TM, "will extract background image (%d, %d) (%d, %d)", min_x, min_y, max_x, max_y);
-  std::shared_ptr<IPCopy<TileImage_RGBA, TileImage_GS_DOUBLE> > copy_rgba_to_gs
-    (new IPCopy<TileImage_RGBA, TileImage_GS_DOUBLE>(min_x, max_x, min_y, max_y));
+  std::shared_ptr<IPCopy<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE> > copy_gs
+    (new IPCopy<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>(min_x, max_x, min_y, max_y));
 
-  pipe.add(copy_rgba_to_gs);
+  pipe.add(copy_gs);
 
   if(median_filter_width > 0) {
     std::shared_ptr<IPMedianFilter<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE> > median_filter
@@ -161,6 +165,18 @@ void BinaryLineDetection::set_directory(std::string const& path) {
   has_path = true;
 }
 
+void BinaryLineDetection::set_tiled(bool tiled) {
+  this->tiled = tiled;
+}
+
+bool BinaryLineDetection::is_tiled() const {
+  return tiled;
+}
+
+TileImage_GS_DOUBLE_shptr BinaryLineDetection::get_gray_image() const {
+  return grayImage;
+}
+
 TileImage_GS_DOUBLE_shptr BinaryLineDetection::gs_to_binary(TileImage_GS_DOUBLE_shptr gray) {
 
   Otsu o;
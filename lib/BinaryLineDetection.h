@@ -42,6 +42,7 @@ namespace degate {
     unsigned int blur_kernel_size, border;
     double sigma;
     bool has_path;
+    bool tiled;
 
     TileImage_GS_DOUBLE_shptr grayImage;
     TileImage_GS_DOUBLE_shptr binImage;
@@ -66,6 +67,23 @@ namespace degate {
     bool has_directory() const;
 
     void set_directory(std::string const& path);
+
+    /**
+     * Enable or disable the tiled execution. In tiled mode the pipe runs
+     * its stages fused in strips of tiles with an overlap for the filter
+     * kernels, and the strips are processed in parallel. Only the median
+     * filtered region is kept, because the normalization needs its
+     * extrema. The tiled mode is enabled by default. The results are the
+     * same.
+     * @see IPPipe::set_streaming()
+     */
+    void set_tiled(bool tiled);
+    bool is_tiled() const;
+
+    /**
+     * Get the greyscale image of the last run.
+     */
+    TileImage_GS_DOUBLE_shptr get_gray_image() const;
 		
     TileImage_GS_DOUBLE_shptr gs_to_binary(TileImage_GS_DOUBLE_shptr gray);
     TileImage_GS_DOUBLE_shptr gs_by_mean(TileImage_GS_DOUBLE_shptr gray, double scale);
@@ -84,6 +102,11 @@ namespace degate {
 
     ~BinaryLineDetection();
 
+    /**
+     * Run the line detection.
+     * @param img_in A greyscale image of type TileImage_GS_DOUBLE. Use the
+     *   greyscale cache of the layer's scaling manager to get one.
+     */
     TileImage_GS_DOUBLE_shptr run(ImageBase_shptr img_in,
 				TileImage_GS_DOUBLE_shptr probability_map,
 				std::string const& directory);
@@ -23,6 +23,8 @@
 #include <FileSystem.h>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
 
 using namespace degate;
 
@@ -35,6 +37,19 @@ size_t Configuration::get_max_tile_cache_size() const {
   return boost::lexical_cast<size_t>(cs);
 }
 
+unsigned int Configuration::get_max_worker_threads() const {
+  char * n = getenv("DEGATE_THREADS");
+  unsigned int threads = n == NULL ?
+    boost::thread::hardware_concurrency() : boost::lexical_cast<unsigned int>(n);
+  return std::max(threads, 1U);
+}
+
+unsigned int Configuration::get_prefetch_threads() const {
+  char * n = getenv("DEGATE_PREFETCH_THREADS");
+  if(n == NULL) return 2;
+  return boost::lexical_cast<unsigned int>(n);
+}
+
 std::string Configuration::get_servers_uri_pattern() const {
   char * uri_pattern = getenv("DEGATE_SERVER_URI_PATTERN");
   if(uri_pattern == NULL) return "http://localhost/cgi-bin/test.pl?channel=%1%";
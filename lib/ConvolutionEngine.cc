@@ -0,0 +1,84 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <ConvolutionEngine.h>
+#include <PixelKernels.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace degate;
+
+ConvolutionEngine::ConvolutionEngine(FilterKernel_shptr kernel, bool allow_separation) :
+  rows(kernel->get_rows()),
+  columns(kernel->get_columns()),
+  mirrored(rows * columns),
+  separable(false) {
+
+  for(unsigned int j = 0; j < rows; j++)
+    for(unsigned int i = 0; i < columns; i++)
+      mirrored[j * columns + i] = kernel->get(columns - 1 - i, rows - 1 - j);
+
+  if(allow_separation) {
+    terms = kernel->get_separable_terms();
+
+    // A separated term needs rows + columns multiplications per value.
+    separable = terms.size() * (rows + columns) < rows * columns;
+
+    for(std::vector<FilterKernel::separable_term>::iterator iter = terms.begin();
+	iter != terms.end(); ++iter) {
+      std::reverse(iter->column.begin(), iter->column.end());
+      std::reverse(iter->row.begin(), iter->row.end());
+    }
+  }
+}
+
+void ConvolutionEngine::convolve_row(std::vector<double const *> const& src_rows, unsigned int n,
+				     double * out, std::vector<double> & scratch) const {
+
+  assert(src_rows.size() == rows);
+
+  std::fill(out, out + n, 0);
+  if(n == 0) return;
+
+  if(!separable) {
+    for(unsigned int i = 0; i < columns; i++)
+      for(unsigned int j = 0; j < rows; j++)
+	add_scaled_row(src_rows[j] + i, mirrored[j * columns + i], out, n);
+    return;
+  }
+
+  const unsigned int src_n = n + columns - 1;
+  scratch.resize(src_n);
+
+  for(std::vector<FilterKernel::separable_term>::const_iterator iter = terms.begin();
+      iter != terms.end(); ++iter) {
+
+    // Vertical pass over the source rows.
+    std::fill(scratch.begin(), scratch.end(), 0);
+    for(unsigned int j = 0; j < rows; j++)
+      add_scaled_row(src_rows[j], iter->column[j], &scratch[0], src_n);
+
+    // Horizontal pass over the intermediate row.
+    for(unsigned int i = 0; i < columns; i++)
+      add_scaled_row(&scratch[i], iter->row[i], out, n);
+  }
+}
@@ -0,0 +1,91 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __CONVOLUTIONENGINE_H__
+#define __CONVOLUTIONENGINE_H__
+
+#include <FilterKernel.h>
+
+#include <vector>
+#include <memory>
+
+namespace degate {
+
+  /**
+   * The ConvolutionEngine convolves rows of double values with a filter kernel.
+   *
+   * If the kernel is a sum of few separable kernels, each term is
+   * calculated with a vertical pass over the source rows and a
+   * horizontal pass over the intermediate row. Otherwise the kernel
+   * is applied directly. Both passes work on contiguous rows with
+   * the SIMD pixel kernels.
+   *
+   * The direct calculation sums up in the same order as a plain loop
+   * over the kernel columns and rows. The results are exactly the same.
+   */
+  class ConvolutionEngine {
+
+  private:
+
+    unsigned int rows, columns;
+
+    // The kernel is mirrored, so that kernel and rows are walked
+    // in the same direction.
+    std::vector<double> mirrored;
+    std::vector<FilterKernel::separable_term> terms;
+    bool separable;
+
+  public:
+
+    /**
+     * Create an engine for a kernel.
+     * @param allow_separation If false, the kernel is always applied directly.
+     */
+    ConvolutionEngine(FilterKernel_shptr kernel, bool allow_separation = true);
+
+    /**
+     * Check if the separated kernel is used.
+     */
+    bool is_separable() const {
+      return separable;
+    }
+
+    /**
+     * Calculate \p n values of an output row.
+     * @param src_rows Pointers to the source rows, one for each kernel row.
+     *   The first pointer belongs to the top kernel row. The pointers
+     *   point to the column of the left kernel column for output value 0.
+     *   Each row must provide \p n + kernel columns - 1 values.
+     * @param n The number of output values.
+     * @param out The output values.
+     * @param scratch A buffer for intermediate values. Each thread
+     *   needs its own buffer.
+     */
+    void convolve_row(std::vector<double const *> const& src_rows, unsigned int n,
+		      double * out, std::vector<double> & scratch) const;
+  };
+
+  typedef std::shared_ptr<ConvolutionEngine> ConvolutionEngine_shptr;
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <FFT.h>
+#include <degate_exceptions.h>
+
+#include <math.h>
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+using namespace degate;
+
+
+unsigned int degate::get_fft_size(unsigned int n) {
+  unsigned int size = 1;
+  while(size < n) size <<= 1;
+  return size;
+}
+
+
+/**
+ * Calculate the twiddle factors exp(-2 pi i k / n) for k < n / 2 and the
+ * bit reversal permutation for a transform of length \p n.
+ */
+static void prepare_1d(unsigned int n,
+		       std::vector<complex_t> & twiddles,
+		       std::vector<unsigned int> & reversed) {
+
+  if(n == 0 || (n & (n - 1)) != 0) {
+    boost::format fmter("Error in FFT2D(): The size %1% is not a power of two.");
+    fmter % n;
+    throw DegateRuntimeException(fmter.str());
+  }
+
+  twiddles.resize(n / 2);
+  for(unsigned int k = 0; k < n / 2; k++)
+    twiddles[k] = std::polar(1.0, -2.0 * M_PI * k / n);
+
+  unsigned int bits = 0;
+  while((1U << bits) < n) bits++;
+
+  reversed.resize(n);
+  for(unsigned int i = 0; i < n; i++) {
+    unsigned int r = 0;
+    for(unsigned int b = 0; b < bits; b++)
+      if(i & (1 << b)) r |= 1 << (bits - 1 - b);
+    reversed[i] = r;
+  }
+}
+
+
+FFT2D::FFT2D(unsigned int _width, unsigned int _height) :
+  width(_width), height(_height) {
+
+  prepare_1d(width, twiddles_x, reversed_x);
+  prepare_1d(height, twiddles_y, reversed_y);
+}
+
+
+void FFT2D::transform_1d(complex_t * data, unsigned int n,
+			 std::vector<complex_t> const& twiddles,
+			 std::vector<unsigned int> const& reversed,
+			 bool inverse) const {
+
+  for(unsigned int i = 0; i < n; i++)
+    if(i < reversed[i]) std::swap(data[i], data[reversed[i]]);
+
+  // Iterative radix 2 butterflies.
+  for(unsigned int len = 2; len <= n; len <<= 1) {
+    const unsigned int half = len >> 1;
+    const unsigned int twiddle_step = n / len;
+
+    for(unsigned int start = 0; start < n; start += len)
+      for(unsigned int k = 0; k < half; k++) {
+	complex_t w = twiddles[k * twiddle_step];
+	if(inverse) w = std::conj(w);
+
+	complex_t a = data[start + k];
+	complex_t b = data[start + k + half] * w;
+	data[start + k] = a + b;
+	data[start + k + half] = a - b;
+      }
+  }
+}
+
+
+void FFT2D::transform(complex_t * data, bool inverse) const {
+
+  for(unsigned int y = 0; y < height; y++)
+    transform_1d(data + y * width, width, twiddles_x, reversed_x, inverse);
+
+  // Columns are copied into a contiguous buffer, which is much more
+  // cache friendly than butterflies on strided data.
+  std::vector<complex_t> column(height);
+  for(unsigned int x = 0; x < width; x++) {
+    for(unsigned int y = 0; y < height; y++) column[y] = data[y * width + x];
+    transform_1d(&column[0], height, twiddles_y, reversed_y, inverse);
+    for(unsigned int y = 0; y < height; y++) data[y * width + x] = column[y];
+  }
+}
@@ -0,0 +1,86 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace degate {
+
+  typedef std::complex<double> complex_t;
+
+  /**
+   * Get the smallest power of two, that is not less than \p n.
+   */
+  unsigned int get_fft_size(unsigned int n);
+
+  /**
+   * A two dimensional fast fourier transform for a fixed size. The width
+   * and height must be powers of two. The twiddle factors and the bit
+   * reversal permutation are calculated once in the constructor, so an
+   * FFT2D object should be reused for transforms of the same size.
+   *
+   * The object is not modified by transforms. It can be used by multiple
+   * threads at the same time.
+   */
+  class FFT2D {
+
+  private:
+
+    unsigned int width, height;
+
+    std::vector<complex_t> twiddles_x, twiddles_y;
+    std::vector<unsigned int> reversed_x, reversed_y;
+
+    /**
+     * Transform \p n contiguous elements in place.
+     */
+    void transform_1d(complex_t * data, unsigned int n,
+		      std::vector<complex_t> const& twiddles,
+		      std::vector<unsigned int> const& reversed,
+		      bool inverse) const;
+
+  public:
+
+    /**
+     * Prepare transforms of the size \p width x \p height.
+     * @exception DegateRuntimeException This exception is thrown, if
+     *   a dimension is not a power of two.
+     */
+    FFT2D(unsigned int width, unsigned int height);
+
+    unsigned int get_width() const { return width; }
+    unsigned int get_height() const { return height; }
+
+    /**
+     * Transform a block of width x height values in place. The values are
+     * stored row by row. The inverse transform is not normalized, so a
+     * forward and an inverse transform scale the data by width * height.
+     */
+    void transform(complex_t * data, bool inverse = false) const;
+  };
+
+}
+
+#endif
@@ -106,6 +106,10 @@ void degate::remove_directory(std::string const& path) {
   boost::filesystem::remove_all(path);
 }
 
+void degate::rename_file(std::string const& old_path, std::string const& new_path) {
+  boost::filesystem::rename(old_path, new_path);
+}
+
 void degate::create_directory(std::string const& directory) {
   boost::filesystem::create_directory(directory);
 }
@@ -127,6 +127,11 @@ namespace degate{
    */
   void remove_directory(std::string const& path);
 
+  /**
+   * Rename a file or a directory. An existing file \p new_path is replaced.
+   */
+  void rename_file(std::string const& old_path, std::string const& new_path);
+
 
   /**
    * Create a directory.
@@ -1,5 +1,44 @@
 #include <FilterKernel.h>
 #include <memory>
+#include <algorithm>
 
 using namespace degate;
 
+std::vector<FilterKernel::separable_term> FilterKernel::get_separable_terms(double tolerance) const {
+
+  std::vector<separable_term> terms;
+  std::vector<double> residual(data);
+
+  double max_value = 0;
+  for(std::vector<double>::const_iterator iter = data.begin(); iter != data.end(); ++iter)
+    max_value = std::max(max_value, fabs(*iter));
+
+  if(max_value == 0) return terms;
+
+  for(unsigned int n = 0; n < std::min(rows, columns); n++) {
+
+    // Take the largest remaining value as pivot.
+    unsigned int pivot = 0;
+    for(unsigned int i = 1; i < residual.size(); i++)
+      if(fabs(residual[i]) > fabs(residual[pivot])) pivot = i;
+
+    const double p = residual[pivot];
+    if(fabs(p) <= tolerance * max_value) break;
+
+    const unsigned int pivot_column = pivot % columns, pivot_row = pivot / columns;
+
+    separable_term t;
+    t.column.resize(rows);
+    t.row.resize(columns);
+    for(unsigned int y = 0; y < rows; y++) t.column[y] = residual[y * columns + pivot_column];
+    for(unsigned int x = 0; x < columns; x++) t.row[x] = residual[pivot_row * columns + x] / p;
+
+    for(unsigned int y = 0; y < rows; y++)
+      for(unsigned int x = 0; x < columns; x++)
+	residual[y * columns + x] -= t.column[y] * t.row[x];
+
+    terms.push_back(t);
+  }
+
+  return terms;
+}
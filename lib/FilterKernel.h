@@ -36,6 +36,17 @@ namespace degate {
 
   class FilterKernel {
 
+  public:
+
+    /**
+     * A kernel, that is the outer product of a column vector and
+     * a row vector: k(x, y) = column[y] * row[x].
+     */
+    struct separable_term {
+      std::vector<double> column;
+      std::vector<double> row;
+    };
+
   private:
     unsigned int columns, rows;
     std::vector<double> data;
@@ -74,6 +85,27 @@ namespace degate {
       data[row * columns + column] = val;
     }
 
+    /**
+     * Split the kernel into a sum of separable kernels.
+     *
+     * The decomposition is calculated by a Gaussian elimination with
+     * complete pivoting. It stops, if the remaining kernel values are
+     * negligible. A Gaussian or a Sobel kernel results in a single term.
+     * A LoG kernel results in two terms.
+     *
+     * @param tolerance Remaining values are negligible, if their magnitude
+     *   is below this fraction of the largest kernel value.
+     * @return Returns the terms. The list is empty for a kernel of zeros.
+     */
+    std::vector<separable_term> get_separable_terms(double tolerance = 1e-10) const;
+
+    /**
+     * Check if the kernel is the outer product of a column and a row vector.
+     */
+    bool is_separable(double tolerance = 1e-10) const {
+      return get_separable_terms(tolerance).size() == 1;
+    }
+
     void print() const {
       unsigned int x, y;
       for(y = 0; y < columns; y++) {
@@ -22,10 +22,12 @@
 
 #include <degate.h>
 #include <GateLibrary.h>
+#include <PreparedTemplateCache.h>
 
 using namespace degate;
 
-GateLibrary::GateLibrary() {
+GateLibrary::GateLibrary() :
+  prepared_templates(new PreparedTemplateCache()) {
 }
 
 GateLibrary::~GateLibrary() {
@@ -44,6 +46,7 @@ void GateLibrary::cloneDeepInto(DeepCopyable_shptr dest, oldnew_t *oldnew) const
 
 void GateLibrary::remove_template(GateTemplate_shptr gate_template) {
   templates.erase(gate_template->get_object_id());
+  prepared_templates->invalidate(gate_template->get_object_id());
 }
 
 void GateLibrary::add_template(GateTemplate_shptr gate_template) {
@@ -52,8 +55,10 @@ void GateLibrary::add_template(GateTemplate_shptr gate_template) {
   if(!gate_template->has_valid_object_id())
     throw InvalidObjectIDException("Can't add a gate template to the gate library, "
 				   "if the template has no valid object ID.");
-  else
+  else {
     templates[gate_template->get_object_id()] = gate_template;
+    prepared_templates->invalidate(gate_template->get_object_id());
+  }
 }
 
 bool GateLibrary::exists_template(object_id_t id) const {
@@ -140,6 +145,10 @@ GateLibrary::const_template_iterator GateLibrary::end() const {
 }
 
 
+PreparedTemplateCache_shptr GateLibrary::get_prepared_template_cache() const {
+  return prepared_templates;
+}
+
 void GateLibrary::print(std::ostream & os) {
   for(template_iterator iter = begin(); iter != end(); ++iter) {
     GateTemplate_shptr tmpl = (*iter).second;
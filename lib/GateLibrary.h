@@ -51,6 +51,8 @@ namespace degate {
 
     gate_lib_collection_t templates;
 
+    PreparedTemplateCache_shptr prepared_templates;
+
   public:
 
     /**
@@ -150,6 +152,13 @@ namespace degate {
 
     const_template_iterator end() const;
 
+    /**
+     * Get the cache for template images, that are prepared for template
+     * matching.
+     */
+
+    PreparedTemplateCache_shptr get_prepared_template_cache() const;
+
     /**
      * print the gate library.
      */
@@ -35,15 +35,15 @@ void GateTemplate::decrement_reference_counter() {
 
 
 GateTemplate::GateTemplate(int _min_x, int _max_x, int _min_y, int _max_y) :
-  bounding_box(_min_x, _max_x, _min_y, _max_y), reference_counter(0) {
+  bounding_box(_min_x, _max_x, _min_y, _max_y), reference_counter(0), image_revision(0) {
 }
 
 GateTemplate::GateTemplate(unsigned int width, unsigned int height) :
-  bounding_box(0, width, 0, height), reference_counter(0) {
+  bounding_box(0, width, 0, height), reference_counter(0), image_revision(0) {
 }
 
 GateTemplate::GateTemplate() :
-  bounding_box(0, 0, 0, 0), reference_counter(0) {
+  bounding_box(0, 0, 0, 0), reference_counter(0), image_revision(0) {
 }
 
 
@@ -72,6 +72,7 @@ void GateTemplate::cloneDeepInto(DeepCopyable_shptr dest, oldnew_t *oldnew) cons
   
   // images
   clone->images = images;
+  clone->image_revision = image_revision;
   
   ColoredObject::cloneDeepInto(dest, oldnew);
   LogicModelObjectBase::cloneDeepInto(dest, oldnew);
@@ -102,6 +103,7 @@ void GateTemplate::set_image(Layer::LAYER_TYPE layer_type, GateTemplateImage_shp
   if(img == NULL) throw InvalidPointerException("Invalid pointer for image.");
   debug(TM, "set image for template.");
   images[layer_type] = img;
+  image_revision++;
 }
 
 
@@ -116,6 +118,10 @@ bool GateTemplate::has_image(Layer::LAYER_TYPE layer_type) const {
   return images.find(layer_type) != images.end();
 }
 
+unsigned int GateTemplate::get_image_revision() const {
+  return image_revision;
+}
+
 void GateTemplate::add_template_port(GateTemplatePort_shptr template_port) {
   if(!template_port->has_valid_object_id())
     throw InvalidObjectIDException("Error in GateTemplate::add_template_port(). "
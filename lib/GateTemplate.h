@@ -67,6 +67,7 @@ namespace degate {
 
     BoundingBox bounding_box;
     unsigned int reference_counter;
+    unsigned int image_revision;
 
     std::set<GateTemplatePort_shptr, LMOCompare> ports;
 
@@ -190,6 +191,14 @@ namespace degate {
 
     virtual bool has_image(Layer::LAYER_TYPE layer_type) const;
 
+    /**
+     * Get a counter, that is incremented, whenever a reference image is set.
+     * Data, that is derived from the reference images, is outdated, if
+     * the counter changed.
+     */
+
+    virtual unsigned int get_image_revision() const;
+
     /**
      * Add a template port to a gate template.
      * This is an isolated function. The port is just added to the gate template.
@@ -0,0 +1,268 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __GREYSCALEIMAGECACHE_H__
+#define __GREYSCALEIMAGECACHE_H__
+
+#include "Image.h"
+#include "ImageManipulation.h"
+#include "BoundingBox.h"
+#include "Configuration.h"
+#include "WorkerThreads.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+namespace degate {
+
+  /**
+   * The GreyscaleImageCache keeps greyscaled versions of the prescaled
+   * images of a ScalingManager. There is an 8 bit version and a
+   * double version with values normalized to the range [0, 1].
+   *
+   * The images are stored in tile files next to the master image. They
+   * have the size of the scaling levels and are filled lazily: a tile is
+   * converted, when it is requested the first time. Tiles are invalidated,
+   * if a region of the master image is modified.
+   *
+   * The cache can be used from multiple threads.
+   */
+  template<class ImageType>
+  class GreyscaleImageCache {
+
+  public:
+
+    typedef std::map<double, std::shared_ptr<ImageType> > image_map;
+
+  private:
+
+    template<typename GSImageType>
+    struct derived_image {
+      std::shared_ptr<GSImageType> img;
+      std::vector<char> valid; // flags converted tiles
+    };
+
+    struct level {
+      std::shared_ptr<ImageType> src;
+      unsigned int tile_size, tiles_x, tiles_y;
+      derived_image<TileImage_GS_BYTE> gs_byte;
+      derived_image<TileImage_GS_DOUBLE> gs_double;
+    };
+
+    struct tile_task {
+      unsigned int tile_x, tile_y;
+    };
+
+    std::string directory;
+    std::map<unsigned int, level> levels;
+    boost::mutex mtx;
+
+  private:
+
+    static void normalize_row(gs_byte_pixel_t *, unsigned int) {}
+
+    static void normalize_row(gs_double_pixel_t * row, unsigned int n) {
+      for(unsigned int i = 0; i < n; i++) row[i] /= 255.0;
+    }
+
+    /**
+     * Convert a tile.
+     */
+    template<typename GSImageType>
+    static void convert_tile(std::shared_ptr<ImageType> src,
+			     std::shared_ptr<GSImageType> dst,
+			     unsigned int tile_size,
+			     std::vector<tile_task> const& tasks,
+			     size_t i) {
+
+      typedef typename GSImageType::pixel_type pixel_type;
+      TileView<pixel_type> view;
+
+      unsigned int
+	min_x = tasks[i].tile_x * tile_size,
+	min_y = tasks[i].tile_y * tile_size,
+	max_x = std::min(min_x + tile_size, src->get_width()),
+	max_y = std::min(min_y + tile_size, src->get_height());
+
+      for(unsigned int y = min_y; y < max_y; y++) {
+	dst->get_writable_tile_view(min_x, y, view);
+	read_row<pixel_type>(src, min_x, y, max_x - min_x, view.get_ptr(min_x, y));
+	normalize_row(view.get_ptr(min_x, y), max_x - min_x);
+      }
+    }
+
+    /**
+     * Get a derived image and convert the missing tiles in a region.
+     */
+    template<typename GSImageType>
+    std::shared_ptr<GSImageType> get_derived_image(derived_image<GSImageType> level::* member,
+						   char const * name,
+						   unsigned int scaling,
+						   BoundingBox const& region) {
+
+      boost::mutex::scoped_lock lock(mtx);
+
+      typename std::map<unsigned int, level>::iterator found = levels.find(scaling);
+      if(found == levels.end())
+	throw DegateRuntimeException("There is no scaling level for the requested greyscale image.");
+
+      level & l = found->second;
+      derived_image<GSImageType> & d = l.*member;
+
+      if(d.img == NULL) {
+	char dir_name[PATH_MAX];
+	snprintf(dir_name, sizeof(dir_name), "%s_%d.dimg", name, scaling);
+	d.img = std::shared_ptr<GSImageType>
+	  (new GSImageType(l.src->get_width(), l.src->get_height(),
+			   join_pathes(directory, dir_name), false,
+			   l.src->get_tile_width_exp()));
+	d.valid.assign(l.tiles_x * l.tiles_y, 0);
+      }
+
+      std::vector<tile_task> tasks;
+      unsigned int x0, x1, y0, y1;
+      if(get_tile_range(l, region, x0, x1, y0, y1))
+	for(unsigned int y = y0; y <= y1; y++)
+	  for(unsigned int x = x0; x <= x1; x++)
+	    if(!d.valid[y * l.tiles_x + x]) {
+	      tile_task t = { x, y };
+	      tasks.push_back(t);
+	    }
+
+      if(!tasks.empty()) {
+	debug(TM, "convert %d tiles of scaling level %d to %s",
+	      tasks.size(), scaling, name);
+
+	// The tiles stay invalid, if an exception is thrown.
+	run_parallel_for(Configuration::get_instance().get_max_worker_threads(), tasks.size(),
+			 boost::bind(&GreyscaleImageCache<ImageType>::template convert_tile<GSImageType>,
+				     l.src, d.img, l.tile_size, boost::cref(tasks), _1));
+
+	BOOST_FOREACH(tile_task const& t, tasks) d.valid[t.tile_y * l.tiles_x + t.tile_x] = 1;
+      }
+
+      return d.img;
+    }
+
+    /**
+     * Get the range of tiles, that cover a region of a scaling level.
+     * @return Returns false, if the region is outside of the level.
+     */
+    static bool get_tile_range(level const& l, BoundingBox const& region,
+			       unsigned int & x0, unsigned int & x1,
+			       unsigned int & y0, unsigned int & y1) {
+
+      if(l.tiles_x == 0 || l.tiles_y == 0 ||
+	 region.get_max_x() < 0 || region.get_max_y() < 0) return false;
+
+      x0 = std::min<unsigned int>(std::max(region.get_min_x(), 0) / l.tile_size, l.tiles_x - 1);
+      x1 = std::min<unsigned int>(region.get_max_x() / l.tile_size, l.tiles_x - 1);
+      y0 = std::min<unsigned int>(std::max(region.get_min_y(), 0) / l.tile_size, l.tiles_y - 1);
+      y1 = std::min<unsigned int>(region.get_max_y() / l.tile_size, l.tiles_y - 1);
+      return true;
+    }
+
+  public:
+
+    /**
+     * Create a cache for prescaled images.
+     * @param images The scaling levels of the ScalingManager.
+     * @param directory The directory, where the cached images are
+     *   stored. The images are not persistent.
+     */
+    GreyscaleImageCache(image_map const& images, std::string const& directory) :
+      directory(directory) {
+
+      for(typename image_map::const_iterator iter = images.begin(); iter != images.end(); ++iter) {
+	level & l = levels[lrint(iter->first)];
+	l.src = iter->second;
+	l.tile_size = l.src->get_tile_size();
+	l.tiles_x = (l.src->get_width() + l.tile_size - 1) / l.tile_size;
+	l.tiles_y = (l.src->get_height() + l.tile_size - 1) / l.tile_size;
+      }
+    }
+
+    /**
+     * Get the 8 bit greyscale image of a scaling level.
+     * @param scaling The scaling factor of the level.
+     * @param region The region, that must be valid. It is given in
+     *   coordinates of the scaling level.
+     * @return Returns an image with the size of the scaling level.
+     *   Pixels outside of \p region might not be converted yet.
+     * @exception DegateRuntimeException This exception is thrown, if there
+     *   is no such scaling level.
+     */
+    TileImage_GS_BYTE_shptr get_gs_byte_image(unsigned int scaling, BoundingBox const& region) {
+      return get_derived_image<TileImage_GS_BYTE>(&level::gs_byte, "greyscale", scaling, region);
+    }
+
+    /**
+     * Get the greyscale image of a scaling level with pixel values in
+     * the range [0, 1].
+     * @see get_gs_byte_image()
+     */
+    TileImage_GS_DOUBLE_shptr get_gs_double_image(unsigned int scaling, BoundingBox const& region) {
+      return get_derived_image<TileImage_GS_DOUBLE>(&level::gs_double, "greyscale_double",
+						    scaling, region);
+    }
+
+    /**
+     * Invalidate the tiles of all levels, that cover a modified
+     * region of the master image.
+     * @param region The modified region in coordinates of the master image.
+     */
+    void invalidate(BoundingBox const& region) {
+
+      boost::mutex::scoped_lock lock(mtx);
+
+      for(typename std::map<unsigned int, level>::iterator iter = levels.begin();
+	  iter != levels.end(); ++iter) {
+
+	level & l = iter->second;
+	BoundingBox scaled(region.get_min_x() / (int)iter->first,
+			   region.get_max_x() / (int)iter->first,
+			   region.get_min_y() / (int)iter->first,
+			   region.get_max_y() / (int)iter->first);
+
+	unsigned int x0, x1, y0, y1;
+	if(get_tile_range(l, scaled, x0, x1, y0, y1))
+	  for(unsigned int y = y0; y <= y1; y++)
+	    for(unsigned int x = x0; x <= x1; x++) {
+	      if(!l.gs_byte.valid.empty()) l.gs_byte.valid[y * l.tiles_x + x] = 0;
+	      if(!l.gs_double.valid.empty()) l.gs_double.valid[y * l.tiles_x + x] = 0;
+	    }
+      }
+    }
+
+  };
+
+  /**
+   * A typedef for greyscale caches of background images.
+   */
+  typedef std::shared_ptr<GreyscaleImageCache<BackgroundImage> > GreyscaleImageCache_shptr;
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include <string>
 #include <ImageProcessorBase.h>
 #include <FilterKernel.h>
+#include <ConvolutionEngine.h>
 
 namespace degate {
 
@@ -33,11 +34,14 @@ namespace degate {
    */
 
   template<typename ImageTypeIn, typename ImageTypeOut>
-  class IPConvolve : public ImageProcessorBase {
+  class IPConvolve : public TypedImageProcessor<ImageTypeIn, ImageTypeOut> {
 
   private:
     FilterKernel_shptr kernel;
 
+    // The convolution for a streamed run.
+    ConvolutionEngine_shptr engine;
+
   public:
 
     /**
@@ -45,11 +49,9 @@ namespace degate {
      */
 
     IPConvolve(FilterKernel_shptr _kernel) :
-      ImageProcessorBase("IPConvolve",
-			 "Convolve an image.",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPConvolve",
+						     "Convolve an image.",
+						     false),
 	kernel(_kernel) { }
 
     /**
@@ -77,6 +79,43 @@ namespace degate {
       return img_out;
     }
 
+    virtual bool is_streamable() const {
+      return TypedImageProcessor<ImageTypeIn, ImageTypeOut>::has_double_pixels();
+    }
+
+    virtual unsigned int get_rows_before() const {
+      return kernel->get_center_row();
+    }
+
+    virtual unsigned int get_rows_after() const {
+      return kernel->get_rows() - 1 - kernel->get_center_row();
+    }
+
+    virtual void prepare_streaming(ImageBase_shptr in, unsigned int in_width, unsigned int in_height) {
+      engine = ConvolutionEngine_shptr(new ConvolutionEngine(kernel));
+    }
+
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {
+
+      const unsigned int
+	rows = kernel->get_rows(), columns = kernel->get_columns(),
+	center_row = kernel->get_center_row(), center_column = kernel->get_center_column();
+
+      // convolve() leaves the image empty, if it is smaller than the kernel.
+      if(in_height < rows || in_width < columns ||
+	 y < center_row || y >= in_height - center_row) {
+	std::fill(out, out + out_width, 0);
+	return;
+      }
+
+      // The same calculation as in convolve().
+      std::fill(out, out + out_width, 0);
+      engine->convolve_row(in, in_width - 2 * center_column, out + center_column, scratch);
+    }
+
 
   };
 
@@ -32,7 +32,7 @@ namespace degate {
    */
 
   template<typename ImageTypeIn, typename ImageTypeOut>
-  class IPCopy : public ImageProcessorBase {
+  class IPCopy : public TypedImageProcessor<ImageTypeIn, ImageTypeOut> {
 
   private:
 
@@ -46,11 +46,9 @@ namespace degate {
      */
 
     IPCopy() :
-      ImageProcessorBase("IPCopy",
-			 "Copy an image with pixel type auto conversion",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPCopy",
+						     "Copy an image with pixel type auto conversion",
+						     false),
       work_on_region(false) { }
 
     /**
@@ -58,11 +56,9 @@ namespace degate {
      */
 
     IPCopy(unsigned int _min_x, unsigned int _max_x, unsigned int _min_y, unsigned int _max_y) :
-      ImageProcessorBase("IPCopy",
-			 "Copy an image with pixel type auto conversion",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPCopy",
+						     "Copy an image with pixel type auto conversion",
+						     false),
       min_x(_min_x),
       max_x(_max_x),
       min_y(_min_y),
@@ -108,6 +104,42 @@ namespace degate {
       return img_out;
     }
 
+    /**
+     * The input is converted, when it is read. Therefore only the
+     * output must have double pixels.
+     */
+    virtual bool is_streamable() const {
+      return typeid(typename ImageTypeOut::pixel_type) == typeid(gs_double_pixel_t);
+    }
+
+    virtual unsigned int get_row_offset() const {
+      return work_on_region ? min_y : 0;
+    }
+
+    virtual void get_output_size(unsigned int in_width, unsigned int in_height,
+				 unsigned int & out_width, unsigned int & out_height) const {
+      out_width = work_on_region ? max_x - min_x : in_width;
+      out_height = work_on_region ? max_y - min_y : in_height;
+    }
+
+    virtual void get_input_columns(unsigned int in_width,
+				   unsigned int & _min_x, unsigned int & _max_x) const {
+      _min_x = work_on_region ? std::min(min_x, in_width) : 0;
+      _max_x = work_on_region ? std::min(max_x, in_width) : in_width;
+    }
+
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {
+
+      unsigned int first = 0, last = 0;
+      get_input_columns(in_width, first, last);
+      unsigned int n = in[0] == NULL ? 0 : std::min(last - first, out_width);
+
+      if(n > 0) std::copy(in[0] + first, in[0] + first + n, out);
+      std::fill(out + n, out + out_width, 0);
+    }
 
   };
 
@@ -33,7 +33,7 @@ namespace degate {
    */
 
   template<typename ImageTypeIn, typename ImageTypeOut>
-  class IPMedianFilter : public ImageProcessorBase {
+  class IPMedianFilter : public TypedImageProcessor<ImageTypeIn, ImageTypeOut> {
 
   private:
 
@@ -46,11 +46,9 @@ namespace degate {
      */
 
     IPMedianFilter(unsigned int _median_filter_width = 3) :
-      ImageProcessorBase("IPNormalize",
-			 "Normalize an image.",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPNormalize",
+						     "Normalize an image.",
+						     false),
       median_filter_width(_median_filter_width) { }
 
 
@@ -72,6 +70,52 @@ namespace degate {
       return img_out;
     }
 
+    virtual bool is_streamable() const {
+      return TypedImageProcessor<ImageTypeIn, ImageTypeOut>::has_double_pixels();
+    }
+
+    virtual unsigned int get_rows_before() const {
+      return median_filter_width / 2;
+    }
+
+    virtual unsigned int get_rows_after() const {
+      return median_filter_width - 1 - median_filter_width / 2;
+    }
+
+    virtual void prepare_streaming(ImageBase_shptr in, unsigned int in_width, unsigned int in_height) {
+      // The same checks as in filter_image().
+      if(median_filter_width <= 1)
+	throw DegateRuntimeException("Error in filter_image(). Kernel width is to small.");
+      if(in_width < median_filter_width || in_height < median_filter_width)
+	throw DegateRuntimeException("Error in filter_image(). One of the images is to small.");
+    }
+
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {
+
+      const unsigned int k = median_filter_width, kc = k / 2;
+
+      // The filtered area is the same as in filter_image(). The border is 0.
+      if(y < kc || y >= in_height - (k - kc)) {
+	std::fill(out, out + out_width, 0);
+	return;
+      }
+
+      scratch.resize(k * k);
+      for(unsigned int x = 0; x < out_width; x++) {
+	if(x < kc || x >= in_width - (k - kc)) out[x] = 0;
+	else {
+	  unsigned int i = 0;
+	  for(unsigned int j = 0; j < k; j++)
+	    for(unsigned int _x = x - kc; _x < x - kc + k; _x++, i++)
+	      scratch[i] = in[j][_x];
+	  out[x] = median<double>(scratch);
+	}
+      }
+    }
+
 
   };
 
@@ -33,12 +33,16 @@ namespace degate {
    */
 
   template<typename ImageTypeIn, typename ImageTypeOut>
-  class IPNormalize : public ImageProcessorBase {
+  class IPNormalize : public TypedImageProcessor<ImageTypeIn, ImageTypeOut> {
 
   private:
     double lower_bound;
     double upper_bound;
 
+    // Parameters of a streamed run.
+    bool flat;
+    double shift, factor;
+
   public:
 
     /**
@@ -46,13 +50,12 @@ namespace degate {
      */
 
     IPNormalize(double _lower_bound = 0, double _upper_bound = 1) :
-      ImageProcessorBase("IPNormalize",
-			 "Normalize an image.",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPNormalize",
+						     "Normalize an image.",
+						     false),
       lower_bound(_lower_bound),
-      upper_bound(_upper_bound) { }
+      upper_bound(_upper_bound),
+      flat(true), shift(0), factor(0) { }
 
     /**
      * The destructor.
@@ -79,6 +82,47 @@ namespace degate {
       return img_out;
     }
 
+    virtual bool is_streamable() const {
+      return TypedImageProcessor<ImageTypeIn, ImageTypeOut>::has_double_pixels();
+    }
+
+    /**
+     * The extrema of the input image are needed.
+     */
+    virtual bool needs_complete_input() const {
+      return true;
+    }
+
+    virtual void prepare_streaming(ImageBase_shptr in, unsigned int in_width, unsigned int in_height) {
+
+      std::shared_ptr<ImageTypeIn> img_in = std::dynamic_pointer_cast<ImageTypeIn>(in);
+      assert(img_in != NULL);
+
+      typename ImageTypeIn::pixel_type src_min = get_minimum<ImageTypeIn>(img_in);
+      typename ImageTypeIn::pixel_type src_max = get_maximum<ImageTypeIn>(img_in);
+
+      // As in normalize(): a flat image is not written.
+      flat = src_max - src_min == 0;
+      shift = -src_min;
+      factor = flat ? 0 : (double)(upper_bound - lower_bound) / (double)(src_max - src_min);
+    }
+
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {
+
+      for(unsigned int x = 0; x < out_width; x++) {
+	if(flat || in[0] == NULL) out[x] = 0;
+	else {
+	  double d = (in[0][x] + shift) * factor + lower_bound;
+	  if(d < lower_bound && lower_bound - d < 0.001) d = lower_bound;
+	  else if(d > upper_bound && d - upper_bound < 0.001) d = upper_bound;
+	  out[x] = d;
+	}
+      }
+    }
+
 
   };
 
@@ -23,13 +23,24 @@
 #define __IPPIPE_H__
 
 #include <string>
+#include <vector>
 #include <ImageProcessorBase.h>
 #include <ProgressControl.h>
+#include <Configuration.h>
+#include <WorkerThreads.h>
+
+#include <boost/bind.hpp>
 
 namespace degate {
 
   /**
    * Represents an image processing pipe for multiple image processors.
+   *
+   * Consecutive streamable processors are run fused: the output image
+   * is calculated in horizontal strips, and each strip pulls the rows
+   * it needs through all processors. Only a few rows per processor are
+   * kept, instead of a complete intermediate image. The strips are
+   * processed in parallel.
    */
 
 
@@ -40,13 +51,160 @@ namespace degate {
     typedef std::list<std::shared_ptr<ImageProcessorBase> > processor_list_type;
     processor_list_type processor_list;
 
+    bool streaming;
+
+    typedef std::vector<ImageProcessorBase_shptr> stage_list;
+
+    /**
+     * The common data of a streamed run. Level 0 is the input image,
+     * level l is the output of stage l - 1.
+     */
+    struct stream_job {
+      stage_list stages;
+      ImageBase_shptr img_in, img_out;
+      std::vector<unsigned int> widths, heights;
+      unsigned int strip_height, num_strips;
+    };
+
+    /**
+     * The row buffers of a single strip. Rows are calculated on demand.
+     * Each level keeps the rows, that its consumer needs for one row.
+     * The input row pointers and the scratch buffers of the stages are
+     * kept for the whole strip.
+     */
+    class stream_strip {
+
+    private:
+
+      stream_job const& job;
+      std::vector<std::vector<std::vector<double> > > ring;
+      std::vector<int> next_row;
+      std::vector<std::vector<double const *> > input_rows;
+      std::vector<std::vector<double> > scratch;
+
+    public:
+
+      stream_strip(stream_job const& _job) : job(_job) {
+
+	const size_t num_levels = job.stages.size() + 1;
+	ring.resize(num_levels);
+	next_row.assign(num_levels, -1);
+	input_rows.resize(job.stages.size());
+	scratch.resize(job.stages.size());
+
+	for(size_t l = 0; l < num_levels; l++) {
+	  size_t ring_size = l + 1 < num_levels ?
+	    job.stages[l]->get_rows_before() + job.stages[l]->get_rows_after() + 1 : 1;
+	  ring[l].assign(ring_size, std::vector<double>(job.widths[l]));
+	}
+      }
+
+      /**
+       * Get a row of a level. Rows must be requested in ascending order
+       * within the window of the consumer.
+       * @return Returns a NULL pointer, if the row is outside of the image.
+       */
+      double const * get_row(size_t l, int y) {
+
+	if(y < 0 || y >= (int)job.heights[l]) return NULL;
+
+	if(next_row[l] < 0) next_row[l] = y;
+	assert(y >= next_row[l] - (int)ring[l].size());
+
+	for(; next_row[l] <= y; next_row[l]++)
+	  calc_row(l, next_row[l], &ring[l][next_row[l] % ring[l].size()][0]);
+
+	return &ring[l][y % ring[l].size()][0];
+      }
+
+    private:
+
+      void calc_row(size_t l, int y, double * out) {
+
+	if(l == 0) {
+	  // Columns, that the first stage does not read, are 0.
+	  unsigned int min_x = 0, max_x = 0;
+	  job.stages[0]->get_input_columns(job.widths[0], min_x, max_x);
+	  std::fill(out, out + job.widths[0], 0);
+	  if(max_x > min_x)
+	    job.stages[0]->read_input_row(job.img_in, min_x, y, max_x - min_x, out + min_x);
+	  return;
+	}
+
+	ImageProcessorBase_shptr stage = job.stages[l - 1];
+	int first = (int)stage->get_row_offset() + y - (int)stage->get_rows_before();
+	unsigned int n = stage->get_rows_before() + stage->get_rows_after() + 1;
+
+	std::vector<double const *> & rows = input_rows[l - 1];
+	rows.resize(n);
+	for(unsigned int j = 0; j < n; j++) rows[j] = get_row(l - 1, first + j);
+
+	stage->process_row(rows, y, job.widths[l - 1], job.heights[l - 1], job.widths[l], out,
+			   scratch[l - 1]);
+      }
+    };
+
+
+    /**
+     * Calculate a strip of the output image.
+     */
+    static void process_strip(stream_job const& job, size_t i) {
+
+      const size_t last = job.stages.size();
+      stream_strip strip(job);
+      unsigned int
+	min_y = i * job.strip_height,
+	max_y = std::min(min_y + job.strip_height, job.heights[last]);
+
+      for(unsigned int y = min_y; y < max_y; y++)
+	job.stages.back()->write_output_row(job.img_out, y, job.widths[last], strip.get_row(last, y));
+    }
+
+    /**
+     * Run streamable processors fused.
+     */
+    ImageBase_shptr run_streamed(stage_list const& stages, ImageBase_shptr img_in) {
+
+      stream_job job;
+      job.stages = stages;
+      job.img_in = img_in;
+      job.widths.push_back(img_in->get_width());
+      job.heights.push_back(img_in->get_height());
+
+      for(size_t l = 0; l < stages.size(); l++) {
+	unsigned int w = 0, h = 0;
+	stages[l]->get_output_size(job.widths[l], job.heights[l], w, h);
+	stages[l]->prepare_streaming(stages[l]->needs_complete_input() ? img_in : ImageBase_shptr(),
+				     job.widths[l], job.heights[l]);
+	job.widths.push_back(w);
+	job.heights.push_back(h);
+      }
+
+      const unsigned int w = job.widths.back(), h = job.heights.back();
+      job.img_out = stages.back()->create_output_image(w, h);
+      if(w == 0 || h == 0) return job.img_out;
+
+      // Strips are aligned to the tile rows of the output image, so that
+      // threads write to different tiles.
+      const unsigned int num_threads = Configuration::get_instance().get_max_worker_threads();
+      const unsigned int alignment = stages.back()->get_output_row_alignment(job.img_out);
+      unsigned int strip_height = std::max(32u, (h + 4 * num_threads - 1) / (4 * num_threads));
+      job.strip_height = (strip_height + alignment - 1) / alignment * alignment;
+      job.num_strips = (h + job.strip_height - 1) / job.strip_height;
+
+      run_parallel_for(num_threads, job.num_strips,
+		       boost::bind(&IPPipe::process_strip, boost::cref(job), _1));
+
+      return job.img_out;
+    }
+
   public:
 
     /**
      * The constructor for a processing pipe.
      */
 
-    IPPipe() {
+    IPPipe() : streaming(true) {
     }
 
     /**
@@ -85,6 +243,21 @@ namespace degate {
 
 
 
+    /**
+     * Enable or disable the fused execution of streamable processors.
+     * It is enabled by default. The results are the same.
+     */
+    void set_streaming(bool streaming) {
+      this->streaming = streaming;
+    }
+
+    /**
+     * Check if streamable processors are run fused.
+     */
+    bool is_streaming() const {
+      return streaming;
+    }
+
     /**
      * Start processing.
      */
@@ -93,6 +266,7 @@ namespace degate {
       assert(img_in != NULL);
 
       ImageBase_shptr last_img = img_in;
+      stage_list segment;
 
       // iterate over list
       for(processor_list_type::iterator iter = processor_list.begin();
@@ -100,11 +274,21 @@ namespace degate {
 
 	ImageProcessorBase_shptr ip = *iter;
 
+	// A processor, that needs its complete input, starts a new segment.
+	if(!segment.empty() &&
+	   (!streaming || !ip->is_streamable() || ip->needs_complete_input())) {
+	  last_img = run_streamed(segment, last_img);
+	  segment.clear();
+	}
+
 	assert(last_img != NULL);
-	last_img = ip->run(last_img);
+	if(streaming && ip->is_streamable()) segment.push_back(ip);
+	else last_img = ip->run(last_img);
 	assert(last_img != NULL);
       }
 
+      if(!segment.empty()) last_img = run_streamed(segment, last_img);
+
       return last_img;
     }
 
@@ -33,7 +33,7 @@ namespace degate {
    */
 
   template<typename ImageTypeIn, typename ImageTypeOut>
-  class IPThresholding : public ImageProcessorBase {
+  class IPThresholding : public TypedImageProcessor<ImageTypeIn, ImageTypeOut> {
 
   private:
     double threshold;
@@ -45,11 +45,9 @@ namespace degate {
      */
 
     IPThresholding(double _threshold = 0.5) :
-      ImageProcessorBase("IPThresholding",
-			 "Binarize an image.",
-			 false,
-			 typeid(typename ImageTypeIn::pixel_type),
-			 typeid(typename ImageTypeOut::pixel_type)),
+      TypedImageProcessor<ImageTypeIn, ImageTypeOut>("IPThresholding",
+						     "Binarize an image.",
+						     false),
       threshold(_threshold) { }
 
     /**
@@ -77,6 +75,18 @@ namespace degate {
       return img_out;
     }
 
+    virtual bool is_streamable() const {
+      return TypedImageProcessor<ImageTypeIn, ImageTypeOut>::has_double_pixels();
+    }
+
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {
+      for(unsigned int x = 0; x < out_width; x++)
+	out[x] = in[0] != NULL && in[0][x] >= threshold ? 1 : 0;
+    }
+
 
   };
 
@@ -230,12 +230,25 @@ namespace degate {
 	  unsigned int _height,
 	  std::string const& directory,
 	  bool persistent = true,
-	  unsigned int _tile_width_exp = 10) :
+	  unsigned int _tile_width_exp = 10,
+	  MAP_STORAGE_TYPE _tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE) :
       ImageBase(_width, _height),
       StoragePolicy_Tile<PixelPolicy>(_width, _height,
 				      directory,
 				      persistent,
-				      _tile_width_exp) {}
+				      _tile_width_exp,
+				      _tile_storage) {}
+
+    /**
+     * Constructor for a downscaled level of a pack file based image.
+     */
+
+    Image(unsigned int _width,
+	  unsigned int _height,
+	  TilePackFile_shptr pack,
+	  unsigned int level) :
+      ImageBase(_width, _height),
+      StoragePolicy_Tile<PixelPolicy>(_width, _height, pack, level) {}
 
     /**
      * The dtor.
@@ -275,6 +288,12 @@ namespace degate {
   typedef std::shared_ptr<TileImage_GS_DOUBLE> TileImage_GS_DOUBLE_shptr;
   typedef std::shared_ptr<TileImage_GS_BYTE> TileImage_GS_BYTE_shptr;
 
+  typedef Image<PixelPolicy_SUM_UINT32, StoragePolicy_Tile> TileImage_SUM_UINT32;
+  typedef Image<PixelPolicy_SUM_INT64, StoragePolicy_Tile> TileImage_SUM_INT64;
+
+  typedef std::shared_ptr<TileImage_SUM_UINT32> TileImage_SUM_UINT32_shptr;
+  typedef std::shared_ptr<TileImage_SUM_INT64> TileImage_SUM_INT64_shptr;
+
 
   typedef Image<PixelPolicy_RGBA, StoragePolicy_Tile> BackgroundImage;
   typedef std::shared_ptr<BackgroundImage> BackgroundImage_shptr;
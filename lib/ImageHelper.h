@@ -37,56 +37,96 @@ namespace degate {
 
 
   /**
-   * Load an image in a common image format, such as tiff.
+   * Get a reader for an image in a common image format, such as tiff. The
+   * reader has already parsed the image's meta data, such as width and height.
    * @exception InvalidPathException Thrown if, path does not exists.
    * @exception DegateRuntimeException This exception is thrown, if there is
-   *   no matching image importer or if the import failed.
+   *   no matching image importer or if the image file cannot be parsed.
    */
 
   template<typename ImageType>
-  std::shared_ptr<ImageType> load_image(std::string const& path) {
+  std::shared_ptr<ImageReaderBase<ImageType> > get_image_reader(std::string const& path) {
     if(!file_exists(path)) {
       boost::format fmter("Error in load_image(): file %1% does not exist.");
       fmter % path;
       throw InvalidPathException(fmter.str());
     }
-    else {
+
+    // get a reader
+    ImageReaderFactory<ImageType> ir_factory;
+    std::shared_ptr<ImageReaderBase<ImageType> > reader = ir_factory.get_reader(path);
+
+    if(reader->read() == false) {
       boost::format fmter("Error in load_image(): The image file %1% cannot be loaded.");
       fmter % path;
+      throw DegateRuntimeException(fmter.str());
+    }
 
-      // get a reader
-      ImageReaderFactory<ImageType> ir_factory;
-      std::shared_ptr<ImageReaderBase<ImageType> > reader = ir_factory.get_reader(path);
+    return reader;
+  }
 
-      if(reader->read() == false) {
-	throw DegateRuntimeException(fmter.str());
-      }
-      else {
+  /**
+   * Load an image from an image reader into an existing degate image.
+   * Like copy_image(), only the region is written, which is present in the image
+   * file and in \p img. The reader reports the progress of the operation and can
+   * be canceled.
+   * @exception InvalidPointerException This exception is thrown, if parameter
+   *   \p reader or \p img represents an invalid pointer.
+   * @exception DegateRuntimeException This exception is thrown, if the import
+   *   failed or was canceled.
+   * @see get_image_reader()
+   */
 
-	debug(TM, "reading image file: %s", path.c_str());
+  template<typename ImageType>
+  void load_image(std::shared_ptr<ImageReaderBase<ImageType> > reader,
+		  std::shared_ptr<ImageType> img) {
 
-	// create an empty image
-	std::shared_ptr<ImageType> img(new ImageType(reader->get_width(),
-							  reader->get_height()));
-	if(reader->get_image(img) == true)
-	  return img;
-	else
-	  throw DegateRuntimeException(fmter.str());
-      }
+    if(reader == NULL || img == NULL) throw InvalidPointerException("invalid pointer");
+
+    debug(TM, "reading image file: %s", reader->get_filename().c_str());
+
+    // The reader writes directly into the image. There is no temporary
+    // copy of the whole image.
+    if(reader->get_image(img) == false) {
+      boost::format fmter("Error in load_image(): The image file %1% cannot be loaded.");
+      fmter % reader->get_filename();
+      throw DegateRuntimeException(fmter.str());
     }
   }
 
+  /**
+   * Load an image in a common image format, such as tiff.
+   * @exception InvalidPathException Thrown if, path does not exists.
+   * @exception DegateRuntimeException This exception is thrown, if there is
+   *   no matching image importer or if the import failed.
+   */
+
+  template<typename ImageType>
+  std::shared_ptr<ImageType> load_image(std::string const& path) {
+
+    std::shared_ptr<ImageReaderBase<ImageType> > reader = get_image_reader<ImageType>(path);
+
+    // create an empty image
+    std::shared_ptr<ImageType> img(new ImageType(reader->get_width(),
+						 reader->get_height()));
+    load_image<ImageType>(reader, img);
+    return img;
+  }
+
   /**
    * Load an image in a common image format, such as tiff, into an existing degate image.
+   * Like copy_image(), only the region is written, which is present in the image
+   * file and in \p img.
    * @exception InvalidPointerException This exception is thrown, if parameter \p img represents an invalid pointer.
+   * @exception InvalidPathException This exception is thrown, if the file does not exist.
+   * @exception DegateRuntimeException This exception is thrown, if the image file cannot be read.
    */
 
   template<typename ImageType>
   void load_image(std::string const& path, std::shared_ptr<ImageType> img) {
 
     if(img == NULL) throw InvalidPointerException("invalid image pointer");
-    std::shared_ptr<ImageType> i = load_image<ImageType>(path);
-    copy_image<ImageType, ImageType>(img, i);
+    load_image<ImageType>(get_image_reader<ImageType>(path), img);
   }
 
 
@@ -27,8 +27,15 @@
 #include <FilterKernel.h>
 #include <Statistics.h>
 #include <ImageStatistics.h>
+#include <PixelKernels.h>
+#include <ConvolutionEngine.h>
+#include <WorkerThreads.h>
 
 #include <boost/format.hpp>
+#include <boost/bind.hpp>
+
+#include <vector>
+#include <algorithm>
 
 namespace degate {
 
@@ -174,6 +181,35 @@ namespace degate {
   }
 
 
+  /**
+   * Convert \p n pixels from a source type to a destination type.
+   * The default implementation uses convert_pixel() for each pixel.
+   */
+  template<typename PixelTypeDst, typename PixelTypeSrc>
+  inline void convert_pixels(PixelTypeSrc const * src, PixelTypeDst * dst, size_t n) {
+    for(size_t i = 0; i < n; i++)
+      dst[i] = convert_pixel<PixelTypeDst, PixelTypeSrc>(src[i]);
+  }
+
+  /**
+   * Convert pixels from rgba -> byte with the SIMD kernels.
+   */
+  template<>
+  inline void convert_pixels<gs_byte_pixel_t, rgba_pixel_t>(rgba_pixel_t const * src,
+							     gs_byte_pixel_t * dst, size_t n) {
+    convert_rgba_to_gs_byte(src, dst, n);
+  }
+
+  /**
+   * Convert pixels from rgba -> double with the SIMD kernels.
+   */
+  template<>
+  inline void convert_pixels<gs_double_pixel_t, rgba_pixel_t>(rgba_pixel_t const * src,
+							       gs_double_pixel_t * dst, size_t n) {
+    convert_rgba_to_gs_double(src, dst, n);
+  }
+
+
 
 
 
@@ -197,6 +233,55 @@ namespace degate {
   }
 
 
+  /**
+   * Read \p width pixels of row \p y starting at column \p x from an image
+   * into a buffer. The pixel values are converted into \p PixelTypeDst.
+   * The caller must make sure, that the row segment is within the image.
+   */
+  template<typename PixelTypeDst, typename ImageTypeSrc>
+  void read_row(std::shared_ptr<ImageTypeSrc> src,
+		unsigned int x, unsigned int y, unsigned int width,
+		PixelTypeDst * dst) {
+
+    typedef typename ImageTypeSrc::pixel_type pixel_type;
+    TileView<pixel_type> view;
+    unsigned int max_x = x + width;
+
+    while(x < max_x) {
+      src->get_tile_view(x, y, view);
+      unsigned int n = std::min(max_x, view.get_max_x()) - x;
+      convert_pixels<PixelTypeDst, pixel_type>(view.get_ptr(x, y), dst, n);
+
+      dst += n;
+      x += n;
+    }
+  }
+
+  /**
+   * Write \p width pixels from a buffer into row \p y of an image, starting
+   * at column \p x. The pixel values are converted into the image's pixel type.
+   * The caller must make sure, that the row segment is within the image.
+   */
+  template<typename PixelTypeSrc, typename ImageTypeDst>
+  void write_row(std::shared_ptr<ImageTypeDst> dst,
+		 unsigned int x, unsigned int y, unsigned int width,
+		 PixelTypeSrc const * src) {
+
+    typedef typename ImageTypeDst::pixel_type pixel_type;
+    TileView<pixel_type> view;
+    unsigned int max_x = x + width;
+
+    while(x < max_x) {
+      dst->get_writable_tile_view(x, y, view);
+      unsigned int n = std::min(max_x, view.get_max_x()) - x;
+      convert_pixels<pixel_type, PixelTypeSrc>(src, view.get_ptr(x, y), n);
+
+      src += n;
+      x += n;
+    }
+  }
+
+
   /**
    * Copy an image.
    * Copy the source image into the destination image. If the images differ in
@@ -213,9 +298,15 @@ namespace degate {
     unsigned int h = std::min(src->get_height(), dst->get_height());
     unsigned int w = std::min(src->get_width(), dst->get_width());
 
+    src->prefetch(0, w, 0, h);
+    TileView<typename ImageTypeDst::pixel_type> view;
+
+    // Read source rows directly into the destination memory.
     for(unsigned int y = 0; y < h; y++)
-      for(unsigned int x = 0; x < w; x++)
-	dst->set_pixel(x, y, src->template get_pixel_as<typename ImageTypeDst::pixel_type>(x, y));
+      for(unsigned int x = 0; x < w; x = view.get_max_x()) {
+	dst->get_writable_tile_view(x, y, view);
+	read_row(src, x, y, std::min(w, view.get_max_x()) - x, view.get_ptr(x, y));
+      }
   }
 
 
@@ -233,16 +324,22 @@ namespace degate {
     assert(min_x < max_x);
     assert(min_y < max_y);
 
-    unsigned int h = std::min(std::min(std::min(src->get_height(), max_y), dst->get_height()), max_y - min_y);
-    unsigned int w = std::min(std::min(std::min(src->get_width(), max_x), dst->get_width()), max_x - min_x);
-
-    unsigned int dst_x = 0, dst_y = 0, x, y;
-
-    for(y = min_y; y < min_y + h; y++, dst_y++) {
-      for(x = min_x, dst_x = 0; x < min_x + w; x++, dst_x++)
-	dst->set_pixel(dst_x, dst_y,
-		       src->template get_pixel_as<typename ImageTypeDst::pixel_type>(x, y));
-    }
+    // Only the part of the region within the source image is copied.
+    unsigned int h = std::min(std::min(dst->get_height(), max_y - min_y),
+			      src->get_height() > min_y ? src->get_height() - min_y : 0);
+    unsigned int w = std::min(std::min(dst->get_width(), max_x - min_x),
+			      src->get_width() > min_x ? src->get_width() - min_x : 0);
+    if(w == 0 || h == 0) return;
+
+    src->prefetch(min_x, min_x + w, min_y, min_y + h);
+    TileView<typename ImageTypeDst::pixel_type> view;
+
+    for(unsigned int dst_y = 0; dst_y < h; dst_y++)
+      for(unsigned int dst_x = 0; dst_x < w; dst_x = view.get_max_x()) {
+	dst->get_writable_tile_view(dst_x, dst_y, view);
+	read_row(src, min_x + dst_x, min_y + dst_y,
+		 std::min(w, view.get_max_x()) - dst_x, view.get_ptr(dst_x, dst_y));
+      }
   }
 
   /**
@@ -300,38 +397,63 @@ namespace degate {
 
 
   /**
-   * Scale a source image down by factor 2.
-   * You can scale images in place.
+   * Scale a region of a source image down by factor 2. The region is
+   * given in coordinates of the destination image. Only the destination
+   * region is written. Regions, that do not overlap, can be scaled from
+   * different threads.
    */
   template<typename ImageTypeDst, typename ImageTypeSrc>
   void scale_down_by_2(std::shared_ptr<ImageTypeDst> dst,
-		       std::shared_ptr<ImageTypeSrc> src) {
-
-
-    unsigned int dst_x, dst_y, src_x, src_y;
-
-    for(dst_y = 0; dst_y < dst->get_height(); dst_y++) {
-
-      src_y = dst_y * 2;
+		       std::shared_ptr<ImageTypeSrc> src,
+		       unsigned int min_x, unsigned int max_x,
+		       unsigned int min_y, unsigned int max_y) {
+
+    unsigned int src_w = src->get_width();
+    unsigned int src_h = src->get_height();
+    max_x = std::min(max_x, std::min(dst->get_width(), (src_w + 1) / 2));
+    max_y = std::min(max_y, std::min(dst->get_height(), (src_h + 1) / 2));
+    if(min_x >= max_x || min_y >= max_y) return;
+
+    // The source columns, that are covered by the region.
+    unsigned int src_min_x = min_x * 2;
+    unsigned int src_cols = std::min(max_x * 2, src_w) - src_min_x;
+
+    // Source rows are read before the destination row is written. That
+    // makes in place scaling possible, because row dst_y is never above
+    // the source rows 2 * dst_y and 2 * dst_y + 1.
+    std::vector<rgba_pixel_t> row0(src_cols), row1(src_cols), out(max_x - min_x);
+
+    for(unsigned int dst_y = min_y; dst_y < max_y; dst_y++) {
+
+      unsigned int src_y = dst_y * 2;
+      bool has_row1 = src_y + 1 < src_h;
+
+      read_row(src, src_min_x, src_y, src_cols, &row0[0]);
+      if(has_row1) read_row(src, src_min_x, src_y + 1, src_cols, &row1[0]);
+
+      // Full 2x2 blocks are averaged with the SIMD kernel. Only the last
+      // column and the last row may need the generic code below.
+      unsigned int dst_x = min_x;
+      if(has_row1) {
+	unsigned int n = std::min(max_x, src_w / 2) - min_x;
+	average_rgba_2x2(&row0[0], &row1[0], &out[0], n);
+	dst_x += n;
+      }
 
-      for(dst_x = 0; dst_x < dst->get_width(); dst_x++) {
+      for(; dst_x < max_x; dst_x++) {
 
-	src_x = dst_x * 2;
+	unsigned int src_x = dst_x * 2 - src_min_x;
+	bool has_col1 = dst_x * 2 + 1 < src_w;
 
 	// 1 2
 	// 3 4
 
-	int i = 1;
-	unsigned int r = 0, g = 0, b = 0, a = 0;
-
-	rgba_pixel_t pix = src->template get_pixel_as<rgba_pixel_t>(src_x, src_y);
-	r += MASK_R(pix);
-	g += MASK_G(pix);
-	b += MASK_B(pix);
-	a += MASK_A(pix);
+	unsigned int i = 1;
+	rgba_pixel_t pix = row0[src_x];
+	unsigned int r = MASK_R(pix), g = MASK_G(pix), b = MASK_B(pix), a = MASK_A(pix);
 
-	if(src_x + 1 < src->get_width()) {
-	  pix = src->template get_pixel_as<rgba_pixel_t>(src_x + 1, src_y);
+	if(has_col1) {
+	  pix = row0[src_x + 1];
 	  i++;
 	  r += MASK_R(pix);
 	  g += MASK_G(pix);
@@ -339,8 +461,8 @@ namespace degate {
 	  a += MASK_A(pix);
 	}
 
-	if(src_y + 1 < src->get_height()) {
-	  pix = src->template get_pixel_as<rgba_pixel_t>(src_x, src_y + 1);
+	if(has_row1) {
+	  pix = row1[src_x];
 	  i++;
 	  r += MASK_R(pix);
 	  g += MASK_G(pix);
@@ -348,8 +470,8 @@ namespace degate {
 	  a += MASK_A(pix);
 	}
 
-	if(src_x + 1 < src->get_width() && src_y + 1 < src->get_height()) {
-	  pix = src->template get_pixel_as<rgba_pixel_t>(src_x + 1, src_y + 1);
+	if(has_col1 && has_row1) {
+	  pix = row1[src_x + 1];
 	  i++;
 	  r += MASK_R(pix);
 	  g += MASK_G(pix);
@@ -362,11 +484,25 @@ namespace degate {
 	b /= i;
 	a /= i;
 
-	dst->template set_pixel_as<rgba_pixel_t>(dst_x, dst_y, MERGE_CHANNELS(r, g, b, a));
+	out[dst_x - min_x] = MERGE_CHANNELS(r, g, b, a);
       }
+
+      write_row(dst, min_x, dst_y, max_x - min_x, &out[0]);
     }
   }
 
+  /**
+   * Scale a source image down by factor 2.
+   * You can scale images in place.
+   */
+  template<typename ImageTypeDst, typename ImageTypeSrc>
+  void scale_down_by_2(std::shared_ptr<ImageTypeDst> dst,
+		       std::shared_ptr<ImageTypeSrc> src) {
+    scale_down_by_2<ImageTypeDst, ImageTypeSrc>(dst, src,
+						0, dst->get_width(),
+						0, dst->get_height());
+  }
+
 
   /**
    * Scale a source image down by factor 2.
@@ -389,10 +525,9 @@ namespace degate {
       std::shared_ptr<ImageTypeDst> tmp(new ImageTypeDst(src->get_width(), src->get_height()));
       copy_image<ImageTypeDst, ImageTypeSrc>(tmp, src);
 
-      scaling >>= 1;
-      for(unsigned int i = 0; i < scaling - 1; i*=2) {
+      // Scale in place, until one step is left.
+      for(scaling >>= 1; scaling > 1; scaling >>= 1)
 	scale_down_by_2<ImageTypeDst, ImageTypeDst>(tmp, tmp);
-      }
       scale_down_by_2<ImageTypeDst, ImageTypeDst>(dst, tmp);
     }
 
@@ -404,9 +539,14 @@ namespace degate {
   template<typename ImageType>
   void clear_image(std::shared_ptr<ImageType> img) {
 
+    TileView<typename ImageType::pixel_type> view;
+
     for(unsigned int y = 0; y < img->get_height(); y++)
-      for(unsigned int x = 0; x < img->get_width(); x++)
-	img->set_pixel(x, y, 0);
+      for(unsigned int x = 0; x < img->get_width(); x = view.get_max_x()) {
+	img->get_writable_tile_view(x, y, view);
+	typename ImageType::pixel_type * p = view.get_ptr(x, y);
+	std::fill(p, p + std::min(img->get_width(), view.get_max_x()) - x, 0);
+      }
   }
 
 
@@ -528,11 +668,58 @@ namespace degate {
     }
   }
 
+  /**
+   * Convolve the rows first <= y < second of a band of an image. This is
+   * a helper function for convolve().
+   */
+  template<typename ImageTypeDst, typename ImageTypeSrc>
+  void convolve_rows(std::shared_ptr<ImageTypeDst> dst,
+		     std::shared_ptr<ImageTypeSrc> src,
+		     FilterKernel_shptr kernel,
+		     ConvolutionEngine const& engine,
+		     std::vector<std::pair<unsigned int, unsigned int> > const& bands,
+		     size_t band) {
+
+    unsigned int w = std::min(src->get_width(), dst->get_width());
+
+    unsigned int rows = kernel->get_rows();
+    unsigned int center_row = kernel->get_center_row();
+    unsigned int center_column = kernel->get_center_column();
+
+    unsigned int min_y = bands[band].first, max_y = bands[band].second;
+
+    // A ring buffer with the source rows, that are covered by the kernel.
+    std::vector<std::vector<double> > ring(rows, std::vector<double>(w));
+    std::vector<double const *> src_rows(rows);
+    std::vector<double> out(w), scratch;
+
+    for(unsigned int j = 0; j < rows - 1; j++)
+      read_row(src, 0, min_y - center_row + j, w, &ring[(min_y - center_row + j) % rows][0]);
+
+    for(unsigned int y = min_y; y < max_y; y++) {
+
+      unsigned int first_row = y - center_row;
+      unsigned int last_row = first_row + rows - 1;
+      read_row(src, 0, last_row, w, &ring[last_row % rows][0]);
+
+      for(unsigned int j = 0; j < rows; j++)
+	src_rows[j] = &ring[(first_row + j) % rows][0];
+
+      engine.convolve_row(src_rows, w - 2 * center_column, &out[center_column], scratch);
+
+      write_row(dst, center_column, y, w - 2 * center_column, &out[center_column]);
+    }
+  }
+
   /**
    * Convolve a single channel source image with a filter kernel
    * and write it into a destination image.
    * Depending on the filter kernel size there is a region next to the
    * image boundary that you cannot use for further processing.
+   *
+   * Separable kernels are applied in two passes, see ConvolutionEngine.
+   * The image is split into horizontal bands, that are processed in
+   * parallel.
    */
   template<typename ImageTypeDst, typename ImageTypeSrc>
   void convolve(std::shared_ptr<ImageTypeDst> dst,
@@ -546,28 +733,32 @@ namespace degate {
     unsigned int h = std::min(src->get_height(), dst->get_height());
     unsigned int w = std::min(src->get_width(), dst->get_width());
 
-    unsigned int x, y, i, j;
+    unsigned int rows = kernel->get_rows(), columns = kernel->get_columns();
+    unsigned int center_row = kernel->get_center_row();
 
-    for(y = kernel->get_center_row(); y < h - kernel->get_center_row(); y++) {
-      for(x = kernel->get_center_column(); x < w - kernel->get_center_column(); x++) {
+    if(h < rows || w < columns) return;
 
-	double accu = 0;
+    ConvolutionEngine engine(kernel);
 
-	for(i = 0; i < kernel->get_columns(); i++ ) {
-	  for(j = 0; j < kernel->get_rows(); j++ ) {
+    // Bands are aligned to tile rows, so that threads write to different tiles.
+    const unsigned int num_threads = Configuration::get_instance().get_max_worker_threads();
+    TileView<typename ImageTypeDst::pixel_type> view;
+    dst->get_tile_view(0, 0, view);
+    unsigned int band_height = (h + num_threads - 1) / num_threads;
+    band_height = (band_height + view.height - 1) / view.height * view.height;
 
-	    typename ImageTypeSrc::pixel_type p =
-	      src->get_pixel(x - kernel->get_center_column() + i,
-			     y - kernel->get_center_row() + j);
+    std::vector<std::pair<unsigned int, unsigned int> > bands;
+    for(unsigned int min_y = 0; min_y < h; min_y += band_height) {
+      unsigned int
+	first = std::max(min_y, center_row),
+	last = std::min(min_y + band_height, h - center_row);
 
-	    double k = kernel->get(kernel->get_columns() - 1 - i,
-				   kernel->get_rows() - 1 - j);
-	    accu += k * p;
-	  }
-	}
-	dst->template set_pixel_as<double>(x, y, accu);
-      }
+      if(first < last) bands.push_back(std::make_pair(first, last));
     }
+
+    run_parallel_for(num_threads, bands.size(),
+		     boost::bind(&convolve_rows<ImageTypeDst, ImageTypeSrc>,
+				 dst, src, kernel, boost::cref(engine), boost::cref(bands), _1));
   }
 
 
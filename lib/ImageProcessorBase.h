@@ -23,7 +23,9 @@
 #define __IMAGEPROCESSORBASE_H__
 
 #include <string>
+#include <vector>
 #include <ProgressControl.h>
+#include <Image.h>
 
 namespace degate {
 
@@ -112,9 +114,184 @@ namespace degate {
       return has_properties;
     }
 
+
+    /*
+     * Streaming interface. A streamable processor calculates its output
+     * image row by row from a window of input rows. The pipe uses it to
+     * push rows through several processors without creating the
+     * intermediate images. Rows are passed as double values.
+     */
+
+    /**
+     * Check if the processor can be run row by row.
+     */
+    virtual bool is_streamable() const {
+      return false;
+    }
+
+    /**
+     * Check if the processor needs its complete input image before it
+     * can calculate a row, e.g. for statistics over the image. Such a
+     * processor is the first one in a streamed part of a pipe.
+     */
+    virtual bool needs_complete_input() const {
+      return false;
+    }
+
+    /**
+     * Get the number of input rows above the corresponding input row,
+     * that are needed for an output row.
+     */
+    virtual unsigned int get_rows_before() const {
+      return 0;
+    }
+
+    /**
+     * Get the number of input rows below the corresponding input row,
+     * that are needed for an output row.
+     */
+    virtual unsigned int get_rows_after() const {
+      return 0;
+    }
+
+    /**
+     * Get the row in the input image, that corresponds to output row 0.
+     */
+    virtual unsigned int get_row_offset() const {
+      return 0;
+    }
+
+    /**
+     * Get the size of the output image for an input image size.
+     */
+    virtual void get_output_size(unsigned int in_width, unsigned int in_height,
+				 unsigned int & out_width, unsigned int & out_height) const {
+      out_width = in_width;
+      out_height = in_height;
+    }
+
+    /**
+     * Get the columns of the input image, that the processor reads.
+     * The range is \p min_x <= x < \p max_x.
+     */
+    virtual void get_input_columns(unsigned int in_width,
+				   unsigned int & min_x, unsigned int & max_x) const {
+      min_x = 0;
+      max_x = in_width;
+    }
+
+    /**
+     * Prepare a streamed run.
+     * @param in The input image, if the processor needs its complete
+     *   input. Otherwise it is a NULL pointer.
+     * @exception DegateRuntimeException This exception is thrown, if the
+     *   processor can't process an image of this size.
+     */
+    virtual void prepare_streaming(ImageBase_shptr in, unsigned int in_width, unsigned int in_height) {}
+
+    /**
+     * Calculate an output row.
+     * @param in The input rows from get_row_offset() + \p y - get_rows_before()
+     *   to get_row_offset() + \p y + get_rows_after(). Rows outside
+     *   of the input image are NULL pointers.
+     * @param y The output row.
+     * @param out The output row with the width of the output image.
+     * @param scratch A buffer for intermediate values. It belongs to the
+     *   calling strip and is kept between its rows, so that its memory
+     *   is reused.
+     */
+    virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			     unsigned int in_width, unsigned int in_height,
+			     unsigned int out_width, double * out,
+			     std::vector<double> & scratch) const {}
+
+    /**
+     * Read a row segment of an input image, that has the processor's input type.
+     */
+    virtual void read_input_row(ImageBase_shptr img, unsigned int x, unsigned int y,
+				unsigned int n, double * row) const {}
+
+    /**
+     * Create an image of the processor's output type.
+     */
+    virtual ImageBase_shptr create_output_image(unsigned int width, unsigned int height) const {
+      return ImageBase_shptr();
+    }
+
+    /**
+     * Write a row into an image, that was created with create_output_image().
+     */
+    virtual void write_output_row(ImageBase_shptr img, unsigned int y,
+				  unsigned int width, double const * row) const {}
+
+    /**
+     * Get the number of rows of an output image, that are stored
+     * together. Parallel writers should write different blocks of rows.
+     */
+    virtual unsigned int get_output_row_alignment(ImageBase_shptr img) const {
+      return 1;
+    }
   };
 
   typedef std::shared_ptr<ImageProcessorBase> ImageProcessorBase_shptr;
+
+
+  /**
+   * Base class for image processors with typed input and output images.
+   * It implements the image access for streaming. A derived processor is
+   * streamable, if it works on double pixels.
+   */
+  template<typename ImageTypeIn, typename ImageTypeOut>
+  class TypedImageProcessor : public ImageProcessorBase {
+
+  public:
+
+    TypedImageProcessor(std::string const& _name,
+			std::string const& _description,
+			bool _has_properties) :
+      ImageProcessorBase(_name, _description, _has_properties,
+			 typeid(typename ImageTypeIn::pixel_type),
+			 typeid(typename ImageTypeOut::pixel_type)) {}
+
+    virtual ~TypedImageProcessor() {}
+
+    /**
+     * Check if input and output rows can be passed as double values
+     * without a loss.
+     */
+    static bool has_double_pixels() {
+      return
+	typeid(typename ImageTypeIn::pixel_type) == typeid(gs_double_pixel_t) &&
+	typeid(typename ImageTypeOut::pixel_type) == typeid(gs_double_pixel_t);
+    }
+
+    virtual void read_input_row(ImageBase_shptr img, unsigned int x, unsigned int y,
+				unsigned int n, double * row) const {
+      std::shared_ptr<ImageTypeIn> img_in = std::dynamic_pointer_cast<ImageTypeIn>(img);
+      assert(img_in != NULL);
+      read_row<double>(img_in, x, y, n, row);
+    }
+
+    virtual ImageBase_shptr create_output_image(unsigned int width, unsigned int height) const {
+      return ImageBase_shptr(new ImageTypeOut(width, height));
+    }
+
+    virtual void write_output_row(ImageBase_shptr img, unsigned int y,
+				  unsigned int width, double const * row) const {
+      std::shared_ptr<ImageTypeOut> img_out = std::dynamic_pointer_cast<ImageTypeOut>(img);
+      assert(img_out != NULL);
+      write_row<double>(img_out, 0, y, width, row);
+    }
+
+    virtual unsigned int get_output_row_alignment(ImageBase_shptr img) const {
+      std::shared_ptr<ImageTypeOut> img_out = std::dynamic_pointer_cast<ImageTypeOut>(img);
+      assert(img_out != NULL);
+      TileView<typename ImageTypeOut::pixel_type> view;
+      img_out->get_tile_view(0, 0, view);
+      // A view of the whole image is a memory image.
+      return view.height < img_out->get_height() ? view.height : 1;
+    }
+  };
 }
 
 #endif
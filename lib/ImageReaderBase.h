@@ -30,15 +30,19 @@
 #include <StoragePolicies.h>
 #include <PixelPolicies.h>
 #include <FileSystem.h>
+#include <ProgressControl.h>
 
 namespace degate {
 
   /**
    * The base class for image readers.
+   *
+   * Readers report the progress of get_image() via the ProgressControl
+   * interface. A canceled get_image() returns false.
    */
 
   template<class ImageType>
-  class ImageReaderBase {
+  class ImageReaderBase : public ProgressControl {
   private:
 
     std::string filename;
@@ -0,0 +1,232 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __INTEGRALIMAGE_H__
+#define __INTEGRALIMAGE_H__
+
+#include <Image.h>
+#include <ImageManipulation.h>
+#include <Configuration.h>
+#include <WorkerThreads.h>
+
+#include <boost/bind.hpp>
+
+#include <vector>
+#include <algorithm>
+
+namespace degate {
+
+  /**
+   * Calculate the column sums over the rows of band \p b of a greyscale
+   * image. The single and squared sums are added to \p col_single[b + 1]
+   * and \p col_squared[b + 1], that is to the accumulators of the band below.
+   */
+  template<typename SingleType, typename SquaredType, typename ImageTypeSrc>
+  void sum_up_columns(std::shared_ptr<ImageTypeSrc> src,
+		      unsigned int band_height,
+		      std::vector<std::vector<SingleType> > & col_single,
+		      std::vector<std::vector<SquaredType> > & col_squared,
+		      size_t b) {
+
+    typedef typename ImageTypeSrc::pixel_type pixel_type;
+    const unsigned int w = src->get_width();
+    const unsigned int min_y = b * band_height, max_y = (b + 1) * band_height;
+
+    std::vector<pixel_type> row(w);
+
+    for(unsigned int y = min_y; y < max_y; y++) {
+      read_row<pixel_type>(src, 0, y, w, &row[0]);
+      for(unsigned int x = 0; x < w; x++) {
+	SquaredType p = row[x];
+	col_single[b + 1][x] += static_cast<SingleType>(row[x]);
+	col_squared[b + 1][x] += p * p;
+      }
+    }
+  }
+
+  /**
+   * Calculate the summation tables for the rows of band \p b.
+   * @param acc_single The values of the single summation table in
+   *   the row above each band. The vectors are used as accumulators.
+   * @param acc_squared The values of the squared summation table in
+   *   the row above each band. The vectors are used as accumulators.
+   */
+  template<typename ImageTypeSingle, typename ImageTypeSquared, typename ImageTypeSrc>
+  void calc_integral_rows(std::shared_ptr<ImageTypeSingle> sum_single,
+			  std::shared_ptr<ImageTypeSquared> sum_squared,
+			  std::shared_ptr<ImageTypeSrc> src,
+			  unsigned int band_height,
+			  std::vector<std::vector<typename ImageTypeSingle::pixel_type> > & acc_single,
+			  std::vector<std::vector<typename ImageTypeSquared::pixel_type> > & acc_squared,
+			  size_t b) {
+
+    typedef typename ImageTypeSrc::pixel_type pixel_type;
+    typedef typename ImageTypeSingle::pixel_type single_type;
+    typedef typename ImageTypeSquared::pixel_type squared_type;
+
+    const unsigned int w = src->get_width();
+    const unsigned int min_y = b * band_height, max_y = std::min<unsigned int>(src->get_height(), (b + 1) * band_height);
+
+    std::vector<single_type> & a1 = acc_single[b];
+    std::vector<squared_type> & a2 = acc_squared[b];
+    std::vector<pixel_type> row(w);
+
+    for(unsigned int y = min_y; y < max_y; y++) {
+      read_row<pixel_type>(src, 0, y, w, &row[0]);
+
+      single_type s1 = 0;
+      squared_type s2 = 0;
+      for(unsigned int x = 0; x < w; x++) {
+	squared_type p = row[x];
+	s1 += static_cast<single_type>(row[x]);
+	s2 += p * p;
+	a1[x] += s1;
+	a2[x] += s2;
+      }
+
+      write_row<single_type>(sum_single, 0, y, w, &a1[0]);
+      write_row<squared_type>(sum_squared, 0, y, w, &a2[0]);
+    }
+  }
+
+  /**
+   * Build the summation tables (integral images) of a greyscale image.
+   *
+   * A value of \p sum_single at x,y is the sum over all pixels in the
+   * rectangle 0,0 - x,y. A value of \p sum_squared is the sum over the
+   * squared pixel values. Both tables are calculated together in a single
+   * pass over contiguous rows.
+   *
+   * The image is split into horizontal bands, that are processed in
+   * parallel. The column sums of each band are calculated first.
+   * A prefix sum over them gives each band the table values of the row
+   * above it.
+   *
+   * For 8 bit images you can use TileImage_SUM_UINT32 for \p sum_single
+   * and TileImage_SUM_INT64 for \p sum_squared. Both are exact and need
+   * less memory than double precision tables.
+   *
+   * @param sum_single The single summation table. It must have the size
+   *   of \p src.
+   * @param sum_squared The squared summation table. It must have the size
+   *   of \p src.
+   * @param src A single channel image.
+   * @param num_threads The number of threads. If it is 0, the number of
+   *   worker threads from the configuration is used.
+   */
+  template<typename ImageTypeSingle, typename ImageTypeSquared, typename ImageTypeSrc>
+  void build_integral_images(std::shared_ptr<ImageTypeSingle> sum_single,
+			     std::shared_ptr<ImageTypeSquared> sum_squared,
+			     std::shared_ptr<ImageTypeSrc> src,
+			     unsigned int num_threads = 0) {
+
+    typedef typename ImageTypeSingle::pixel_type single_type;
+    typedef typename ImageTypeSquared::pixel_type squared_type;
+
+    assert(sum_single != NULL && sum_squared != NULL && src != NULL);
+    assert(sum_single->get_width() == src->get_width() &&
+	   sum_single->get_height() == src->get_height());
+    assert(sum_squared->get_width() == src->get_width() &&
+	   sum_squared->get_height() == src->get_height());
+
+    const unsigned int w = src->get_width(), h = src->get_height();
+    if(w == 0 || h == 0) return;
+
+    if(num_threads == 0) num_threads = Configuration::get_instance().get_max_worker_threads();
+
+    // Bands are aligned to tile rows, so that threads work on different tiles.
+    TileView<typename ImageTypeSrc::pixel_type> view;
+    src->get_tile_view(0, 0, view);
+    unsigned int band_height = (h + num_threads - 1) / num_threads;
+    band_height = (band_height + view.height - 1) / view.height * view.height;
+    const unsigned int num_bands = (h + band_height - 1) / band_height;
+
+    std::vector<std::vector<single_type> > acc_single(num_bands, std::vector<single_type>(w, 0));
+    std::vector<std::vector<squared_type> > acc_squared(num_bands, std::vector<squared_type>(w, 0));
+
+    // Column sums of all bands except the last one.
+    run_parallel_for(num_threads, num_bands - 1,
+		     boost::bind(&sum_up_columns<single_type, squared_type, ImageTypeSrc>,
+				 src, band_height, boost::ref(acc_single), boost::ref(acc_squared), _1));
+
+    // Prefix pass: column sums over all rows above a band, then a prefix
+    // sum along the row gives the table values of the row above the band.
+    for(unsigned int b = 2; b < num_bands; b++)
+      for(unsigned int x = 0; x < w; x++) {
+	acc_single[b][x] += acc_single[b - 1][x];
+	acc_squared[b][x] += acc_squared[b - 1][x];
+      }
+
+    for(unsigned int b = 1; b < num_bands; b++)
+      for(unsigned int x = 1; x < w; x++) {
+	acc_single[b][x] += acc_single[b][x - 1];
+	acc_squared[b][x] += acc_squared[b][x - 1];
+      }
+
+    run_parallel_for(num_threads, num_bands,
+		     boost::bind(&calc_integral_rows<ImageTypeSingle, ImageTypeSquared, ImageTypeSrc>,
+				 sum_single, sum_squared, src, band_height,
+				 boost::ref(acc_single), boost::ref(acc_squared), _1));
+  }
+
+  /**
+   * Get the single and the squared sum over a rectangular region from
+   * summation tables, that were calculated with build_integral_images().
+   *
+   * Integer tables may wrap around. The differences are calculated in
+   * the pixel type of the tables, so that the results are still exact.
+   */
+  template<typename ImageTypeSingle, typename ImageTypeSquared>
+  void get_region_sums(std::shared_ptr<ImageTypeSingle> sum_single,
+		       std::shared_ptr<ImageTypeSquared> sum_squared,
+		       unsigned int min_x, unsigned int min_y,
+		       unsigned int width, unsigned int height,
+		       double & region_single, double & region_squared) {
+
+    assert(width > 0 && height > 0);
+
+    const unsigned int
+      x_plus_w = min_x + width - 1,
+      y_plus_h = min_y + height - 1;
+
+    typename ImageTypeSingle::pixel_type f1 = sum_single->get_pixel(x_plus_w, y_plus_h);
+    typename ImageTypeSquared::pixel_type f2 = sum_squared->get_pixel(x_plus_w, y_plus_h);
+
+    if(min_x > 0) {
+      f1 -= sum_single->get_pixel(min_x - 1, y_plus_h);
+      f2 -= sum_squared->get_pixel(min_x - 1, y_plus_h);
+    }
+    if(min_y > 0) {
+      f1 -= sum_single->get_pixel(x_plus_w, min_y - 1);
+      f2 -= sum_squared->get_pixel(x_plus_w, min_y - 1);
+    }
+    if(min_x > 0 && min_y > 0) {
+      f1 += sum_single->get_pixel(min_x - 1, min_y - 1);
+      f2 += sum_squared->get_pixel(min_x - 1, min_y - 1);
+    }
+
+    region_single = f1;
+    region_squared = f2;
+  }
+
+}
+
+#endif
@@ -130,8 +130,16 @@ namespace degate {
 
     if(img == NULL) return false;
 
-    for(unsigned int y = 0; y < get_height(); y++) {
-      for(unsigned int x = 0; x < get_width(); x++) {
+    // Only the region is copied, which is present in both images.
+    unsigned int w = std::min(get_width(), img->get_width());
+    unsigned int h = std::min(get_height(), img->get_height());
+
+    this->reset_progress();
+
+    for(unsigned int y = 0; y < h && !this->is_canceled(); y++) {
+      this->set_progress((double)y / h);
+
+      for(unsigned int x = 0; x < w; x++) {
 
 	uint8_t v1, v2, v3;
 	if(depth == 1) {
@@ -149,7 +157,8 @@ namespace degate {
       }
     }
 
-    return true;
+    this->set_progress(1);
+    return !this->is_canceled();
   }
 
 
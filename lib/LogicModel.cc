@@ -694,7 +694,7 @@ void LogicModel::remove_layer(Layer_shptr layer) {
   BOOST_FOREACH(PlacedLogicModelObject_shptr o, remove_list) remove_object(o);
 
   // Unset background image. It will remove the image files, too.
-  layer->unset_image();
+  if(layer->has_background_image()) layer->unset_image();
 
   // Remove layer container.
   layers.erase(remove(layers.begin(), layers.end(), layer),
@@ -186,7 +186,19 @@ void degate::grab_template_images(LogicModel_shptr lmodel,
 
 void degate::load_background_image(Layer_shptr layer,
 				   std::string const& project_dir,
-				   std::string const& image_file) {
+				   std::string const& image_file,
+				   MAP_STORAGE_TYPE tile_storage) {
+
+  debug(TM, "Load image %s", image_file.c_str());
+  load_background_image(layer, project_dir, get_image_reader<BackgroundImage>(image_file),
+			tile_storage);
+}
+
+
+void degate::load_background_image(Layer_shptr layer,
+				   std::string const& project_dir,
+				   std::shared_ptr<ImageReaderBase<BackgroundImage> > reader,
+				   MAP_STORAGE_TYPE tile_storage) {
 
   if(layer == NULL)
     throw InvalidPointerException("Error: you passed an invalid pointer to load_background_image()");
@@ -195,24 +207,89 @@ void degate::load_background_image(Layer_shptr layer,
   fmter % layer->get_layer_id(); // was get_layer_pos()
 
   std::string dir(join_pathes(project_dir, fmter.str()));
+  std::string tmp_dir = dir + ".importing";
 
-  if(layer->has_background_image())
-    layer->unset_image();
+  // The image is imported next to the current background image, that
+  // is kept, if the import fails.
+  if(file_exists(tmp_dir)) remove_directory(tmp_dir);
+
+  debug(TM, "Create background image in %s", tmp_dir.c_str());
+  try {
+    BackgroundImage_shptr bg_image(new BackgroundImage(layer->get_width(),
+						       layer->get_height(),
+						       tmp_dir, true, 10, tile_storage));
 
-  debug(TM, "Create background image in %s", dir.c_str());
-  BackgroundImage_shptr bg_image(new BackgroundImage(layer->get_width(),
-						     layer->get_height(),
-						     dir));
+    load_image<BackgroundImage>(reader, bg_image);
+    bg_image->sync();
+  }
+  catch(...) {
+    remove_directory(tmp_dir);
+    throw;
+  }
 
-  debug(TM, "Load image %s", image_file.c_str());
-  load_image<BackgroundImage>(image_file, bg_image);
+  if(layer->has_background_image())
+    layer->unset_image();
+  rename_file(tmp_dir, dir);
 
   debug(TM, "Set image to layer.");
-  layer->set_image(bg_image);
+  layer->set_image(BackgroundImage_shptr(new BackgroundImage(layer->get_width(),
+							     layer->get_height(),
+							     dir, true, 10, tile_storage)));
   debug(TM, "Done.");
 }
 
 
+void degate::convert_background_image(Layer_shptr layer, MAP_STORAGE_TYPE tile_storage) {
+
+  if(layer == NULL)
+    throw InvalidPointerException("Error: you passed an invalid pointer to convert_background_image()");
+
+  BackgroundImage_shptr old_image = layer->get_image();
+  if(old_image->get_tile_storage() == tile_storage) return;
+
+  std::string dir = old_image->get_directory();
+  std::string tmp_dir = dir + ".converting";
+  unsigned int tile_width_exp = old_image->get_tile_width_exp();
+
+  debug(TM, "Convert background image in %s", dir.c_str());
+
+  {
+    BackgroundImage_shptr new_image(new BackgroundImage(layer->get_width(),
+							layer->get_height(),
+							tmp_dir, true,
+							tile_width_exp, tile_storage));
+    copy_image(new_image, old_image);
+    new_image->sync();
+  }
+
+  // Removes the old image including its prescaled images.
+  old_image.reset();
+  layer->unset_image();
+  rename_file(tmp_dir, dir);
+
+  layer->set_image(BackgroundImage_shptr(new BackgroundImage(layer->get_width(),
+							     layer->get_height(),
+							     dir, true,
+							     tile_width_exp, tile_storage)));
+}
+
+void degate::convert_background_images(Project_shptr project, MAP_STORAGE_TYPE tile_storage) {
+
+  if(project == NULL)
+    throw InvalidPointerException("Error: you passed an invalid pointer to convert_background_images()");
+
+  LogicModel_shptr lmodel = project->get_logic_model();
+
+  for(LogicModel::layer_collection::iterator iter = lmodel->layers_begin();
+      iter != lmodel->layers_end(); ++iter) {
+    if((*iter)->has_background_image())
+      convert_background_image(*iter, tile_storage);
+  }
+
+  project->set_tile_storage(tile_storage);
+}
+
+
 void degate::clear_logic_model(LogicModel_shptr lmodel, Layer_shptr layer) {
   if(lmodel == NULL || layer == NULL)
     throw InvalidPointerException("Error: you passed an invalid pointer to clear_logc_model()");
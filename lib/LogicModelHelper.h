@@ -323,14 +323,48 @@ namespace degate {
   /**
    * Load an image in a common image format as background image for a layer.
    * If there is already a background image, it will be unset and removed from
-   * the project directory.
+   * the project directory. If the import fails, the layer keeps its current
+   * background image.
    * @exception InvalidPointerException If you pass an invalid shared pointer for
    *   \p layer, then this exception is raised.
-   *
+   * @param tile_storage The file format of the image tiles.
+   * @see Project::get_tile_storage()
+   */
+  void load_background_image(Layer_shptr layer,
+			     std::string const& project_dir,
+			     std::string const& image_file,
+			     MAP_STORAGE_TYPE tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE);
+
+  /**
+   * Load an image from an image reader as background image for a layer.
+   * Use this variant, if you want to observe the import progress via
+   * the reader's ProgressControl interface.
+   * @see load_background_image(Layer_shptr, std::string const&, std::string const&)
+   * @see get_image_reader()
    */
   void load_background_image(Layer_shptr layer,
 			     std::string const& project_dir,
-			     std::string const& image_file);
+			     std::shared_ptr<ImageReaderBase<BackgroundImage> > reader,
+			     MAP_STORAGE_TYPE tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE);
+
+  /**
+   * Convert the background image of a layer into another tile file format.
+   * The prescaled images are recalculated.
+   * @exception InvalidPointerException If you pass an invalid shared pointer for
+   *   \p layer, then this exception is raised.
+   * @exception DegateLogicException This exception is raised, if the layer
+   *   has no background image.
+   */
+  void convert_background_image(Layer_shptr layer, MAP_STORAGE_TYPE tile_storage);
+
+  /**
+   * Convert all background images of a project into another tile file format
+   * and set it as the project's tile file format. You have to export the project
+   * afterwards to store the setting.
+   * @exception InvalidPointerException If you pass an invalid shared pointer for
+   *   \p project, then this exception is raised.
+   */
+  void convert_background_images(Project_shptr project, MAP_STORAGE_TYPE tile_storage);
 
   /**
    * Clear the logic model for a layer.
@@ -23,7 +23,10 @@
 #define __MEMORYMAP_H__
 
 #include "globals.h"
+#include "TileCompression.h"
+#include "degate_exceptions.h"
 #include <string>
+#include <atomic>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,6 +49,8 @@ namespace degate {
     MAP_STORAGE_TYPE_MEM = 0,
     MAP_STORAGE_TYPE_PERSISTENT_FILE = 1,
     MAP_STORAGE_TYPE_TEMP_FILE = 2,
+    MAP_STORAGE_TYPE_COMPRESSED_FILE = 3,
+    MAP_STORAGE_TYPE_PACK_FILE = 4
   };
 
 
@@ -66,12 +71,19 @@ namespace degate {
     int fd;
     size_t filesize;
 
+    // Set by the write paths, if the data differs from a compressed file.
+    std::atomic<bool> dirty;
+
+    // Keeps the memory of a pack file alive.
+    std::shared_ptr<void> owner;
+
   private:
     ret_t alloc_memory();
     ret_t map_temp_file(std::string const & filename_pattern);
     ret_t map_file(std::string const & filename);
 
     ret_t map_file_by_fd();
+    void load_compressed_file(std::string const & filename);
 
     void * get_void_ptr(unsigned int x, unsigned int y) const;
 
@@ -87,6 +99,10 @@ namespace degate {
       return storage_type == MAP_STORAGE_TYPE_MEM;
     }
 
+    bool is_compressed_file() const {
+      return storage_type == MAP_STORAGE_TYPE_COMPRESSED_FILE;
+    }
+
   public:
 
 
@@ -100,14 +116,31 @@ namespace degate {
     /**
      * Create a file based memory chunk.
      * The storage is filebases. The file is mapped into memory.
+     * For MAP_STORAGE_TYPE_COMPRESSED_FILE the data is decompressed into
+     * heap memory instead. It is compressed and written back by sync()
+     * and on destruction, if it was marked as modified.
      * @param width The width of a 2D map.
      * @param height The height of a 2D map.
-     * @param mode Is either MAP_STORAGE_TYPE_PERSISTENT_FILE or MAP_STORAGE_TYPE_TEMP_FILE.
+     * @param mode Is either MAP_STORAGE_TYPE_PERSISTENT_FILE, MAP_STORAGE_TYPE_TEMP_FILE
+     *   or MAP_STORAGE_TYPE_COMPRESSED_FILE.
      * @param file_to_map The name of the file, which should be mmap().
+     * @exception InvalidFileFormatException This exception is thrown, if
+     *   a compressed file is corrupted or truncated.
      */
     MemoryMap(unsigned int width, unsigned int height,
 	      MAP_STORAGE_TYPE mode, std::string const & file_to_map);
 
+    /**
+     * Create a memory map for memory, that belongs to a pack file. The
+     * memory map does not copy the data. It keeps the \p owner alive.
+     * @param width The width of a 2D map.
+     * @param height The height of a 2D map.
+     * @param data The memory of width * height elements.
+     * @param owner The object, that owns the memory.
+     */
+    MemoryMap(unsigned int width, unsigned int height,
+	      T * data, std::shared_ptr<void> owner);
+
     /**
      * The destructor.
      */
@@ -116,6 +149,30 @@ namespace degate {
     int get_width() const { return width; }
     int get_height() const { return height; }
 
+    /**
+     * Write modified data back into the file.
+     */
+    void sync();
+
+    /**
+     * Mark the data as modified. Writes via set(), clear() and clear_area()
+     * do this automatically. If you write via get_data_ptr(), you have to
+     * call it yourself, otherwise the data of a compressed file is not
+     * written back.
+     */
+    void mark_dirty() {
+      // Threads, that write into the same tile, only read the flag.
+      if(!dirty.load(std::memory_order_relaxed)) dirty.store(true, std::memory_order_relaxed);
+    }
+
+    /**
+     * Ask the kernel to read the mapped file in advance and fault its
+     * pages in. This is done by prefetch threads, so that the thread,
+     * that accesses the data later, neither blocks on disk reads nor
+     * on page faults. Heap memory is not touched.
+     */
+    void prefault() const;
+
     /**
      * Cear the whole memory map.
      */
@@ -140,6 +197,14 @@ namespace degate {
      */
     void raw_copy(void * buf) const;
 
+    /**
+     * Get a pointer to the first element of the memory map. Elements
+     * are stored row by row. The pointer is valid as long as the
+     * MemoryMap object exists.
+     * @see mark_dirty()
+     */
+    T * get_data_ptr() const { return mem; }
+
     /**
      * Get the name of the mapped file.
      * @returns Returns a string with the mapped file. If the memory
@@ -155,7 +220,8 @@ namespace degate {
     storage_type(MAP_STORAGE_TYPE_MEM),
     mem(NULL),
     fd(-1),
-    filesize(0) {
+    filesize(0),
+    dirty(false) {
 
     assert(width > 0 && height > 0);
 
@@ -171,10 +237,12 @@ namespace degate {
     mem(NULL),
     filename(file_to_map),
     fd(-1),
-    filesize(0) {
+    filesize(0),
+    dirty(false) {
 
     assert(mode == MAP_STORAGE_TYPE_PERSISTENT_FILE ||
-	   mode == MAP_STORAGE_TYPE_TEMP_FILE);
+	   mode == MAP_STORAGE_TYPE_TEMP_FILE ||
+	   mode == MAP_STORAGE_TYPE_COMPRESSED_FILE);
 
     assert(width > 0 && height > 0);
 
@@ -192,6 +260,25 @@ namespace degate {
       if(RET_IS_NOT_OK(ret)) debug(TM, "Can't open file %s as persistent file", file_to_map.c_str());
       assert(RET_IS_OK(ret));
     }
+    else if(mode == MAP_STORAGE_TYPE_COMPRESSED_FILE) {
+      load_compressed_file(file_to_map);
+    }
+  }
+
+
+  template <typename T>
+  MemoryMap<T>::MemoryMap(unsigned int _width, unsigned int _height,
+			  T * data, std::shared_ptr<void> _owner) :
+    width(_width), height(_height),
+    storage_type(MAP_STORAGE_TYPE_PACK_FILE),
+    mem(data),
+    fd(-1),
+    filesize(0),
+    dirty(false),
+    owner(_owner) {
+
+    assert(width > 0 && height > 0);
+    assert(mem != NULL);
   }
 
 
@@ -199,6 +286,18 @@ namespace degate {
   MemoryMap<T>::~MemoryMap() {
 
     switch(storage_type) {
+    case MAP_STORAGE_TYPE_PACK_FILE:
+      // The owner writes the data back.
+      mem = NULL;
+      break;
+    case MAP_STORAGE_TYPE_COMPRESSED_FILE:
+      try {
+	sync();
+      }
+      catch(std::exception const& ex) {
+	debug(TM, "Can't write back %s: %s", filename.c_str(), ex.what());
+      }
+      // fall through
     case MAP_STORAGE_TYPE_MEM:
       if(mem != NULL) free(mem);
       mem = NULL;
@@ -243,6 +342,72 @@ namespace degate {
     return RET_OK;
   }
 
+  /**
+   * Allocate memory and fill it with the content of a compressed file. If the
+   * file does not exist, the memory is zeroed. The file is created by sync().
+   * @exception InvalidFileFormatException This exception is thrown, if the
+   *   file is corrupted. The memory is released then.
+   */
+  template <typename T>
+  void MemoryMap<T>::load_compressed_file(std::string const& filename) {
+
+    assert(is_compressed_file());
+
+    if(RET_IS_NOT_OK(alloc_memory()))
+      throw DegateRuntimeException("Error in load_compressed_file(): Can't allocate memory.");
+
+    try {
+      read_compressed_tile(filename, mem, width, height, sizeof(T));
+    }
+    catch(...) {
+      // The destructor is not called for a failed constructor.
+      free(mem);
+      mem = NULL;
+      throw;
+    }
+  }
+
+  template <typename T>
+  void MemoryMap<T>::sync() {
+    if(mem == NULL) return;
+
+    if(is_compressed_file()) {
+      // Writes, that happen meanwhile, mark the data as dirty again.
+      if(dirty.exchange(false)) {
+	try {
+	  write_compressed_tile(filename, mem, width, height, sizeof(T));
+	}
+	catch(...) {
+	  dirty = true;
+	  throw;
+	}
+      }
+    }
+    else if(storage_type == MAP_STORAGE_TYPE_PERSISTENT_FILE ||
+	    storage_type == MAP_STORAGE_TYPE_TEMP_FILE) {
+      if(msync(mem, filesize, MS_SYNC) == -1) perror("msync() failed");
+    }
+  }
+
+  template <typename T>
+  void MemoryMap<T>::prefault() const {
+    if(mem == NULL ||
+       storage_type == MAP_STORAGE_TYPE_MEM ||
+       storage_type == MAP_STORAGE_TYPE_COMPRESSED_FILE) return;
+
+    const size_t size = width * height * sizeof(T);
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    // madvise() requires a page aligned address. Tiles in a pack file
+    // are page aligned anyway.
+    uintptr_t start = reinterpret_cast<uintptr_t>(mem) & ~(page_size - 1);
+    madvise(reinterpret_cast<void *>(start),
+	    reinterpret_cast<uintptr_t>(mem) + size - start, MADV_WILLNEED);
+
+    volatile uint8_t const * p = reinterpret_cast<uint8_t const *>(mem);
+    for(size_t i = 0; i < size; i += page_size) (void)p[i];
+  }
+
   /**
    * Clear map data.
    */
@@ -251,6 +416,7 @@ namespace degate {
   void MemoryMap<T>::clear() {
     assert(mem != NULL);
     if(mem != NULL) memset(mem, 0, width * height * sizeof(T));
+    mark_dirty();
   }
 
 
@@ -266,6 +432,7 @@ namespace degate {
       unsigned int x, y;
       for(y = min_y; y < min_y + height; y++)
 	memset(get_void_ptr(x, y), 0, width * sizeof(T));
+      mark_dirty();
     }
   }
 
@@ -437,6 +604,7 @@ namespace degate {
     }
     assert(x < width && y < height);
     mem[y * width + x] = new_val;
+    mark_dirty();
     /*
     if(x + y * width < width * height)
       mem[y * width + x] = new_val;
@@ -0,0 +1,367 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <PixelKernels.h>
+#include <Image.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(WORDS_BIGENDIAN)
+#define PIXELKERNELS_X86
+#include <immintrin.h>
+#endif
+
+using namespace degate;
+
+/*
+ * Plain C++ implementation. The SIMD implementations use it for the
+ * remaining pixels at the end of a row.
+ */
+
+static void rgba_to_gs_byte_generic(rgba_pixel_t const * src, gs_byte_pixel_t * dst, size_t n) {
+  for(size_t i = 0; i < n; i++) dst[i] = RGBA_TO_GS_BY_VAL(src[i]);
+}
+
+static void rgba_to_gs_double_generic(rgba_pixel_t const * src, gs_double_pixel_t * dst, size_t n) {
+  for(size_t i = 0; i < n; i++) dst[i] = RGBA_TO_GS_BY_VAL(src[i]);
+}
+
+static void average_rgba_2x2_generic(rgba_pixel_t const * row0, rgba_pixel_t const * row1,
+				     rgba_pixel_t * dst, size_t n) {
+  for(size_t i = 0; i < n; i++) {
+    rgba_pixel_t p1 = row0[2*i], p2 = row0[2*i + 1], p3 = row1[2*i], p4 = row1[2*i + 1];
+    unsigned int r = (MASK_R(p1) + MASK_R(p2) + MASK_R(p3) + MASK_R(p4)) / 4;
+    unsigned int g = (MASK_G(p1) + MASK_G(p2) + MASK_G(p3) + MASK_G(p4)) / 4;
+    unsigned int b = (MASK_B(p1) + MASK_B(p2) + MASK_B(p3) + MASK_B(p4)) / 4;
+    unsigned int a = (MASK_A(p1) + MASK_A(p2) + MASK_A(p3) + MASK_A(p4)) / 4;
+    dst[i] = MERGE_CHANNELS(r, g, b, a);
+  }
+}
+
+static uint64_t dot_product_gs_byte_generic(gs_byte_pixel_t const * a, gs_byte_pixel_t const * b,
+					    size_t n, uint64_t * sum_a) {
+  uint64_t sum_ab = 0, s = 0;
+  for(size_t i = 0; i < n; i++) {
+    sum_ab += (unsigned int)a[i] * b[i];
+    s += a[i];
+  }
+  *sum_a = s;
+  return sum_ab;
+}
+
+static void add_scaled_double_generic(double const * src, double factor, double * dst, size_t n) {
+  for(size_t i = 0; i < n; i++) dst[i] += factor * src[i];
+}
+
+static const PixelKernels kernels_generic = {
+  "generic",
+  rgba_to_gs_byte_generic,
+  rgba_to_gs_double_generic,
+  average_rgba_2x2_generic,
+  dot_product_gs_byte_generic,
+  add_scaled_double_generic
+};
+
+
+#ifdef PIXELKERNELS_X86
+
+/*
+ * SSE2 implementation.
+ *
+ * The greyscale value is (75 * R + 147 * G + 35 * B) >> 8. Masking a
+ * pixel with 0x00ff00ff gives the 16 bit values R and B. Shifting it
+ * by 8 bits first gives G and A. A multiply-add of these 16 bit pairs
+ * with the weights (75, 35) and (147, 0) yields 32 bit sums in pixel
+ * order.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i gs_sse2(__m128i p) {
+  const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+  const __m128i w_rb = _mm_set1_epi32((35 << 16) | 75);
+  const __m128i w_ga = _mm_set1_epi32(147);
+  __m128i rb = _mm_madd_epi16(_mm_and_si128(p, mask), w_rb);
+  __m128i ga = _mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(p, 8), mask), w_ga);
+  return _mm_srli_epi32(_mm_add_epi32(rb, ga), 8);
+}
+
+__attribute__((target("sse2")))
+static void rgba_to_gs_byte_sse2(rgba_pixel_t const * src, gs_byte_pixel_t * dst, size_t n) {
+  size_t i = 0;
+  for(; i + 16 <= n; i += 16) {
+    __m128i g0 = gs_sse2(_mm_loadu_si128((__m128i const *)(src + i)));
+    __m128i g1 = gs_sse2(_mm_loadu_si128((__m128i const *)(src + i + 4)));
+    __m128i g2 = gs_sse2(_mm_loadu_si128((__m128i const *)(src + i + 8)));
+    __m128i g3 = gs_sse2(_mm_loadu_si128((__m128i const *)(src + i + 12)));
+    __m128i b = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+    _mm_storeu_si128((__m128i *)(dst + i), b);
+  }
+  rgba_to_gs_byte_generic(src + i, dst + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void rgba_to_gs_double_sse2(rgba_pixel_t const * src, gs_double_pixel_t * dst, size_t n) {
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4) {
+    __m128i g = gs_sse2(_mm_loadu_si128((__m128i const *)(src + i)));
+    _mm_storeu_pd(dst + i, _mm_cvtepi32_pd(g));
+    _mm_storeu_pd(dst + i + 2, _mm_cvtepi32_pd(_mm_srli_si128(g, 8)));
+  }
+  rgba_to_gs_double_generic(src + i, dst + i, n - i);
+}
+
+/*
+ * Sum up the channels of two neighbouring pixels. The 16 bit channel
+ * sums of pixel pair (0, 1) end up in the lower and the sums of pair
+ * (2, 3) in the upper 64 bits.
+ */
+__attribute__((target("sse2")))
+static inline __m128i pair_sums_sse2(__m128i row0, __m128i row1) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+  __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+  lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+  hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+  return _mm_srli_epi16(_mm_unpacklo_epi64(lo, hi), 2);
+}
+
+__attribute__((target("sse2")))
+static void average_rgba_2x2_sse2(rgba_pixel_t const * row0, rgba_pixel_t const * row1,
+				  rgba_pixel_t * dst, size_t n) {
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4) {
+    __m128i a = pair_sums_sse2(_mm_loadu_si128((__m128i const *)(row0 + 2*i)),
+			       _mm_loadu_si128((__m128i const *)(row1 + 2*i)));
+    __m128i b = pair_sums_sse2(_mm_loadu_si128((__m128i const *)(row0 + 2*i + 4)),
+			       _mm_loadu_si128((__m128i const *)(row1 + 2*i + 4)));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+  }
+  average_rgba_2x2_generic(row0 + 2*i, row1 + 2*i, dst + i, n - i);
+}
+
+/*
+ * The pixels are widened to 16 bit and multiplied with a multiply-add
+ * into 32 bit sums. A 32 bit lane gains at most 4 * 255 * 255 per
+ * iteration, so the lanes are flushed into 64 bit sums in chunks. The
+ * sums of a are calculated with a sum of absolute differences to 0.
+ * A multiply-add of unsigned and signed bytes (maddubs) does not fit,
+ * because it saturates for pixel values above 127.
+ */
+
+// Iterations between two flushes of the 32 bit lanes.
+#define DOT_PRODUCT_CHUNK 4096
+
+__attribute__((target("sse2")))
+static inline uint64_t horizontal_sum_epi64_sse2(__m128i v) {
+  uint64_t sums[2];
+  _mm_storeu_si128((__m128i *)sums, v);
+  return sums[0] + sums[1];
+}
+
+__attribute__((target("sse2")))
+static uint64_t dot_product_gs_byte_sse2(gs_byte_pixel_t const * a, gs_byte_pixel_t const * b,
+					 size_t n, uint64_t * sum_a) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc_ab = zero, acc_a = zero;
+  size_t i = 0;
+
+  while(i + 16 <= n) {
+    __m128i acc32 = zero;
+    for(size_t j = 0; j < DOT_PRODUCT_CHUNK && i + 16 <= n; j++, i += 16) {
+      __m128i va = _mm_loadu_si128((__m128i const *)(a + i));
+      __m128i vb = _mm_loadu_si128((__m128i const *)(b + i));
+      acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero),
+						  _mm_unpacklo_epi8(vb, zero)));
+      acc32 = _mm_add_epi32(acc32, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero),
+						  _mm_unpackhi_epi8(vb, zero)));
+      acc_a = _mm_add_epi64(acc_a, _mm_sad_epu8(va, zero));
+    }
+    acc_ab = _mm_add_epi64(acc_ab, _mm_unpacklo_epi32(acc32, zero));
+    acc_ab = _mm_add_epi64(acc_ab, _mm_unpackhi_epi32(acc32, zero));
+  }
+
+  uint64_t rest_a;
+  uint64_t sum_ab = horizontal_sum_epi64_sse2(acc_ab) +
+    dot_product_gs_byte_generic(a + i, b + i, n - i, &rest_a);
+  *sum_a = horizontal_sum_epi64_sse2(acc_a) + rest_a;
+  return sum_ab;
+}
+
+__attribute__((target("sse2")))
+static void add_scaled_double_sse2(double const * src, double factor, double * dst, size_t n) {
+  const __m128d f = _mm_set1_pd(factor);
+  size_t i = 0;
+  for(; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i),
+				      _mm_mul_pd(f, _mm_loadu_pd(src + i))));
+  add_scaled_double_generic(src + i, factor, dst + i, n - i);
+}
+
+static const PixelKernels kernels_sse2 = {
+  "sse2",
+  rgba_to_gs_byte_sse2,
+  rgba_to_gs_double_sse2,
+  average_rgba_2x2_sse2,
+  dot_product_gs_byte_sse2,
+  add_scaled_double_sse2
+};
+
+
+/*
+ * AVX2 implementation. It works like the SSE2 implementation, but
+ * packing and unpacking work within 128 bit lanes. Permutes restore
+ * the pixel order.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256i gs_avx2(__m256i p) {
+  const __m256i mask = _mm256_set1_epi32(0x00ff00ff);
+  const __m256i w_rb = _mm256_set1_epi32((35 << 16) | 75);
+  const __m256i w_ga = _mm256_set1_epi32(147);
+  __m256i rb = _mm256_madd_epi16(_mm256_and_si256(p, mask), w_rb);
+  __m256i ga = _mm256_madd_epi16(_mm256_and_si256(_mm256_srli_epi32(p, 8), mask), w_ga);
+  return _mm256_srli_epi32(_mm256_add_epi32(rb, ga), 8);
+}
+
+__attribute__((target("avx2")))
+static void rgba_to_gs_byte_avx2(rgba_pixel_t const * src, gs_byte_pixel_t * dst, size_t n) {
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for(; i + 32 <= n; i += 32) {
+    __m256i g0 = gs_avx2(_mm256_loadu_si256((__m256i const *)(src + i)));
+    __m256i g1 = gs_avx2(_mm256_loadu_si256((__m256i const *)(src + i + 8)));
+    __m256i g2 = gs_avx2(_mm256_loadu_si256((__m256i const *)(src + i + 16)));
+    __m256i g3 = gs_avx2(_mm256_loadu_si256((__m256i const *)(src + i + 24)));
+    __m256i b = _mm256_packus_epi16(_mm256_packs_epi32(g0, g1), _mm256_packs_epi32(g2, g3));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(b, order));
+  }
+  rgba_to_gs_byte_sse2(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void rgba_to_gs_double_avx2(rgba_pixel_t const * src, gs_double_pixel_t * dst, size_t n) {
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m256i g = gs_avx2(_mm256_loadu_si256((__m256i const *)(src + i)));
+    _mm256_storeu_pd(dst + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(g)));
+    _mm256_storeu_pd(dst + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(g, 1)));
+  }
+  rgba_to_gs_double_sse2(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pair_sums_avx2(__m256i row0, __m256i row1) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+  __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+  lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+  hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+  return _mm256_srli_epi16(_mm256_unpacklo_epi64(lo, hi), 2);
+}
+
+__attribute__((target("avx2")))
+static void average_rgba_2x2_avx2(rgba_pixel_t const * row0, rgba_pixel_t const * row1,
+				  rgba_pixel_t * dst, size_t n) {
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m256i a = pair_sums_avx2(_mm256_loadu_si256((__m256i const *)(row0 + 2*i)),
+			       _mm256_loadu_si256((__m256i const *)(row1 + 2*i)));
+    __m256i b = pair_sums_avx2(_mm256_loadu_si256((__m256i const *)(row0 + 2*i + 8)),
+			       _mm256_loadu_si256((__m256i const *)(row1 + 2*i + 8)));
+    __m256i p = _mm256_packus_epi16(a, b);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  average_rgba_2x2_sse2(row0 + 2*i, row1 + 2*i, dst + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static uint64_t dot_product_gs_byte_avx2(gs_byte_pixel_t const * a, gs_byte_pixel_t const * b,
+					 size_t n, uint64_t * sum_a) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc_ab = zero, acc_a = zero;
+  size_t i = 0;
+
+  while(i + 32 <= n) {
+    __m256i acc32 = zero;
+    for(size_t j = 0; j < DOT_PRODUCT_CHUNK && i + 32 <= n; j++, i += 32) {
+      __m256i va = _mm256_loadu_si256((__m256i const *)(a + i));
+      __m256i vb = _mm256_loadu_si256((__m256i const *)(b + i));
+      acc32 = _mm256_add_epi32(acc32, _mm256_madd_epi16(_mm256_unpacklo_epi8(va, zero),
+							_mm256_unpacklo_epi8(vb, zero)));
+      acc32 = _mm256_add_epi32(acc32, _mm256_madd_epi16(_mm256_unpackhi_epi8(va, zero),
+							_mm256_unpackhi_epi8(vb, zero)));
+      acc_a = _mm256_add_epi64(acc_a, _mm256_sad_epu8(va, zero));
+    }
+    acc_ab = _mm256_add_epi64(acc_ab, _mm256_unpacklo_epi32(acc32, zero));
+    acc_ab = _mm256_add_epi64(acc_ab, _mm256_unpackhi_epi32(acc32, zero));
+  }
+
+  __m128i ab = _mm_add_epi64(_mm256_castsi256_si128(acc_ab), _mm256_extracti128_si256(acc_ab, 1));
+  __m128i sa = _mm_add_epi64(_mm256_castsi256_si128(acc_a), _mm256_extracti128_si256(acc_a, 1));
+
+  uint64_t rest_a;
+  uint64_t sum_ab = horizontal_sum_epi64_sse2(ab) +
+    dot_product_gs_byte_sse2(a + i, b + i, n - i, &rest_a);
+  *sum_a = horizontal_sum_epi64_sse2(sa) + rest_a;
+  return sum_ab;
+}
+
+// Without FMA, so that the results are the same as for the other kernels.
+__attribute__((target("avx2")))
+static void add_scaled_double_avx2(double const * src, double factor, double * dst, size_t n) {
+  const __m256d f = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m256d a = _mm256_add_pd(_mm256_loadu_pd(dst + i), _mm256_mul_pd(f, _mm256_loadu_pd(src + i)));
+    __m256d b = _mm256_add_pd(_mm256_loadu_pd(dst + i + 4), _mm256_mul_pd(f, _mm256_loadu_pd(src + i + 4)));
+    _mm256_storeu_pd(dst + i, a);
+    _mm256_storeu_pd(dst + i + 4, b);
+  }
+  add_scaled_double_sse2(src + i, factor, dst + i, n - i);
+}
+
+static const PixelKernels kernels_avx2 = {
+  "avx2",
+  rgba_to_gs_byte_avx2,
+  rgba_to_gs_double_avx2,
+  average_rgba_2x2_avx2,
+  dot_product_gs_byte_avx2,
+  add_scaled_double_avx2
+};
+
+#endif // PIXELKERNELS_X86
+
+
+std::vector<PixelKernels const*> degate::get_supported_pixel_kernels() {
+  std::vector<PixelKernels const*> kernels;
+  kernels.push_back(&kernels_generic);
+
+#ifdef PIXELKERNELS_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse2")) kernels.push_back(&kernels_sse2);
+  if(__builtin_cpu_supports("avx2")) kernels.push_back(&kernels_avx2);
+#endif
+
+  return kernels;
+}
+
+PixelKernels const& degate::get_pixel_kernels() {
+  static PixelKernels const& kernels = *get_supported_pixel_kernels().back();
+  return kernels;
+}
@@ -0,0 +1,115 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PIXELKERNELS_H__
+#define __PIXELKERNELS_H__
+
+#include <PixelPolicies.h>
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace degate {
+
+  /**
+   * A set of functions, that process rows of pixels.
+   *
+   * There are implementations for plain C++, SSE2 and AVX2. All
+   * implementations calculate exactly the same results as the pixel
+   * macros RGBA_TO_GS_BY_VAL() and MASK_R() etc. Floating point kernels
+   * round each multiplication and addition, as the plain C++ code does.
+   * The implementation is selected at runtime depending on the CPU.
+   */
+  struct PixelKernels {
+
+    /** Name of the instruction set, e.g. "avx2". */
+    const char * name;
+
+    /**
+     * Convert \p n RGBA pixels into greyscale pixels.
+     */
+    void (*rgba_to_gs_byte)(rgba_pixel_t const * src, gs_byte_pixel_t * dst, size_t n);
+
+    /**
+     * Convert \p n RGBA pixels into greyscale pixels of type double.
+     */
+    void (*rgba_to_gs_double)(rgba_pixel_t const * src, gs_double_pixel_t * dst, size_t n);
+
+    /**
+     * Calculate \p n pixels as channel-wise mean of 2x2 pixel blocks.
+     * Output pixel i is calculated from the pixels 2i and 2i+1 of
+     * both rows \p row0 and \p row1.
+     */
+    void (*average_rgba_2x2)(rgba_pixel_t const * row0, rgba_pixel_t const * row1,
+			     rgba_pixel_t * dst, size_t n);
+
+    /**
+     * Calculate the dot product of \p n greyscale pixels of \p a
+     * and \p b. The sum over the pixels of \p a is stored in \p sum_a.
+     */
+    uint64_t (*dot_product_gs_byte)(gs_byte_pixel_t const * a, gs_byte_pixel_t const * b,
+				    size_t n, uint64_t * sum_a);
+
+    /**
+     * Add \p n values of \p src multiplied by \p factor to \p dst.
+     */
+    void (*add_scaled_double)(double const * src, double factor, double * dst, size_t n);
+  };
+
+
+  /**
+   * Get the fastest kernel implementation, that is supported by the CPU.
+   */
+  PixelKernels const& get_pixel_kernels();
+
+  /**
+   * Get all kernel implementations, that are supported by the CPU. The
+   * first element is the plain C++ implementation.
+   */
+  std::vector<PixelKernels const*> get_supported_pixel_kernels();
+
+
+  inline void convert_rgba_to_gs_byte(rgba_pixel_t const * src, gs_byte_pixel_t * dst, size_t n) {
+    get_pixel_kernels().rgba_to_gs_byte(src, dst, n);
+  }
+
+  inline void convert_rgba_to_gs_double(rgba_pixel_t const * src, gs_double_pixel_t * dst, size_t n) {
+    get_pixel_kernels().rgba_to_gs_double(src, dst, n);
+  }
+
+  inline void average_rgba_2x2(rgba_pixel_t const * row0, rgba_pixel_t const * row1,
+			       rgba_pixel_t * dst, size_t n) {
+    get_pixel_kernels().average_rgba_2x2(row0, row1, dst, n);
+  }
+
+  inline uint64_t dot_product_gs_byte(gs_byte_pixel_t const * a, gs_byte_pixel_t const * b,
+				      size_t n, uint64_t * sum_a) {
+    return get_pixel_kernels().dot_product_gs_byte(a, b, n, sum_a);
+  }
+
+  inline void add_scaled_row(double const * src, double factor, double * dst, size_t n) {
+    get_pixel_kernels().add_scaled_double(src, factor, dst, n);
+  }
+
+}
+
+#endif
@@ -30,12 +30,16 @@ namespace degate {
   enum IMAGE_TYPE {
     IMAGE_TYPE_GS_BYTE = 1,
     IMAGE_TYPE_GS_DOUBLE = 2,
-    IMAGE_TYPE_RGBA = 3
+    IMAGE_TYPE_RGBA = 3,
+    IMAGE_TYPE_SUM_UINT32 = 4,
+    IMAGE_TYPE_SUM_INT64 = 5
   };
 
   typedef uint8_t gs_byte_pixel_t;
   typedef double gs_double_pixel_t;
   typedef uint32_t rgba_pixel_t;
+  typedef uint32_t sum_uint32_pixel_t;
+  typedef int64_t sum_int64_pixel_t;
 
   /* -------------------------------------------------------------------------- *
    * pixel type policies
@@ -86,6 +90,35 @@ namespace degate {
     static bool is_single_channel() { return true; }
   };
 
+  /**
+   * Pixel policy for summation tables over 8 bit images. The sums
+   * wrap around. Differences of table values are still exact, as long
+   * as the summed up region has less than 2^24 pixels.
+   *
+   * The pixel type is the same as the RGBA pixel type. Therefore pixel
+   * values of this policy must not be converted with convert_pixel().
+   */
+
+  class PixelPolicy_SUM_UINT32 : public PixelPolicy_Base {
+  protected:
+    static const IMAGE_TYPE image_type = IMAGE_TYPE_SUM_UINT32;
+  public:
+    typedef sum_uint32_pixel_t pixel_type;
+    static bool is_single_channel() { return true; }
+  };
+
+  /**
+   * Pixel policy for summation tables with 64 bit integer values.
+   */
+
+  class PixelPolicy_SUM_INT64 : public PixelPolicy_Base {
+  protected:
+    static const IMAGE_TYPE image_type = IMAGE_TYPE_SUM_INT64;
+  public:
+    typedef sum_int64_pixel_t pixel_type;
+    static bool is_single_channel() { return true; }
+  };
+
 }
 
 #endif
@@ -0,0 +1,80 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <degate.h>
+#include <PreparedTemplateCache.h>
+
+using namespace degate;
+
+PreparedTemplateImages_shptr PreparedTemplateCache::get(GateTemplate_shptr tmpl,
+							 Gate::ORIENTATION orientation,
+							 Layer::LAYER_TYPE layer_type,
+							 unsigned int scaling) const {
+
+  if(tmpl == NULL) throw InvalidPointerException("Invalid pointer for gate template.");
+
+  boost::mutex::scoped_lock lock(mtx);
+
+  std::map<key_type, entry>::const_iterator found =
+    entries.find(key_type(tmpl->get_object_id(), orientation, layer_type, scaling));
+
+  if(found == entries.end() || found->second.image_revision != tmpl->get_image_revision())
+    return PreparedTemplateImages_shptr();
+
+  return found->second.images;
+}
+
+void PreparedTemplateCache::put(GateTemplate_shptr tmpl,
+				Gate::ORIENTATION orientation,
+				Layer::LAYER_TYPE layer_type,
+				unsigned int scaling,
+				PreparedTemplateImages_shptr images) {
+
+  if(tmpl == NULL) throw InvalidPointerException("Invalid pointer for gate template.");
+  if(images == NULL) throw InvalidPointerException("Invalid pointer for prepared images.");
+
+  boost::mutex::scoped_lock lock(mtx);
+
+  entry & e = entries[key_type(tmpl->get_object_id(), orientation, layer_type, scaling)];
+  e.image_revision = tmpl->get_image_revision();
+  e.images = images;
+}
+
+void PreparedTemplateCache::invalidate(object_id_t tmpl_id) {
+
+  boost::mutex::scoped_lock lock(mtx);
+
+  std::map<key_type, entry>::iterator iter = entries.begin();
+  while(iter != entries.end()) {
+    if(std::get<0>(iter->first) == tmpl_id) entries.erase(iter++);
+    else ++iter;
+  }
+}
+
+void PreparedTemplateCache::clear() {
+  boost::mutex::scoped_lock lock(mtx);
+  entries.clear();
+}
+
+size_t PreparedTemplateCache::size() const {
+  boost::mutex::scoped_lock lock(mtx);
+  return entries.size();
+}
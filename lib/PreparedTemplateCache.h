@@ -0,0 +1,149 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __PREPAREDTEMPLATECACHE_H__
+#define __PREPAREDTEMPLATECACHE_H__
+
+#include <globals.h>
+#include <Image.h>
+#include <Layer.h>
+#include <Gate.h>
+#include <GateTemplate.h>
+
+#include <map>
+#include <vector>
+#include <tuple>
+#include <boost/thread/mutex.hpp>
+
+namespace degate {
+
+  /**
+   * Sums over the bottom rows of a zero mean template. Index i holds
+   * the sums over the rows y >= i. There is an additional entry of 0
+   * for the rows below the template.
+   */
+  struct RemainingRowSums {
+    std::vector<double> single;
+    std::vector<double> squared;
+  };
+
+  /**
+   * The images of a gate template in a single orientation, that are
+   * prepared for template matching.
+   */
+  struct PreparedTemplateImages {
+    MemoryImage_GS_BYTE_shptr tmpl_img_normal;
+    MemoryImage_GS_BYTE_shptr tmpl_img_scaled;
+
+    // The correlation is calculated on the 8 bit templates. The zero
+    // mean is applied with the mean value of a template.
+    double mean_normal;
+    double mean_scaled;
+
+    // Only needed for FFT based correlation.
+    MemoryImage_GS_DOUBLE_shptr zero_mean_template_scaled;
+
+    double sum_over_zero_mean_template_normal;
+    double sum_over_zero_mean_template_scaled;
+
+    RemainingRowSums remaining_rows_normal;
+    RemainingRowSums remaining_rows_scaled;
+
+    // Templates for the scaling levels between the scaled and the normal
+    // image, from coarse to fine. A template, that is empty or flat on
+    // a level, has a sum of 0.
+    std::vector<MemoryImage_GS_BYTE_shptr> tmpl_img_refine;
+    std::vector<double> mean_refine;
+    std::vector<double> sum_over_zero_mean_template_refine;
+    std::vector<RemainingRowSums> remaining_rows_refine;
+  };
+
+  typedef std::shared_ptr<const PreparedTemplateImages> PreparedTemplateImages_shptr;
+
+
+  /**
+   * A cache for prepared template images. It is part of the gate library,
+   * so that template images are prepared only once for all matching runs.
+   *
+   * Entries are stored together with the image revision of the gate
+   * template. An entry is outdated, if a reference image of the template
+   * was set in the meantime.
+   *
+   * The cache can be used from multiple threads.
+   */
+  class PreparedTemplateCache {
+
+  private:
+
+    typedef std::tuple<object_id_t, Gate::ORIENTATION, Layer::LAYER_TYPE, unsigned int> key_type;
+
+    struct entry {
+      unsigned int image_revision;
+      PreparedTemplateImages_shptr images;
+    };
+
+    std::map<key_type, entry> entries;
+    mutable boost::mutex mtx;
+
+  public:
+
+    /**
+     * Lookup prepared images.
+     * @param tmpl The gate template.
+     * @param orientation The orientation of the template.
+     * @param layer_type The layer type of the reference image.
+     * @param scaling The scaling factor of the scaled template image.
+     * @return Returns a NULL pointer, if there are no images or if
+     *   they are outdated.
+     */
+    PreparedTemplateImages_shptr get(GateTemplate_shptr tmpl,
+				     Gate::ORIENTATION orientation,
+				     Layer::LAYER_TYPE layer_type,
+				     unsigned int scaling) const;
+
+    /**
+     * Store prepared images for the current image revision of the template.
+     */
+    void put(GateTemplate_shptr tmpl,
+	     Gate::ORIENTATION orientation,
+	     Layer::LAYER_TYPE layer_type,
+	     unsigned int scaling,
+	     PreparedTemplateImages_shptr images);
+
+    /**
+     * Remove all entries of a gate template.
+     */
+    void invalidate(object_id_t tmpl_id);
+
+    /**
+     * Remove all entries.
+     */
+    void clear();
+
+    /**
+     * Get the number of entries.
+     */
+    size_t size() const;
+  };
+
+}
+
+#endif
@@ -49,7 +49,7 @@ namespace degate {
     std::string log_message;
     bool log_message_set;
 
-    boost::recursive_mutex mtx;
+    mutable boost::recursive_mutex mtx;
 
   private:
 
@@ -73,7 +73,7 @@ namespace degate {
      * Set progress.
      */
     virtual void set_progress(double progress) {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       this->progress = progress;
     }
 
@@ -81,7 +81,7 @@ namespace degate {
      * Set step size.
      */
     virtual void set_progress_step_size(double step_size) {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       this->step_size = step_size;
     }
 
@@ -89,7 +89,7 @@ namespace degate {
      * Increase progress.
      */
     virtual void progress_step_done() {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       progress += step_size;
     }
 
@@ -97,7 +97,7 @@ namespace degate {
      * Reset progress and cancel state.
      */
     virtual void reset_progress() {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       time_started = time(NULL);
       canceled = false;
       progress = 0;
@@ -128,7 +128,7 @@ namespace degate {
      */
 
     virtual bool is_canceled() const {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       return canceled;
     }
 
@@ -137,7 +137,7 @@ namespace degate {
      */
 
     virtual void cancel() {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       canceled = true;
     }
 
@@ -148,7 +148,7 @@ namespace degate {
      */
 
     virtual double get_progress() const {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       return progress;
     }
 
@@ -156,7 +156,7 @@ namespace degate {
      * Get (real) time since the progress counter was resetted.
      */
     virtual time_t get_time_passed() const {
-      boost::mutex::scoped_lock(m_mutex);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       return time(NULL) - time_started;
     }
 
@@ -166,14 +166,14 @@ namespace degate {
      *   that time cannot be calculated.
      */
     virtual time_t get_time_left() const {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       if(progress < 1.0)
 	return progress > 0 ? (1.0 - progress) * get_time_passed() / progress : -1;
       return 0;
     }
 
     virtual std::string get_time_left_as_string() {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       time_t time_left = get_time_left_averaged();
       if(time_left == -1) return std::string("-");
       else {
@@ -193,18 +193,18 @@ namespace degate {
 
 
     virtual void set_log_message(std::string const& msg) {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       log_message = msg;
       log_message_set = true;
     }
 
     virtual std::string get_log_message() const {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       return log_message;
     }
 
     virtual bool has_log_message() const {
-      boost::recursive_mutex::scoped_lock(mtx);
+      boost::recursive_mutex::scoped_lock lock(mtx);
       return log_message_set;
     }
   };
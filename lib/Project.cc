@@ -240,6 +240,7 @@ void Project::init_default_values() {
 
   pixel_per_um = 0;
   font_size = 12;
+  tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE;
 
   // A B G R
   default_colors[DEFAULT_COLOR_WIRE] = 0xff00a3fb;
@@ -333,6 +334,14 @@ unsigned int Project::get_font_size() const {
   return font_size;
 }
 
+void Project::set_tile_storage(MAP_STORAGE_TYPE tile_storage) {
+  this->tile_storage = tile_storage;
+}
+
+MAP_STORAGE_TYPE Project::get_tile_storage() const {
+  return tile_storage;
+}
+
 
 RCBase::container_type & Project::get_rcv_blacklist() {
   return rcv_blacklist;
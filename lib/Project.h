@@ -29,6 +29,7 @@
 #include <LogicModel.h>
 #include <PortColorManager.h>
 #include <RCBase.h>
+#include <MemoryMap.h>
 
 #include <boost/date_time.hpp>
 
@@ -102,6 +103,8 @@ namespace degate {
     RCBase::container_type rcv_blacklist;
 
     unsigned int font_size;
+
+    MAP_STORAGE_TYPE tile_storage;
   private:
 
     void init_default_values();
@@ -325,6 +328,20 @@ namespace degate {
      */
     unsigned int get_font_size() const;
 
+    /**
+     * Set the file format for the tiles of new background images. This is
+     * either MAP_STORAGE_TYPE_PERSISTENT_FILE for raw tiles or
+     * MAP_STORAGE_TYPE_COMPRESSED_FILE or MAP_STORAGE_TYPE_PACK_FILE. Existing background images are not
+     * converted.
+     * @see convert_background_images()
+     */
+    void set_tile_storage(MAP_STORAGE_TYPE tile_storage);
+
+    /**
+     * Get the file format for the tiles of background images.
+     */
+    MAP_STORAGE_TYPE get_tile_storage() const;
+
     /**
      * Get a list of blacklisted Rule Check violations.
      */
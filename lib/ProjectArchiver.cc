@@ -87,8 +87,12 @@ void ProjectArchiver::add_directory(struct zip * zip_archive,
 #else
       std::string rel_dir = get_filename_from_path(stripped.native_file_string());
 #endif
-      std::string pattern = "scaling_";
-      bool skip = rel_dir.length() >= pattern.length() && (rel_dir.compare(0, pattern.length(), pattern) == 0);
+      // Prescaled images, greyscale images and summation tables are
+      // recalculated on demand.
+      bool skip = false;
+      const std::string patterns[] = { "scaling_", "sum_tables_", "greyscale_" };
+      BOOST_FOREACH(std::string const& pattern, patterns)
+	if(rel_dir.compare(0, pattern.length(), pattern) == 0) skip = true;
 
       if(!skip) {
 
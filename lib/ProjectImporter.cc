@@ -217,10 +217,11 @@ void ProjectImporter::load_background_image(Layer_shptr layer,
 
       debug(TM, "project importer loads an tile based image from [%s]", image_path_to_load.c_str());
 
-      BackgroundImage_shptr bg_image =
-	load_degate_image<BackgroundImage>(prj->get_width(),
-					   prj->get_height(),
-					   image_path_to_load);
+      BackgroundImage_shptr bg_image(new BackgroundImage(prj->get_width(),
+							 prj->get_height(),
+							 image_path_to_load,
+							 true, 10,
+							 prj->get_tile_storage()));
 
       if(bg_image == NULL)
 	throw DegateRuntimeException("Failed to load the background image");
@@ -249,7 +250,9 @@ void ProjectImporter::load_background_image(Layer_shptr layer,
 	// create new background image
 	BackgroundImage_shptr new_bg_image(new BackgroundImage(prj->get_width(),
 							       prj->get_height(),
-							       new_dir));
+							       new_dir,
+							       true, 10,
+							       prj->get_tile_storage()));
 
 	// load old single file image
 	PersistentImage_RGBA_shptr old_bg_image =
@@ -266,6 +269,7 @@ void ProjectImporter::load_background_image(Layer_shptr layer,
 	      new_dir.c_str());
 
 	copy_image(new_bg_image, old_bg_image);
+	new_bg_image->sync();
 
 	layer->set_image(new_bg_image);
 
@@ -278,7 +282,9 @@ void ProjectImporter::load_background_image(Layer_shptr layer,
 
 	BackgroundImage_shptr new_bg_image(new BackgroundImage(prj->get_width(),
 							       prj->get_height(),
-							       new_dir));
+							       new_dir,
+							       true, 10,
+							       prj->get_tile_storage()));
 
 	layer->set_image(new_bg_image);
       }
@@ -444,6 +450,15 @@ void ProjectImporter::parse_project_element(Project_shptr parent_prj,
   parent_prj->set_template_dimension(parse_number<int>(project_elem, "template-dimension", 0));
   parent_prj->set_font_size(parse_number<unsigned int>(project_elem, "font-size", 10));
 
+  // Projects without this attribute use raw tiles.
+  std::string tile_storage = project_elem->get_attribute_value("tile-storage");
+  if(tile_storage == "compressed")
+    parent_prj->set_tile_storage(MAP_STORAGE_TYPE_COMPRESSED_FILE);
+  else if(tile_storage == "pack")
+    parent_prj->set_tile_storage(MAP_STORAGE_TYPE_PACK_FILE);
+  else
+    parent_prj->set_tile_storage(MAP_STORAGE_TYPE_PERSISTENT_FILE);
+
   const xmlpp::Element * e = get_dom_twig(project_elem, "grids");
   if(e != NULL) parse_grids_element(e, parent_prj);
 
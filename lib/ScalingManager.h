@@ -23,11 +23,19 @@
 #define __SCALINGMANAGER_H__
 
 #include "Image.h"
+#include "Configuration.h"
+#include "GreyscaleImageCache.h"
+#include "WorkerThreads.h"
 
 #include <map>
+#include <list>
+#include <vector>
 #include <assert.h>
 #include <algorithm>
 
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
 namespace degate {
 
   /**
@@ -37,6 +45,12 @@ namespace degate {
    * scale_down().
    *
    * @see ImageManipulation::scale_down()
+   *
+   * Prescaled images are calculated tile by tile from multiple threads.
+   * A tile of a scaling level depends only on the tiles of the next
+   * larger level, that cover the same region. A tile is calculated as
+   * soon as these tiles are done, so that all levels are built at the
+   * same time.
    */
   template<class ImageType>
   class ScalingManager {
@@ -54,8 +68,211 @@ namespace degate {
 
     unsigned int min_size;
 
+    std::shared_ptr<GreyscaleImageCache<ImageType> > greyscale_cache;
+
+    /**
+     * The state of a scaling level while its tiles are calculated.
+     */
+    struct level_state {
+      std::shared_ptr<ImageType> img;
+      unsigned int tile_size, tiles_x, tiles_y;
+
+      // Flags tiles, that have to be calculated. For the master image
+      // it flags the tiles, that were modified.
+      std::vector<char> build;
+
+      // Number of tiles in the larger level, that must be calculated,
+      // before the tile can be calculated.
+      std::vector<unsigned int> pending;
+    };
+
+    struct tile_task {
+      unsigned int level, tile_x, tile_y;
+    };
+
+    /**
+     * Shared state of the worker threads.
+     */
+    struct build_state {
+      std::vector<level_state> levels;
+      std::list<tile_task> ready;
+      unsigned int remaining;
+      boost::mutex mtx;
+      boost::condition_variable cond;
+
+      // Set, if a worker failed. The other workers stop then.
+      bool failed;
+    };
+
   private:
 
+    /**
+     * Get the range of tiles of the next smaller level, that cover the
+     * same region as tile \p tile in one dimension.
+     * @return Returns false, if there is no such tile.
+     */
+    static bool get_smaller_tiles(unsigned int tile, unsigned int tile_size,
+				  unsigned int other_tile_size, unsigned int other_tiles,
+				  unsigned int & first, unsigned int & last) {
+
+      uint64_t min = (uint64_t)tile * tile_size, max = min + tile_size - 1;
+      first = min / 2 / other_tile_size;
+      last = std::min<uint64_t>(max / 2 / other_tile_size, other_tiles - 1);
+      return first < other_tiles;
+    }
+
+    /**
+     * Add a scaling level to the build state.
+     * @param build_all If true, all tiles of the level are calculated.
+     */
+    void add_level(build_state & s, std::shared_ptr<ImageType> img, bool build_all) {
+      level_state l;
+      l.img = img;
+      l.tile_size = img->get_tile_size();
+      l.tiles_x = (img->get_width() + l.tile_size - 1) / l.tile_size;
+      l.tiles_y = (img->get_height() + l.tile_size - 1) / l.tile_size;
+      l.build.resize(l.tiles_x * l.tiles_y, build_all ? 1 : 0);
+      l.pending.resize(l.tiles_x * l.tiles_y, 0);
+      s.levels.push_back(l);
+    }
+
+    /**
+     * Calculate the flagged tiles of all levels. Tiles, that are
+     * covered by flagged tiles of the next larger level, are flagged too.
+     */
+    void build_levels(build_state & s) {
+
+      s.remaining = 0;
+
+      for(unsigned int i = 1; i < s.levels.size(); i++) {
+	level_state & src = s.levels[i-1];
+	level_state & dst = s.levels[i];
+
+	for(unsigned int y = 0; y < src.tiles_y; y++)
+	  for(unsigned int x = 0; x < src.tiles_x; x++) {
+	    unsigned int x0, x1, y0, y1;
+	    if(src.build[y * src.tiles_x + x] &&
+	       get_smaller_tiles(x, src.tile_size, dst.tile_size, dst.tiles_x, x0, x1) &&
+	       get_smaller_tiles(y, src.tile_size, dst.tile_size, dst.tiles_y, y0, y1)) {
+
+	      for(unsigned int ty = y0; ty <= y1; ty++)
+		for(unsigned int tx = x0; tx <= x1; tx++) {
+		  dst.build[ty * dst.tiles_x + tx] = 1;
+		  // The master image is not calculated here.
+		  if(i > 1) dst.pending[ty * dst.tiles_x + tx]++;
+		}
+	    }
+	  }
+
+	for(unsigned int y = 0; y < dst.tiles_y; y++)
+	  for(unsigned int x = 0; x < dst.tiles_x; x++)
+	    if(dst.build[y * dst.tiles_x + x]) {
+	      s.remaining++;
+	      if(dst.pending[y * dst.tiles_x + x] == 0) {
+		tile_task t = { i, x, y };
+		s.ready.push_back(t);
+	      }
+	    }
+      }
+
+      if(s.remaining == 0) return;
+
+      remove_sum_tables();
+
+      // Levels in a pack file are flagged as incomplete, until all their
+      // tiles are written. An interrupted run is redone on the next start.
+      for(unsigned int i = 1; i < s.levels.size(); i++)
+	if(TilePackFile_shptr pack = s.levels[i].img->get_pack_file())
+	  pack->set_level_valid(s.levels[i].img->get_pack_level(), false);
+
+      unsigned int num_threads = std::min(Configuration::get_instance().get_max_worker_threads(),
+					  s.remaining);
+      // Levels in a pack file stay flagged as incomplete, if a worker fails.
+      s.failed = false;
+      run_parallel(num_threads, boost::bind(&ScalingManager<ImageType>::build_worker,
+					    this, boost::ref(s)));
+
+      // Compressed tiles are only written back on eviction otherwise.
+      for(unsigned int i = 1; i < s.levels.size(); i++) s.levels[i].img->sync();
+
+      for(unsigned int i = 1; i < s.levels.size(); i++)
+	if(TilePackFile_shptr pack = s.levels[i].img->get_pack_file()) {
+	  pack->set_level_valid(s.levels[i].img->get_pack_level(), true);
+	  pack->sync();
+	}
+    }
+
+    /**
+     * Calculate tiles until all tiles are done. If a tile fails, the
+     * waiting workers are woken up before the exception is passed on.
+     */
+    void build_worker(build_state & s) {
+
+      boost::mutex::scoped_lock lock(s.mtx);
+
+      while(true) {
+	while(s.ready.empty() && s.remaining > 0 && !s.failed) s.cond.wait(lock);
+	if(s.remaining == 0 || s.failed) return;
+
+	tile_task t = s.ready.front();
+	s.ready.pop_front();
+
+	level_state & dst = s.levels[t.level];
+	level_state & src = s.levels[t.level - 1];
+
+	lock.unlock();
+
+	try {
+	  scale_down_by_2<ImageType, ImageType>(dst.img, src.img,
+						t.tile_x * dst.tile_size,
+						(t.tile_x + 1) * dst.tile_size,
+						t.tile_y * dst.tile_size,
+						(t.tile_y + 1) * dst.tile_size);
+	}
+	catch(...) {
+	  lock.lock();
+	  s.failed = true;
+	  s.cond.notify_all();
+	  throw;
+	}
+
+	lock.lock();
+	if(s.failed) return;
+	s.remaining--;
+
+	// Release the tiles in the next smaller level, that depend on this tile.
+	unsigned int x0, x1, y0, y1;
+	if(t.level + 1 < s.levels.size()) {
+	  level_state & next = s.levels[t.level + 1];
+	  if(get_smaller_tiles(t.tile_x, dst.tile_size, next.tile_size, next.tiles_x, x0, x1) &&
+	     get_smaller_tiles(t.tile_y, dst.tile_size, next.tile_size, next.tiles_y, y0, y1)) {
+	    for(unsigned int ty = y0; ty <= y1; ty++)
+	      for(unsigned int tx = x0; tx <= x1; tx++)
+		if(--next.pending[ty * next.tiles_x + tx] == 0) {
+		  tile_task n = { t.level + 1, tx, ty };
+		  s.ready.push_back(n);
+		}
+	  }
+	}
+
+	s.cond.notify_all();
+      }
+    }
+
+    /**
+     * Remove the summation tables of all scaling levels, because they
+     * are outdated.
+     */
+    void remove_sum_tables() {
+      for(typename image_map::const_iterator iter = images.begin(); iter != images.end(); ++iter) {
+	std::string dir = get_sum_table_directory(lrint(iter->first));
+	if(!dir.empty() && file_exists(dir)) {
+	  debug(TM, "remove outdated summation tables in %s", dir.c_str());
+	  remove_directory(dir);
+	}
+      }
+    }
+
     unsigned long get_nearest_power_of_two(unsigned int value) {
       unsigned int i = 1;
 
@@ -135,12 +352,28 @@ namespace degate {
       unsigned int w = last_img->get_width();
       unsigned int h = last_img->get_height();
 
+      build_state state;
+      add_level(state, last_img, false);
+
+      TilePackFile_shptr pack = images[1]->get_pack_file();
+      unsigned int level = 0;
+
       for(int i = 2; ((h > min_size) || (w > min_size)) &&
 	    (i < (1<<24));  // max 24 scaling levels
 	  i*=2) {
 
 	w >>= 1;
 	h >>= 1;
+	level++;
+
+	// Scaled images of a pack file based image are stored in the same file.
+	if(pack != NULL && level < pack->get_num_levels()) {
+	  debug(TM, "use level %d of the pack file for scaling factor %d", level, i);
+	  last_img = std::shared_ptr<ImageType>(new ImageType(w, h, pack, level));
+	  add_level(state, last_img, !pack->is_level_valid(level));
+	  images[i] = last_img;
+	  continue;
+	}
 
 	// create a new image
 	char dir_name[PATH_MAX];
@@ -153,20 +386,95 @@ namespace degate {
 	  create_directory(dir_path);
 
 	  std::shared_ptr<ImageType> new_img(new ImageType(w, h, dir_path,
-								images[1]->is_persistent()));
+								images[1]->is_persistent(),
+								images[1]->get_tile_width_exp(),
+								images[1]->get_tile_storage()));
 
-	  scale_down_by_2<ImageType, ImageType>(new_img, last_img);
 	  last_img = new_img;
+	  add_level(state, last_img, true);
 	}
 	else {
 	  debug(TM, "no");
 	  std::shared_ptr<ImageType> new_img(new ImageType(w, h, dir_path,
-								images[1]->is_persistent()));
+								images[1]->is_persistent(),
+								images[1]->get_tile_width_exp(),
+								images[1]->get_tile_storage()));
 
 	  last_img = new_img;
+	  add_level(state, last_img, false);
 	}
 	images[i] = last_img;
       }
+
+      // The cache refers to the old scaling levels.
+      greyscale_cache.reset();
+
+      build_levels(state);
+    }
+
+    /**
+     * Recalculate the prescaled images for a region of the master image.
+     * Call this method, if a part of the master image was modified.
+     * @param region The modified region in coordinates of the master image.
+     */
+    void update_scalings(BoundingBox const& region) {
+
+      build_state state;
+      for(typename image_map::iterator iter = images.begin(); iter != images.end(); ++iter)
+	add_level(state, iter->second, false);
+
+      level_state & master = state.levels[0];
+      if(master.tiles_x == 0 || master.tiles_y == 0) return;
+
+      // There might be no scaling level, that is rebuilt.
+      remove_sum_tables();
+      if(greyscale_cache != NULL) greyscale_cache->invalidate(region);
+
+      unsigned int x0 = std::min<unsigned int>(std::max(region.get_min_x(), 0) / master.tile_size,
+					       master.tiles_x - 1);
+      unsigned int x1 = std::min<unsigned int>(std::max(region.get_max_x(), 0) / master.tile_size,
+					       master.tiles_x - 1);
+      unsigned int y0 = std::min<unsigned int>(std::max(region.get_min_y(), 0) / master.tile_size,
+					       master.tiles_y - 1);
+      unsigned int y1 = std::min<unsigned int>(std::max(region.get_max_y(), 0) / master.tile_size,
+					       master.tiles_y - 1);
+
+      for(unsigned int y = y0; y <= y1; y++)
+	for(unsigned int x = x0; x <= x1; x++)
+	  master.build[y * master.tiles_x + x] = 1;
+
+      build_levels(state);
+    }
+
+    /**
+     * Get the directory for summation tables and other data, that is
+     * derived from a region of a scaling level. The directory is placed
+     * next to the prescaled images. It is removed, if the master
+     * image is modified.
+     * @param scaling The scaling factor of the level.
+     * @return Returns an empty string, if the images are not persistent.
+     */
+    std::string get_sum_table_directory(unsigned int scaling) const {
+      typename image_map::const_iterator master = images.find(1);
+      if(master == images.end() || !master->second->is_persistent()) return "";
+
+      char dir_name[PATH_MAX];
+      snprintf(dir_name, sizeof(dir_name), "sum_tables_%d.dimg", scaling);
+      return join_pathes(master->second->get_directory(), std::string(dir_name));
+    }
+
+    /**
+     * Get the cache for greyscaled versions of the scaling levels.
+     * Recognition algorithms should use it, instead of converting the
+     * background image for themselves. The cache is created on first use.
+     */
+    std::shared_ptr<GreyscaleImageCache<ImageType> > get_greyscale_cache() {
+      if(greyscale_cache == NULL) {
+	assert(images.find(1) != images.end());
+	greyscale_cache = std::shared_ptr<GreyscaleImageCache<ImageType> >
+	  (new GreyscaleImageCache<ImageType>(images, images[1]->get_directory()));
+      }
+      return greyscale_cache;
     }
 
     /**
@@ -28,6 +28,9 @@
 #include "FileSystem.h"
 #include "Image.h"
 
+#include <memory>
+#include <assert.h>
+
 namespace degate {
 
 
@@ -36,6 +39,53 @@ namespace degate {
    * -------------------------------------------------------------------------- */
 
 
+  /**
+   * A view on a rectangular block of pixels, that are stored in memory
+   * row by row. Pixels within a row are contiguous, rows are \p stride
+   * pixels apart. The view uses absolute image coordinates.
+   *
+   * For tile based images a view covers a whole tile and might exceed
+   * the image's width and height. The pixel memory of a view remains
+   * valid as long as the view exists.
+   */
+  template<typename PixelType>
+  struct TileView {
+
+    /** Keeps the memory behind \p data alive. Might be empty. */
+    std::shared_ptr<void> pin;
+
+    /** Pointer to the pixel at \p min_x, \p min_y. */
+    PixelType * data;
+
+    /** Distance between two rows in pixels. */
+    unsigned int stride;
+
+    unsigned int min_x, min_y, width, height;
+
+    TileView() : data(NULL), stride(0), min_x(0), min_y(0), width(0), height(0) {}
+
+    /**
+     * Get a pointer to the pixel at the absolute position \p x, \p y.
+     * The pixels up to get_max_x() follow contiguously.
+     */
+    inline PixelType * get_ptr(unsigned int x, unsigned int y) const {
+      assert(x >= min_x && x < min_x + width);
+      assert(y >= min_y && y < min_y + height);
+      return data + (y - min_y) * stride + (x - min_x);
+    }
+
+    /**
+     * Get the first column right of the view.
+     */
+    inline unsigned int get_max_x() const { return min_x + width; }
+
+    /**
+     * Get the first row below the view.
+     */
+    inline unsigned int get_max_y() const { return min_y + height; }
+  };
+
+
   /**
    * Base class for the storage policy of an image.
    * This is basically the same as StoragePolicy_GenericBase, but
@@ -66,6 +116,36 @@ namespace degate {
      */
     virtual void set_pixel(unsigned int x, unsigned int y, pixel_type new_val) = 0;
 
+    /**
+     * Get a view on the block of pixel memory, that contains the pixel
+     * \p x, \p y. This allows algorithms to work on whole rows instead
+     * of single pixels.
+     * This method is abstract. If you derive from this class, you should
+     * implement it for a concrete StoragePolicy.
+     */
+    virtual void get_tile_view(unsigned int x, unsigned int y,
+			       TileView<pixel_type> & view) const = 0;
+
+    /**
+     * Get a view on the block of pixel memory, that contains the pixel
+     * \p x, \p y, in order to modify it. Storage policies, that write
+     * modified data back, mark the block as modified. The default
+     * implementation calls get_tile_view().
+     */
+    virtual void get_writable_tile_view(unsigned int x, unsigned int y,
+					TileView<pixel_type> & view) {
+      get_tile_view(x, y, view);
+    }
+
+    /**
+     * Hint, that a region of the image will be read soon. Storage
+     * policies, that load their data lazily, can load it in advance.
+     * The region is given by \p min_x <= x < \p max_x and
+     * \p min_y <= y < \p max_y. The default implementation does nothing.
+     */
+    virtual void prefetch(unsigned int min_x, unsigned int max_x,
+			  unsigned int min_y, unsigned int max_y) const {}
+
   };
 
 
@@ -99,6 +179,19 @@ namespace degate {
       memory_map.set(x, y, new_val);
     }
 
+    /**
+     * Get a view on the pixel memory. The view covers the whole image.
+     */
+    void get_tile_view(unsigned int x, unsigned int y,
+		       TileView<typename PixelPolicy::pixel_type> & view) const {
+      view.pin.reset();
+      view.data = memory_map.get_data_ptr();
+      view.stride = memory_map.get_width();
+      view.min_x = view.min_y = 0;
+      view.width = memory_map.get_width();
+      view.height = memory_map.get_height();
+    }
+
   };
 
 
@@ -136,6 +229,19 @@ namespace degate {
       memory_map.set(x, y, new_val);
     }
 
+    /**
+     * Get a view on the pixel memory. The view covers the whole image.
+     */
+    void get_tile_view(unsigned int x, unsigned int y,
+		       TileView<typename PixelPolicy::pixel_type> & view) const {
+      view.pin.reset();
+      view.data = memory_map.get_data_ptr();
+      view.stride = memory_map.get_width();
+      view.min_x = view.min_y = 0;
+      view.width = memory_map.get_width();
+      view.height = memory_map.get_height();
+    }
+
   };
 
 
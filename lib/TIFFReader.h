@@ -23,18 +23,32 @@
 #define __TIFFREADER_H__
 
 #include <list>
+#include <vector>
 #include <memory>
+#include <atomic>
 #include "tiffio.h"
 
+#include <boost/bind.hpp>
+
 //#include "ImageReaderFactory.h"
 #include "StoragePolicies.h"
 #include "ImageReaderBase.h"
+#include "ImageManipulation.h"
+#include "Configuration.h"
+#include "WorkerThreads.h"
 
 namespace degate {
 
 
   /**
    * The TIFFReader parses tiff images.
+   *
+   * The image data is decoded in blocks, that are strips or tiles of
+   * the tiff file. Blocks are decoded in parallel. Each worker thread
+   * has its own file handle and picks the next block, that is not
+   * processed yet. Decoded blocks are converted and written directly
+   * into the destination image, so that a worker holds no more than a
+   * single block in memory.
    */
 
   template<class ImageType>
@@ -44,6 +58,29 @@ namespace degate {
 
     TIFF* tif;
 
+    /**
+     * Describes how the image is split into blocks and which blocks
+     * are already processed.
+     */
+    struct import_state {
+      bool tiled;
+
+      // the region to copy
+      unsigned int width, height;
+
+      unsigned int block_width, block_height;
+      unsigned int blocks_per_row, num_blocks;
+
+      std::atomic<unsigned int> next_block;
+    };
+
+    /**
+     * Decode blocks until all blocks are processed. This method is
+     * run by each worker thread.
+     * @param handles The tiff handles. The worker uses handles[thread] exclusively.
+     */
+    void read_blocks(std::vector<TIFF*> const& handles, std::shared_ptr<ImageType> img,
+		     import_state & state, unsigned int thread);
 
   public:
 
@@ -86,24 +123,120 @@ namespace degate {
   template<class ImageType>
   bool TIFFReader<ImageType>::get_image(std::shared_ptr<ImageType> img) {
 
-    size_t npixels = get_width() * get_height();
-    uint32 * raster = (uint32*) _TIFFmalloc(npixels * sizeof (uint32));
-    if(raster == NULL) return false;
+    if(img == NULL || tif == NULL) return false;
+
+    char emsg[1024];
+    if(!TIFFRGBAImageOK(tif, emsg)) {
+      debug(TM, "Can't read tiff image %s: %s", get_filename().c_str(), emsg);
+      return false;
+    }
+
+    import_state state;
+
+    // Only the region is copied, which is present in both images.
+    state.width = std::min(get_width(), img->get_width());
+    state.height = std::min(get_height(), img->get_height());
+    state.tiled = TIFFIsTiled(tif);
+
+    if(state.tiled) {
+      uint32 tile_width, tile_height;
+      TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width);
+      TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height);
+      state.block_width = tile_width;
+      state.block_height = tile_height;
+    }
+    else {
+      // Uncompressed images with a single huge strip are split into
+      // smaller strips by libtiff.
+      uint32 rows_per_strip = get_height();
+      TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+      state.block_width = get_width();
+      state.block_height = std::min<unsigned int>(rows_per_strip, get_height());
+    }
+
+    state.blocks_per_row = (state.width + state.block_width - 1) / state.block_width;
+    state.num_blocks = state.blocks_per_row *
+      ((state.height + state.block_height - 1) / state.block_height);
+    state.next_block = 0;
+
+    this->reset_progress();
+    if(state.num_blocks == 0) return true;
+    this->set_progress_step_size(1.0 / state.num_blocks);
+
+    unsigned int num_threads = std::min(Configuration::get_instance().get_max_worker_threads(),
+					state.num_blocks);
 
-    if(TIFFReadRGBAImage(tif, get_width(), get_height(), raster, 0)) {
-      for(unsigned int y = 0; y < get_height(); y++) {
-	for(unsigned int x = 0; x < get_width(); x++) {
+    debug(TM, "Import %s with %d threads from %d %s.", get_filename().c_str(), num_threads,
+	  state.num_blocks, state.tiled ? "tiles" : "strips");
 
-	  uint32 v = raster[y * get_width() + x];
+    // A tiff handle must not be shared between threads.
+    std::vector<TIFF*> handles(1, tif);
+    for(unsigned int i = 1; i < num_threads; i++) {
+      TIFF * handle = TIFFOpen(get_filename().c_str(), "r");
+      if(handle != NULL) handles.push_back(handle);
+    }
+
+    try {
+      run_parallel(handles.size(), boost::bind(&TIFFReader<ImageType>::read_blocks,
+					       this, boost::cref(handles), img,
+					       boost::ref(state), _1));
+    }
+    catch(...) {
+      for(unsigned int i = 1; i < handles.size(); i++) TIFFClose(handles[i]);
+      throw;
+    }
 
-	  img->set_pixel(x, get_height() - y -1, v);
+    for(unsigned int i = 1; i < handles.size(); i++) TIFFClose(handles[i]);
+
+    return !this->is_canceled();
+  }
+
+  template<class ImageType>
+  void TIFFReader<ImageType>::read_blocks(std::vector<TIFF*> const& handles,
+					  std::shared_ptr<ImageType> img,
+					  import_state & state,
+					  unsigned int thread) {
 
+    const unsigned int bw = state.block_width, bh = state.block_height;
+    TIFF * handle = handles[thread];
+
+    std::vector<uint32> raster(bw * bh);
+
+    unsigned int block;
+    while((block = state.next_block++) < state.num_blocks && !this->is_canceled()) {
+
+      unsigned int col = (block % state.blocks_per_row) * bw;
+      unsigned int row = (block / state.blocks_per_row) * bh;
+
+      // Like TIFFReadRGBAImage() with stopOnError = 0, we continue
+      // with the next block, if a block is damaged.
+      if(!(state.tiled ?
+	   TIFFReadRGBATile(handle, col, row, &raster[0]) :
+	   TIFFReadRGBAStrip(handle, row, &raster[0]))) {
+	debug(TM, "Failed to read block at %d,%d from %s", col, row, get_filename().c_str());
+      }
+      else {
+	// The raster is organized bottom-up. A tile raster has its origin
+	// in the lower left corner of the tile, even if the tile is clipped
+	// at the image border. A strip raster holds only the strip's rows.
+	unsigned int raster_rows = state.tiled ? bh : std::min(bh, get_height() - row);
+	unsigned int rows = std::min(bh, state.height - row);
+	unsigned int cols = std::min(bw, state.width - col);
+
+	try {
+	  for(unsigned int i = 0; i < rows; i++)
+	    write_row<rgba_pixel_t>(img, col, row + i, cols,
+				    &raster[(raster_rows - 1 - i) * bw]);
+	}
+	catch(...) {
+	  // Writing into the image failed. The other workers stop, too.
+	  state.next_block = state.num_blocks;
+	  throw;
 	}
       }
 
+      this->progress_step_done();
     }
-    _TIFFfree(raster);
-    return true;
   }
 
 
@@ -27,11 +27,17 @@
 #include <Statistics.h>
 #include <ImageHelper.h>
 #include <MedianFilter.h>
+#include <IntegralImage.h>
 #include <DegateHelper.h>
+#include <Configuration.h>
+#include <WorkerThreads.h>
 
 #include <utility>
+#include <fstream>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 #include <math.h>
+#include <limits.h>
 
 using namespace degate;
 
@@ -47,48 +53,16 @@ TemplateMatching::TemplateMatching() {
   threshold_detection = 0.70;
   max_step_size_search = 3;
   scale_down = 1;
+  use_fft = false;
+  coarse_to_fine = true;
+  early_rejection = true;
+  batched = false;
+  stats.reset();
 }
 
 TemplateMatching::~TemplateMatching() {
 }
 
-void TemplateMatching::precalc_sum_tables(TileImage_GS_BYTE_shptr img,
-					  TileImage_GS_DOUBLE_shptr summation_table_single,
-					  TileImage_GS_DOUBLE_shptr summation_table_squared) {
-
-  unsigned int x, y;
-
-  for(y = 0; y < img->get_height(); y++)
-    for(x = 0; x < img->get_width(); x++) {
-      summation_table_single->set_pixel(x, y, 0);
-      summation_table_squared->set_pixel(x, y, 0);
-    }
-
-  for(y = 0; y < img->get_height(); y++)
-    for(x = 0; x < img->get_width(); x++) {
-
-      double f = img->get_pixel_as<gs_double_pixel_t>(x, y);
-
-      double s_l = x > 0 ? summation_table_single->get_pixel(x - 1, y) : 0;
-      double s_o = y > 0 ? summation_table_single->get_pixel(x, y - 1) : 0;
-      double s_lo = x > 0 && y > 0 ? summation_table_single->get_pixel(x - 1, y - 1) : 0;
-
-
-      double s2_l = x > 0 ? summation_table_squared->get_pixel(x - 1, y) : 0;
-      double s2_o = y > 0 ? summation_table_squared->get_pixel(x, y - 1) : 0;
-      double s2_lo = x > 0 && y > 0 ? summation_table_squared->get_pixel(x - 1, y - 1) : 0;
-
-      double f1 = f + s_l + s_o - s_lo;
-      double f2 = f*f + s2_l + s2_o - s2_lo;
-
-      summation_table_single->set_pixel(x, y, f1);
-      summation_table_squared->set_pixel(x, y, f2);
-    }
-
-}
-
-
-
 void TemplateMatching::init(BoundingBox const& bounding_box, Project_shptr project) {
 
   assert(project != NULL);
@@ -105,10 +79,28 @@ void TemplateMatching::init(BoundingBox const& bounding_box, Project_shptr proje
 
   ScalingManager_shptr sm = layer_matching->get_scaling_manager();
 
-  debug(TM, "Prepare background.");
-  prepare_background_images(sm, bounding_box, get_scaling_factor());
-  debug(TM, "Prepare sum tabes.");
-  prepare_sum_tables(gs_img_normal, gs_img_scaled);
+  debug(TM, "Prepare background and sum tables.");
+  background_level normal = prepare_background_level(sm, this->bounding_box, 1);
+  gs_img_normal = normal.gs_img;
+  sum_table_single_normal = normal.sum_table_single;
+  sum_table_squared_normal = normal.sum_table_squared;
+
+  if(get_scaling_factor() == 1) {
+    gs_img_scaled = gs_img_normal;
+    sum_table_single_scaled = sum_table_single_normal;
+    sum_table_squared_scaled = sum_table_squared_normal;
+  }
+  else {
+    background_level scaled = prepare_background_level(sm, this->bounding_box, get_scaling_factor());
+    gs_img_scaled = scaled.gs_img;
+    sum_table_single_scaled = scaled.sum_table_single;
+    sum_table_squared_scaled = scaled.sum_table_squared;
+  }
+
+  refinement_levels.clear();
+  if(coarse_to_fine)
+    for(unsigned int f = get_scaling_factor() / 2; f > 1; f /= 2)
+      refinement_levels.push_back(prepare_background_level(sm, this->bounding_box, f));
 
   reset_progress();
 }
@@ -122,46 +114,99 @@ BoundingBox TemplateMatching::get_scaled_bounding_box(BoundingBox const& boundin
 		     lrint(bounding_box.get_max_y() / scale_down));
 }
 
-void TemplateMatching::prepare_background_images(ScalingManager_shptr sm,
-						 BoundingBox const& bounding_box,
-						 unsigned int scaling_factor) {
+TemplateMatching::background_level
+TemplateMatching::prepare_background_level(ScalingManager_shptr sm,
+					   BoundingBox const& bounding_box,
+					   unsigned int scaling_factor) const {
+
+  assert(sm->get_image(scaling_factor).first == scaling_factor);
+
+  BoundingBox scaled_bounding_box = get_scaled_bounding_box(bounding_box, scaling_factor);
+
+  std::string dir = sm->get_sum_table_directory(scaling_factor);
+  if(dir.empty())
+    return build_background_level(sm, scaled_bounding_box, scaling_factor, dir);
+
+  boost::format region("%1% %2% %3% %4% %5%");
+  region % scaling_factor
+    % scaled_bounding_box.get_min_x() % scaled_bounding_box.get_max_x()
+    % scaled_bounding_box.get_min_y() % scaled_bounding_box.get_max_y();
+
+  // The region file is written after the images. If it describes
+  // the requested region, the cached images are complete.
+  std::string region_file = join_pathes(dir, "region");
+  std::string cached_region;
+  std::ifstream in(region_file.c_str());
+  if(in.good() && std::getline(in, cached_region) && cached_region == region.str()) {
+
+    debug(TM, "Load greyscale image and sum tables from %s", dir.c_str());
+
+    unsigned int
+      w = scaled_bounding_box.get_width(),
+      h = scaled_bounding_box.get_height();
+
+    background_level l;
+    l.scaling = scaling_factor;
+    l.gs_img = TileImage_GS_BYTE_shptr
+      (new TileImage_GS_BYTE(w, h, join_pathes(dir, "image.dimg")));
+    l.sum_table_single = TileImage_SUM_UINT32_shptr
+      (new TileImage_SUM_UINT32(w, h, join_pathes(dir, "single.dimg")));
+    l.sum_table_squared = TileImage_SUM_INT64_shptr
+      (new TileImage_SUM_INT64(w, h, join_pathes(dir, "squared.dimg")));
+    return l;
+  }
+  in.close();
 
-  // Get the normal background image and the scaled background image
-  // These images are in RGBA format.
-  const ScalingManager<BackgroundImage>::image_map_element i1 =
-    sm->get_image(1);
-  const ScalingManager<BackgroundImage>::image_map_element i2 =
-    sm->get_image(scaling_factor);
+  if(file_exists(dir)) remove_directory(dir);
+  create_directory(dir);
 
-  assert(i1.second != NULL);
-  assert(i2.second != NULL);
-  assert(i2.first  == get_scaling_factor());
+  background_level l = build_background_level(sm, scaled_bounding_box, scaling_factor, dir);
 
-  BackgroundImage_shptr img_normal = i1.second;
-  BackgroundImage_shptr img_scaled = i2.second;
+  std::ofstream out(region_file.c_str());
+  out << region.str() << std::endl;
+  return l;
+}
 
-  // Create a greyscaled image for the normal
-  // unscaled background image and the scaled version.
-  BoundingBox scaled_bounding_box =
-    get_scaled_bounding_box(bounding_box, scaling_factor);
+TemplateMatching::background_level
+TemplateMatching::build_background_level(ScalingManager_shptr sm,
+					 BoundingBox const& scaled_bounding_box,
+					 unsigned int scaling_factor,
+					 std::string const& directory) const {
 
+  unsigned int
+    w = scaled_bounding_box.get_width(),
+    h = scaled_bounding_box.get_height();
 
-  gs_img_normal = TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(bounding_box.get_width(),
-								bounding_box.get_height()));
+  background_level l;
+  l.scaling = scaling_factor;
 
-#ifdef USE_FILTER
+  if(directory.empty()) {
+    l.gs_img = TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(w, h));
+    l.sum_table_single = TileImage_SUM_UINT32_shptr(new TileImage_SUM_UINT32(w, h));
+    l.sum_table_squared = TileImage_SUM_INT64_shptr(new TileImage_SUM_INT64(w, h));
+  }
+  else {
+    l.gs_img = TileImage_GS_BYTE_shptr
+      (new TileImage_GS_BYTE(w, h, join_pathes(directory, "image.dimg")));
+    l.sum_table_single = TileImage_SUM_UINT32_shptr
+      (new TileImage_SUM_UINT32(w, h, join_pathes(directory, "single.dimg")));
+    l.sum_table_squared = TileImage_SUM_INT64_shptr
+      (new TileImage_SUM_INT64(w, h, join_pathes(directory, "squared.dimg")));
+  }
 
-  TileImage_GS_BYTE_shptr tmp;
+  // Create a greyscaled image for the region.
+  TileImage_GS_BYTE_shptr img =
+    sm->get_greyscale_cache()->get_gs_byte_image(scaling_factor, scaled_bounding_box);
 
-  tmp =  TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(bounding_box.get_width(),
-						       bounding_box.get_height()));;
+#ifdef USE_FILTER
 
-  extract_partial_image(tmp, img_normal, bounding_box);
+  TileImage_GS_BYTE_shptr tmp(new TileImage_GS_BYTE(w, h));
 
-  #ifdef USE_MEDIAN_FILTER
+  extract_partial_image(tmp, img, scaled_bounding_box);
 
-  median_filter(gs_img_normal, tmp, USE_MEDIAN_FILTER);
+  #ifdef USE_MEDIAN_FILTER
 
+  median_filter(l.gs_img, tmp, USE_MEDIAN_FILTER);
 
   #elif defined(USE_GAUSS_FILTER)
 
@@ -172,57 +217,25 @@ void TemplateMatching::prepare_background_images(ScalingManager_shptr sm,
 
   gaussian_blur_kernel->print();
 
-  convolve(gs_img_normal, tmp, gaussian_blur_kernel);
+  convolve(l.gs_img, tmp, gaussian_blur_kernel);
 
   #endif
 
 #else
-  extract_partial_image(gs_img_normal, img_normal, bounding_box);
+  extract_partial_image(l.gs_img, img, scaled_bounding_box);
 #endif
 
+  //save_image("/tmp/xxx1.tif", l.gs_img);
 
+  build_integral_images(l.sum_table_single, l.sum_table_squared, l.gs_img);
 
-  if(scaling_factor == 1)
-    gs_img_scaled = gs_img_normal;
-  else {
-
-    gs_img_scaled = TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(scaled_bounding_box.get_width(),
-								  scaled_bounding_box.get_height()));
-
-#ifdef USE_MEDIAN_FILTER
-    tmp =  TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(bounding_box.get_width(),
-							 bounding_box.get_height()));;
-
-    extract_partial_image(tmp, img_scaled, scaled_bounding_box);
-
-    median_filter(gs_img_scaled, tmp, USE_MEDIAN_FILTER);
-#else
-
-    extract_partial_image(gs_img_scaled, img_scaled, scaled_bounding_box);
-#endif
+  if(!directory.empty()) {
+    l.gs_img->sync();
+    l.sum_table_single->sync();
+    l.sum_table_squared->sync();
   }
 
-  //save_image("/tmp/xxx1.tif", gs_img_normal);
-  //save_image("/tmp/xxx2.tif", gs_img_scaled);
-
-}
-
-void TemplateMatching::prepare_sum_tables(TileImage_GS_BYTE_shptr gs_img_normal,
-					  TileImage_GS_BYTE_shptr gs_img_scaled) {
-
-  unsigned int
-    w_n = gs_img_normal->get_width(),
-    h_n = gs_img_normal->get_height(),
-    w_s = gs_img_scaled->get_width(),
-    h_s = gs_img_scaled->get_height();
-
-  sum_table_single_normal = TileImage_GS_DOUBLE_shptr(new TileImage_GS_DOUBLE(w_n, h_n));
-  sum_table_squared_normal = TileImage_GS_DOUBLE_shptr(new TileImage_GS_DOUBLE(w_n, h_n));
-  sum_table_single_scaled = TileImage_GS_DOUBLE_shptr(new TileImage_GS_DOUBLE(w_s, h_s));
-  sum_table_squared_scaled = TileImage_GS_DOUBLE_shptr(new TileImage_GS_DOUBLE(w_s, h_s));
-
-  precalc_sum_tables(gs_img_normal, sum_table_single_normal, sum_table_squared_normal);
-  precalc_sum_tables(gs_img_scaled, sum_table_single_scaled, sum_table_squared_scaled);
+  return l;
 }
 
 
@@ -250,50 +263,89 @@ void TemplateMatching::set_orientations(std::list<Gate::ORIENTATION> tmpl_orient
 
 void TemplateMatching::run() {
 
-
   debug(TM, "run template matching");
-  std::list<match_found> matches;
+  match_regions(std::list<BoundingBox>(1, bounding_box));
+}
 
-  stats.reset();
-  set_progress_step_size(1.0/(tmpl_set.size() * tmpl_orientations.size()));
+void TemplateMatching::run_incremental(std::list<BoundingBox> const& dirty_regions) {
 
-  /*
-  BOOST_FOREACH(GateTemplate_shptr tmpl, tmpl_set) {
-    BOOST_FOREACH(Gate::ORIENTATION orientation, tmpl_orientations) {
-      add_task( run2, parameter)
-    }
-  }
+  debug(TM, "run incremental template matching");
+  std::list<BoundingBox> regions;
+  BOOST_FOREACH(BoundingBox const& r, dirty_regions)
+    if(r.intersects(bounding_box)) regions.push_back(r);
 
-  wait;
-  */
-  BOOST_FOREACH(GateTemplate_shptr tmpl, tmpl_set) {
+  match_regions(regions);
+}
 
-    BOOST_FOREACH(Gate::ORIENTATION orientation, tmpl_orientations) {
+void TemplateMatching::match_regions(std::list<BoundingBox> const& regions) {
 
-      boost::format f("Check cell \"%1%\"");
-      f % tmpl->get_name();
-      set_log_message(f.str());
+  matches.clear();
+  stats.reset();
 
-      prepared_template prep_tmpl_img = prepare_template(tmpl, orientation);
-      //match_single_template(prep_tmpl_img, t_hc, t_det);
+  // Templates are sorted by size, so the most expensive tasks are
+  // taken first and the workers finish at about the same time.
+  std::vector<matching_task> tasks;
+  BOOST_FOREACH(GateTemplate_shptr tmpl, tmpl_set) {
 
+    const int
+      tmpl_w = tmpl->get_width(),
+      tmpl_h = tmpl->get_height();
 
-      std::list<match_found> m = match_single_template(prep_tmpl_img,
-						       threshold_hc,
-						       threshold_detection);
+    BOOST_FOREACH(BoundingBox const& r, regions) {
 
+      // All positions, where the template overlaps the region.
+      BoundingBox search_area(std::max(bounding_box.get_min_x(), r.get_min_x() - tmpl_w),
+			      std::min(bounding_box.get_max_x(), r.get_max_x() + tmpl_w),
+			      std::max(bounding_box.get_min_y(), r.get_min_y() - tmpl_h),
+			      std::min(bounding_box.get_max_y(), r.get_max_y() + tmpl_h));
 
-      matches.insert(matches.end(), m.begin(), m.end());
+      if(search_area.get_width() <= (unsigned int)tmpl_w ||
+	 search_area.get_height() <= (unsigned int)tmpl_h) continue;
 
-      progress_step_done();
-      if(is_canceled()) {
-	reset_progress();
-	return;
+      BOOST_FOREACH(Gate::ORIENTATION orientation, tmpl_orientations) {
+	matching_task t;
+	t.tmpl = tmpl;
+	t.orientation = orientation;
+	t.search_area = search_area;
+	t.max_corr = -1;
+	tasks.push_back(t);
       }
     }
+  }
+
+  if(tasks.empty()) {
+    reset_progress();
+    return;
+  }
+
+  set_progress_step_size(1.0/tasks.size());
+
+  try {
+    if(batched) run_batched(tasks);
+    else if(!use_fft && has_scan_parts()) run_in_parts(tasks);
+    else run_parallel_for(Configuration::get_instance().get_max_worker_threads(), tasks.size(),
+			  boost::bind(&TemplateMatching::match_task, this, boost::ref(tasks), _1));
+  }
+  catch(...) {
+    reset_progress();
+    throw;
+  }
+
+  if(is_canceled()) {
+    reset_progress();
+    return;
+  }
 
+  // Merge in the order of the serial loop, so that the result does not
+  // depend on the number of threads.
+  BOOST_FOREACH(matching_task const& t, tasks) {
+    std::cout << "The maximum correlation value for template " << t.tmpl->get_name()
+	      << " in orientation " << t.orientation << " is " << t.max_corr << std::endl;
+    matches.insert(matches.end(), t.matches.begin(), t.matches.end());
   }
 
+  debug(TM, "Calculated %lu correlation values, %lu of them were rejected early.",
+	(unsigned long)stats.xcorr_calculations, (unsigned long)stats.early_rejections);
 
   matches.sort(compare_correlation);
 
@@ -308,8 +360,276 @@ void TemplateMatching::run() {
 }
 
 
-double TemplateMatching::subtract_mean(TempImage_GS_BYTE_shptr img,
-				       TempImage_GS_DOUBLE_shptr zero_mean_img) const {
+void TemplateMatching::match_task(std::vector<matching_task> & tasks, size_t i) {
+
+  if(is_canceled()) return;
+
+  matching_task & t = tasks[i];
+
+  try {
+    boost::format f("Check cell \"%1%\"");
+    f % t.tmpl->get_name();
+    set_log_message(f.str());
+
+    prepared_template prep_tmpl_img = prepare_template(t.tmpl, t.orientation);
+
+    t.matches = match_single_template(prep_tmpl_img,
+				      t.search_area,
+				      threshold_hc,
+				      threshold_detection,
+				      &t.max_corr);
+  }
+  catch(...) {
+    // Stop the scans of the other workers.
+    cancel();
+    throw;
+  }
+
+  progress_step_done();
+}
+
+
+void TemplateMatching::run_in_parts(std::vector<matching_task> & tasks) {
+
+  std::vector<prepared_template> prepared(tasks.size());
+  std::vector<std::vector<scan_part> > parts(tasks.size());
+  std::vector<part_task> part_tasks;
+
+  for(size_t i = 0; i < tasks.size(); i++) {
+    prepared[i] = prepare_template(tasks[i].tmpl, tasks[i].orientation);
+
+    part_task pt;
+    pt.task = i;
+    pt.search_area = tasks[i].search_area;
+    pt.max_corr = -1;
+
+    if(get_scan_parts(prepared[i], tasks[i].search_area, parts[i]))
+      for(pt.part = 0; pt.part < parts[i].size(); pt.part++) part_tasks.push_back(pt);
+    else {
+      pt.part = std::string::npos;
+      part_tasks.push_back(pt);
+    }
+  }
+
+  set_progress_step_size(1.0 / std::max<size_t>(1, part_tasks.size()));
+
+  run_parallel_for(Configuration::get_instance().get_max_worker_threads(), part_tasks.size(),
+		   boost::bind(&TemplateMatching::match_part, this,
+			       boost::ref(part_tasks), boost::ref(prepared),
+			       boost::cref(parts), _1));
+
+  // Parts are in scan order.
+  BOOST_FOREACH(part_task & pt, part_tasks) {
+    matching_task & t = tasks[pt.task];
+    t.matches.splice(t.matches.end(), pt.matches);
+    t.max_corr = std::max(t.max_corr, pt.max_corr);
+  }
+}
+
+
+void TemplateMatching::match_part(std::vector<part_task> & part_tasks,
+				  std::vector<prepared_template> & prepared,
+				  std::vector<std::vector<scan_part> > const& parts,
+				  size_t i) {
+
+  if(is_canceled()) return;
+
+  part_task & pt = part_tasks[i];
+  prepared_template & tmpl = prepared[pt.task];
+
+  try {
+    if(pt.part == std::string::npos)
+      pt.matches = match_single_template(tmpl, pt.search_area,
+					 threshold_hc, threshold_detection, &pt.max_corr);
+    else {
+      scan_part const& part = parts[pt.task][pt.part];
+      search_state state = part.start;
+
+      bool running = !part.advance_first || get_next_pos(&state, tmpl);
+      while(running && is_in_scan_part(part, state) && !is_canceled()) {
+	match_position(tmpl, state, threshold_hc, threshold_detection,
+		       pt.matches, pt.max_corr);
+	running = get_next_pos(&state, tmpl);
+      }
+    }
+  }
+  catch(...) {
+    // Stop the scans of the other workers.
+    cancel();
+    throw;
+  }
+
+  progress_step_done();
+}
+
+
+void TemplateMatching::run_batched(std::vector<matching_task> & tasks) {
+
+  // Height of a band in scan lines of the scaled image.
+  const unsigned int band_lines = 16;
+
+  const unsigned int num_lines = scans_in_columns() ?
+    gs_img_scaled->get_width() : gs_img_scaled->get_height();
+  const unsigned int num_bands = (num_lines + band_lines - 1) / band_lines;
+
+  std::vector<batch_task> btasks(tasks.size());
+
+  for(unsigned int i = 0; i < tasks.size(); i++) {
+    batch_task & bt = btasks[i];
+    bt.task = &tasks[i];
+    bt.tmpl = prepare_template(tasks[i].tmpl, tasks[i].orientation);
+    init_search_state(bt.state, tasks[i].search_area);
+    bt.done = false;
+  }
+
+  set_progress_step_size(1.0 / std::max(1U, num_bands));
+
+  const unsigned int num_threads = Configuration::get_instance().get_max_worker_threads();
+
+  for(unsigned int band = 0; band < num_bands && !is_canceled(); band++) {
+
+    const unsigned int
+      band_begin = band * band_lines,
+      band_end = std::min(num_lines, band_begin + band_lines);
+
+    // Positions are rounded to the scaled image. The last band takes
+    // the positions, that are rounded beyond it.
+    const unsigned int scan_end = band + 1 < num_bands ? band_end : UINT_MAX;
+
+    // Templates of the same size share the region statistics.
+    typedef std::pair<unsigned int, unsigned int> size_key;
+    std::map<size_key, std::shared_ptr<region_statistics> > stats_by_size;
+    std::vector<std::shared_ptr<region_statistics> > band_stats;
+
+    BOOST_FOREACH(batch_task & bt, btasks) {
+      if(bt.done) continue;
+
+      size_key key(bt.tmpl.zero_mean_template_scaled->get_width(),
+		   bt.tmpl.zero_mean_template_scaled->get_height());
+
+      std::shared_ptr<region_statistics> & r = stats_by_size[key];
+      if(r == NULL) {
+	r = std::shared_ptr<region_statistics>(new region_statistics());
+	r->tmpl_w = key.first;
+	r->tmpl_h = key.second;
+	if(scans_in_columns()) {
+	  r->min_x = band_begin;
+	  r->width = band_end - band_begin;
+	  r->min_y = 0;
+	  r->height = gs_img_scaled->get_height();
+	}
+	else {
+	  r->min_x = 0;
+	  r->width = gs_img_scaled->get_width();
+	  r->min_y = band_begin;
+	  r->height = band_end - band_begin;
+	}
+	band_stats.push_back(r);
+      }
+      bt.tmpl.region_stats = r;
+    }
+
+    run_parallel_for(num_threads, band_stats.size(),
+		     boost::bind(&TemplateMatching::calc_band_statistics, this,
+				 boost::ref(band_stats), _1));
+
+    run_parallel_for(num_threads, btasks.size(),
+		     boost::bind(&TemplateMatching::match_batch_task, this,
+				 boost::ref(btasks), scan_end, _1));
+
+    progress_step_done();
+  }
+}
+
+
+void TemplateMatching::calc_band_statistics(std::vector<std::shared_ptr<region_statistics> > & stats,
+					    size_t i) const {
+  calc_region_statistics(*stats[i]);
+}
+
+
+void TemplateMatching::match_batch_task(std::vector<batch_task> & tasks,
+					unsigned int band_end,
+					size_t i) {
+
+  batch_task & bt = tasks[i];
+  matching_task & t = *bt.task;
+
+  while(!bt.done && get_scaled_scan_line(bt.state) < band_end && !is_canceled()) {
+    match_position(bt.tmpl, bt.state, threshold_hc, threshold_detection,
+		   t.matches, t.max_corr);
+    if(!get_next_pos(&bt.state, bt.tmpl)) bt.done = true;
+  }
+}
+
+
+void TemplateMatching::calc_region_statistics(region_statistics & r) const {
+
+  const unsigned int
+    img_w = gs_img_scaled->get_width(),
+    img_h = gs_img_scaled->get_height(),
+    tmpl_w = r.tmpl_w,
+    tmpl_h = r.tmpl_h;
+
+  const double template_size = tmpl_w * tmpl_h;
+
+  r.variance.assign(r.width * r.height, NAN);
+  if(tmpl_w == 0 || tmpl_h == 0 || tmpl_w > img_w || tmpl_h > img_h) return;
+
+  // The columns of the summation tables, that are needed for the region.
+  const unsigned int
+    from_x = r.min_x > 0 ? r.min_x - 1 : 0,
+    to_x = std::min(img_w, r.min_x + r.width + tmpl_w - 1);
+
+  if(from_x >= to_x) return;
+
+  std::vector<sum_uint32_pixel_t> single_top(to_x - from_x), single_bottom(to_x - from_x);
+  std::vector<sum_int64_pixel_t> squared_top(to_x - from_x), squared_bottom(to_x - from_x);
+
+  for(unsigned int v = 0; v < r.height && r.min_y + v + tmpl_h <= img_h; v++) {
+
+    const unsigned int y = r.min_y + v;
+
+    read_row(sum_table_single_scaled, from_x, y + tmpl_h - 1, to_x - from_x, &single_bottom[0]);
+    read_row(sum_table_squared_scaled, from_x, y + tmpl_h - 1, to_x - from_x, &squared_bottom[0]);
+    if(y > 0) {
+      read_row(sum_table_single_scaled, from_x, y - 1, to_x - from_x, &single_top[0]);
+      read_row(sum_table_squared_scaled, from_x, y - 1, to_x - from_x, &squared_top[0]);
+    }
+
+    for(unsigned int u = 0; u < r.width && r.min_x + u + tmpl_w <= img_w; u++) {
+
+      const unsigned int
+	x = r.min_x + u,
+	right = x + tmpl_w - 1 - from_x,
+	left = x - 1 - from_x; // can wrap, it's checked later
+
+      // The single sums wrap around, but the difference is exact.
+      sum_uint32_pixel_t f1 = single_bottom[right];
+      sum_int64_pixel_t f2 = squared_bottom[right];
+
+      if(x > 0) {
+	f1 -= single_bottom[left];
+	f2 -= squared_bottom[left];
+      }
+      if(y > 0) {
+	f1 -= single_top[right];
+	f2 -= squared_top[right];
+      }
+      if(x > 0 && y > 0) {
+	f1 += single_top[left];
+	f2 += squared_top[left];
+      }
+
+      double s1 = f1, s2 = f2;
+      r.variance[v * r.width + u] = s2 - s1*s1/template_size;
+    }
+  }
+}
+
+
+double TemplateMatching::subtract_mean(MemoryImage_GS_BYTE_shptr img,
+				       MemoryImage_GS_DOUBLE_shptr zero_mean_img) const {
 
   double mean = average(img);
 
@@ -327,6 +647,28 @@ double TemplateMatching::subtract_mean(TempImage_GS_BYTE_shptr img,
   return sum_over_zero_mean_img;
 }
 
+RemainingRowSums TemplateMatching::calc_remaining_row_sums(MemoryImage_GS_DOUBLE_shptr zero_mean_img) const {
+
+  const unsigned int h = zero_mean_img->get_height();
+
+  RemainingRowSums r;
+  r.single.resize(h + 1, 0);
+  r.squared.resize(h + 1, 0);
+
+  for(unsigned int y = h; y > 0; y--) {
+    double s1 = 0, s2 = 0;
+    for(unsigned int x = 0; x < zero_mean_img->get_width(); x++) {
+      double t = zero_mean_img->get_pixel(x, y - 1);
+      s1 += t;
+      s2 += t * t;
+    }
+    r.single[y - 1] = r.single[y] + s1;
+    r.squared[y - 1] = r.squared[y] + s2;
+  }
+
+  return r;
+}
+
 TemplateMatching::prepared_template TemplateMatching::prepare_template(GateTemplate_shptr tmpl,
 								       Gate::ORIENTATION orientation) {
 
@@ -338,6 +680,32 @@ TemplateMatching::prepared_template TemplateMatching::prepare_template(GateTempl
   prep.gate_template = tmpl;
   prep.orientation = orientation;
 
+  PreparedTemplateCache_shptr cache;
+  GateLibrary_shptr glib = project->get_logic_model()->get_gate_library();
+  if(glib != NULL) cache = glib->get_prepared_template_cache();
+
+  PreparedTemplateImages_shptr images;
+  if(cache != NULL)
+    images = cache->get(tmpl, orientation, layer_matching->get_layer_type(), get_scaling_factor());
+
+  if(images == NULL) {
+    images = prepare_template_images(tmpl, orientation);
+    if(cache != NULL)
+      cache->put(tmpl, orientation, layer_matching->get_layer_type(), get_scaling_factor(), images);
+  }
+
+  static_cast<PreparedTemplateImages &>(prep) = *images;
+
+  if(use_fft) prepare_xcorr_surface(prep);
+
+  return prep;
+}
+
+PreparedTemplateImages_shptr TemplateMatching::prepare_template_images(GateTemplate_shptr tmpl,
+									Gate::ORIENTATION orientation) const {
+
+  std::shared_ptr<PreparedTemplateImages> prep(new PreparedTemplateImages());
+
   // get image from template
   GateTemplateImage_shptr tmpl_img_orig = tmpl->get_image(layer_matching->get_layer_type());
 
@@ -378,31 +746,67 @@ TemplateMatching::prepared_template TemplateMatching::prepare_template(GateTempl
     scaled_tmpl_width = (double)w / get_scaling_factor(),
     scaled_tmpl_height = (double)h / get_scaling_factor();
 
-  prep.tmpl_img_normal = TempImage_GS_BYTE_shptr(new TempImage_GS_BYTE(w, h));
-  copy_image(prep.tmpl_img_normal, tmpl_img);
+  prep->tmpl_img_normal = MemoryImage_GS_BYTE_shptr(new MemoryImage_GS_BYTE(w, h));
+  copy_image(prep->tmpl_img_normal, tmpl_img);
 
-  prep.tmpl_img_scaled = TempImage_GS_BYTE_shptr(new TempImage_GS_BYTE(scaled_tmpl_width,
-								       scaled_tmpl_height));
+  prep->tmpl_img_scaled = MemoryImage_GS_BYTE_shptr(new MemoryImage_GS_BYTE(scaled_tmpl_width,
+									    scaled_tmpl_height));
 
-  scale_down_by_power_of_2(prep.tmpl_img_scaled, tmpl_img);
+  scale_down_by_power_of_2(prep->tmpl_img_scaled, tmpl_img);
 
 
   // create zero-mean templates
-  prep.zero_mean_template_normal = TempImage_GS_DOUBLE_shptr(new TempImage_GS_DOUBLE(w, h));
-  prep.zero_mean_template_scaled = TempImage_GS_DOUBLE_shptr(new TempImage_GS_DOUBLE(scaled_tmpl_width,
-										     scaled_tmpl_height));
+  MemoryImage_GS_DOUBLE_shptr zero_mean_template_normal(new MemoryImage_GS_DOUBLE(w, h));
+  prep->zero_mean_template_scaled = MemoryImage_GS_DOUBLE_shptr(new MemoryImage_GS_DOUBLE(scaled_tmpl_width,
+											  scaled_tmpl_height));
 
 
   // subtract mean
 
-  prep.sum_over_zero_mean_template_normal = subtract_mean(prep.tmpl_img_normal,
-							  prep.zero_mean_template_normal);
-  prep.sum_over_zero_mean_template_scaled = subtract_mean(prep.tmpl_img_scaled,
-							  prep.zero_mean_template_scaled);
+  prep->mean_normal = average(prep->tmpl_img_normal);
+  prep->mean_scaled = average(prep->tmpl_img_scaled);
+
+  prep->sum_over_zero_mean_template_normal = subtract_mean(prep->tmpl_img_normal,
+							   zero_mean_template_normal);
+  prep->sum_over_zero_mean_template_scaled = subtract_mean(prep->tmpl_img_scaled,
+							   prep->zero_mean_template_scaled);
+
+
+  assert(prep->sum_over_zero_mean_template_normal > 0);
+  assert(prep->sum_over_zero_mean_template_scaled > 0);
+
+  prep->remaining_rows_normal = calc_remaining_row_sums(zero_mean_template_normal);
+  prep->remaining_rows_scaled = calc_remaining_row_sums(prep->zero_mean_template_scaled);
 
+  // Create templates for the refinement levels. They are created in
+  // the same order as the refinement levels in init().
+  for(unsigned int f = get_scaling_factor() / 2; f > 1; f /= 2) {
+    unsigned int
+      level_tmpl_width = w / f,
+      level_tmpl_height = h / f;
 
-  assert(prep.sum_over_zero_mean_template_normal > 0);
-  assert(prep.sum_over_zero_mean_template_scaled > 0);
+    MemoryImage_GS_BYTE_shptr level_tmpl;
+    double mean = 0;
+    double sum_over_zero_mean_template = 0;
+    RemainingRowSums remaining_rows;
+
+    if(level_tmpl_width > 0 && level_tmpl_height > 0) {
+      level_tmpl = MemoryImage_GS_BYTE_shptr(new MemoryImage_GS_BYTE(level_tmpl_width,
+								     level_tmpl_height));
+      scale_down_by_power_of_2(level_tmpl, tmpl_img);
+
+      MemoryImage_GS_DOUBLE_shptr zero_mean_template(new MemoryImage_GS_DOUBLE(level_tmpl_width,
+										level_tmpl_height));
+      mean = average(level_tmpl);
+      sum_over_zero_mean_template = subtract_mean(level_tmpl, zero_mean_template);
+      remaining_rows = calc_remaining_row_sums(zero_mean_template);
+    }
+
+    prep->tmpl_img_refine.push_back(level_tmpl);
+    prep->mean_refine.push_back(mean);
+    prep->sum_over_zero_mean_template_refine.push_back(sum_over_zero_mean_template);
+    prep->remaining_rows_refine.push_back(remaining_rows);
+  }
 
   return prep;
 }
@@ -418,6 +822,12 @@ void TemplateMatching::adjust_step_size(struct search_state & state, double corr
   else state.step_size_search = get_max_step_size();
 }
 
+double TemplateMatching::get_scan_rejection_limit() const {
+  // rint((1 - max) * corr_val + max) is max for corr_val < 0.5 / (max - 1).
+  if(use_fft || get_max_step_size() <= 1) return get_threshold_hc();
+  return std::min(get_threshold_hc(), 0.5 / (get_max_step_size() - 1));
+}
+
 TemplateMatching::match_found
 TemplateMatching::keep_gate_match(unsigned int x, unsigned int y,
 				  struct prepared_template & tmpl,
@@ -460,50 +870,105 @@ bool TemplateMatching::add_gate(unsigned int x, unsigned int y,
   return false;
 }
 
+void TemplateMatching::init_search_state(struct search_state & state,
+					 BoundingBox const& search_area) const {
+  memset(&state, 0, sizeof(search_state));
+  state.x = 1;
+  state.y = 1;
+  state.step_size_search = get_max_step_size();
+  state.search_area = search_area;
+
+  // With FFT based correlation all positions of the scaled image are visited.
+  if(use_fft) state.step_size_search = get_scaling_factor();
+}
+
+unsigned int TemplateMatching::get_scaled_scan_line(struct search_state const& state) const {
+  unsigned int x, y;
+  get_local_position(state, x, y);
+  return lrint((double)(scans_in_columns() ? x : y) / get_scaling_factor());
+}
+
+void TemplateMatching::get_local_position(struct search_state const& state,
+					  unsigned int & x, unsigned int & y) const {
+  x = state.x + state.search_area.get_min_x() - bounding_box.get_min_x();
+  y = state.y + state.search_area.get_min_y() - bounding_box.get_min_y();
+}
+
 std::list<TemplateMatching::match_found>
 TemplateMatching::match_single_template(struct prepared_template & tmpl,
-					double threshold_hc, double threshold_detection) {
+					BoundingBox const& search_area,
+					double threshold_hc, double threshold_detection,
+					double * max_corr_out) {
 
   debug(TM, "match_single_template(): start iterating over background image");
   search_state state;
-  memset(&state, 0, sizeof(search_state));
-  state.x = 1;
-  state.y = 1;
-  state.step_size_search = get_max_step_size();
-  state.search_area = bounding_box;
+  init_search_state(state, search_area);
   std::list<match_found> matches;
 
   double max_corr_for_search = -1;
 
   do { // works on unscaled, but cropped image
 
-    double corr_val = calc_single_xcorr(gs_img_scaled,
-					sum_table_single_scaled,
-					sum_table_squared_scaled,
-					tmpl.zero_mean_template_scaled,
-					tmpl.sum_over_zero_mean_template_scaled,
-					lrint((double)state.x / get_scaling_factor()),
-					lrint((double)state.y / get_scaling_factor()));
+    match_position(tmpl, state, threshold_hc, threshold_detection,
+		   matches, max_corr_for_search);
+
+  } while(get_next_pos(&state, tmpl) && !is_canceled());
+
+  *max_corr_out = max_corr_for_search;
+  return matches;
+}
+
+void TemplateMatching::match_position(struct prepared_template & tmpl,
+				      struct search_state & state,
+				      double threshold_hc,
+				      double threshold_detection,
+				      std::list<match_found> & matches,
+				      double & max_corr) const {
+
+  unsigned int local_x, local_y;
+  get_local_position(state, local_x, local_y);
+
+  unsigned int
+    scaled_x = lrint((double)local_x / get_scaling_factor()),
+    scaled_y = lrint((double)local_y / get_scaling_factor());
+
+  bool rejected = false;
+  double corr_val = get_scaled_xcorr(tmpl, scaled_x, scaled_y, &rejected);
+
+  /*
+  debug(TM, "%d,%d  == %d,%d  -> %f", state.x, state.y,
+	lrint((double)state.x / get_scaling_factor()),
+	lrint((double)state.y / get_scaling_factor()),
+	corr_val);
+  */
+
+  // The value of a rejected position is only an upper bound. The real
+  // value is below the scan rejection limit and results in the maximum
+  // step size.
+  if(rejected) {
+    if(!use_fft) adjust_step_size(state, 0);
+    return;
+  }
 
-    /*
-    debug(TM, "%d,%d  == %d,%d  -> %f", state.x, state.y,
-	  lrint((double)state.x / get_scaling_factor()),
-	  lrint((double)state.y / get_scaling_factor()),
-	  corr_val);
-    */
-    if(corr_val > max_corr_for_search) max_corr_for_search = corr_val;
+  if(corr_val > max_corr) max_corr = corr_val;
 
 
-    adjust_step_size(state, corr_val);
+  if(!use_fft) adjust_step_size(state, corr_val);
 
-    if(corr_val >= threshold_hc) {
-      //debug(TM, "start hill climbing at(%d,%d), corr=%f", state.x, state.y, corr_val);
+  if(corr_val >= threshold_hc &&
+     (!use_fft || is_local_maximum(tmpl, scaled_x, scaled_y, corr_val))) {
+    unsigned int start_x = local_x, start_y = local_y;
+    double start_val = corr_val;
+
+    if(refine_candidate(tmpl, start_x, start_y, start_val)) {
+      //debug(TM, "start hill climbing at(%d,%d), corr=%f", start_x, start_y, start_val);
       unsigned int max_corr_x, max_corr_y;
       double curr_max_val;
-      hill_climbing(state.x, state.y, corr_val,
+      hill_climbing(start_x, start_y, start_val,
 		    &max_corr_x, &max_corr_y, &curr_max_val,
-		    gs_img_normal, tmpl.zero_mean_template_normal,
-		    tmpl.sum_over_zero_mean_template_normal);
+		    gs_img_normal, tmpl.tmpl_img_normal, tmpl.mean_normal,
+		    tmpl.sum_over_zero_mean_template_normal,
+		    tmpl.remaining_rows_normal);
 
       //debug(TM, "hill climbing returned for (%d,%d) corr=%f", max_corr_x, max_corr_y, curr_max_val);
       if(curr_max_val >= threshold_detection) {
@@ -511,14 +976,69 @@ TemplateMatching::match_single_template(struct prepared_template & tmpl,
 					  max_corr_y + bounding_box.get_min_y(),
 					  tmpl, curr_max_val, threshold_hc));
       }
-
     }
+  }
+}
 
-  } while(get_next_pos(&state, tmpl) && !is_canceled());
 
-  std::cout << "The maximum correlation value for the current template and orientation is " << max_corr_for_search << std::endl;
+bool TemplateMatching::refine_candidate(struct prepared_template const& tmpl,
+					unsigned int & x, unsigned int & y,
+					double & corr_val) const {
+
+  // A pixel on a level covers two pixels on the next finer level. The
+  // position from the previous level might be off by one pixel.
+  const int radius = 2;
+
+  for(unsigned int i = 0; i < refinement_levels.size(); i++) {
+
+    background_level const& l = refinement_levels[i];
+    const MemoryImage_GS_BYTE_shptr tmpl_img = tmpl.tmpl_img_refine[i];
+    const double sum_over_zero_mean_template = tmpl.sum_over_zero_mean_template_refine[i];
+
+    if(tmpl_img == NULL || sum_over_zero_mean_template == 0 ||
+       tmpl_img->get_width() > l.gs_img->get_width() ||
+       tmpl_img->get_height() > l.gs_img->get_height()) continue;
+
+    const int
+      max_x = l.gs_img->get_width() - tmpl_img->get_width(),
+      max_y = l.gs_img->get_height() - tmpl_img->get_height(),
+      center_x = lrint((double)x / l.scaling),
+      center_y = lrint((double)y / l.scaling);
+
+    double max_corr = -1;
+    int max_corr_x = center_x, max_corr_y = center_y;
+
+    for(int _y = std::max(0, center_y - radius); _y <= std::min(max_y, center_y + radius); _y++)
+      for(int _x = std::max(0, center_x - radius); _x <= std::min(max_x, center_x + radius); _x++) {
+
+	double curr_corr_val = calc_single_xcorr(l.gs_img,
+						 l.sum_table_single,
+						 l.sum_table_squared,
+						 tmpl_img,
+						 tmpl.mean_refine[i],
+						 sum_over_zero_mean_template,
+						 _x, _y,
+						 &tmpl.remaining_rows_refine[i],
+						 std::max(max_corr, get_threshold_hc()));
+	if(curr_corr_val > max_corr) {
+	  max_corr = curr_corr_val;
+	  max_corr_x = _x;
+	  max_corr_y = _y;
+	}
+      }
 
-  return matches;
+    if(max_corr < get_threshold_hc()) return false;
+
+    x = max_corr_x * l.scaling;
+    y = max_corr_y * l.scaling;
+    corr_val = max_corr;
+  }
+
+  // The template must fit into the normal image.
+  x = std::min(x, gs_img_normal->get_width() - tmpl.tmpl_img_normal->get_width());
+  y = std::min(y, gs_img_normal->get_height() - tmpl.tmpl_img_normal->get_height());
+
+  return true;
 }
 
 
@@ -527,8 +1047,10 @@ void TemplateMatching::hill_climbing(unsigned int start_x, unsigned int start_y,
 				     unsigned int * max_corr_y_out,
 				     double * max_xcorr_out,
 				     const TileImage_GS_BYTE_shptr master,
-				     const TempImage_GS_DOUBLE_shptr zero_mean_template,
-				     double sum_over_zero_mean_template) const {
+				     const MemoryImage_GS_BYTE_shptr tmpl_img,
+				     double tmpl_mean,
+				     double sum_over_zero_mean_template,
+				     RemainingRowSums const& remaining_rows) const {
 
   unsigned int max_corr_x = start_x;
   unsigned int max_corr_y = start_y;
@@ -576,9 +1098,11 @@ void TemplateMatching::hill_climbing(unsigned int start_x, unsigned int start_y,
       double curr_corr_val = calc_single_xcorr(master,
 					       sum_table_single_normal,
 					       sum_table_squared_normal,
-					       zero_mean_template,
+					       tmpl_img,
+					       tmpl_mean,
 					       sum_over_zero_mean_template,
-					       x, y);
+					       x, y,
+					       &remaining_rows, max_corr);
 
       if(curr_corr_val > max_corr) {
 	max_corr_x = x;
@@ -597,61 +1121,139 @@ void TemplateMatching::hill_climbing(unsigned int start_x, unsigned int start_y,
 }
 
 
+void TemplateMatching::get_region_sums(const TileImage_SUM_UINT32_shptr summation_table_single,
+				       const TileImage_SUM_INT64_shptr summation_table_squared,
+				       unsigned int min_x, unsigned int min_y,
+				       unsigned int width, unsigned int height,
+				       double & sum_single, double & sum_squared) const {
+
+  degate::get_region_sums(summation_table_single, summation_table_squared,
+			  min_x, min_y, width, height, sum_single, sum_squared);
+}
+
+
+double TemplateMatching::calc_xcorr_denominator(const TileImage_SUM_UINT32_shptr summation_table_single,
+						const TileImage_SUM_INT64_shptr summation_table_squared,
+						unsigned int tmpl_width, unsigned int tmpl_height,
+						double sum_over_zero_mean_template,
+						unsigned int local_x,
+						unsigned int local_y) const {
+
+  double template_size = tmpl_width * tmpl_height;
+  double s1, s2;
+
+  get_region_sums(summation_table_single, summation_table_squared,
+		  local_x, local_y, tmpl_width, tmpl_height, s1, s2);
+
+  return sqrt((s2 - s1*s1/template_size) * sum_over_zero_mean_template);
+}
+
+
 double TemplateMatching::calc_single_xcorr(const TileImage_GS_BYTE_shptr master,
-					   const TileImage_GS_DOUBLE_shptr summation_table_single,
-					   const TileImage_GS_DOUBLE_shptr summation_table_squared,
-					   const TempImage_GS_DOUBLE_shptr zero_mean_template,
+					   const TileImage_SUM_UINT32_shptr summation_table_single,
+					   const TileImage_SUM_INT64_shptr summation_table_squared,
+					   const MemoryImage_GS_BYTE_shptr tmpl_img,
+					   double tmpl_mean,
 					   double sum_over_zero_mean_template,
 					   unsigned int local_x,
-					   unsigned int local_y) const {
+					   unsigned int local_y,
+					   RemainingRowSums const* remaining_rows,
+					   double min_corr,
+					   bool * rejected) const {
+
+  assert(tmpl_img->get_width() > 0 && tmpl_img->get_height() > 0);
+
+  double denominator = calc_xcorr_denominator(summation_table_single,
+					      summation_table_squared,
+					      tmpl_img->get_width(),
+					      tmpl_img->get_height(),
+					      sum_over_zero_mean_template,
+					      local_x, local_y);
+
+  return calc_xcorr(master, summation_table_single, summation_table_squared,
+		    tmpl_img, tmpl_mean, denominator, local_x, local_y,
+		    remaining_rows, min_corr, rejected);
+}
 
-  double template_size = zero_mean_template->get_width() * zero_mean_template->get_height();
-  assert(zero_mean_template->get_width() > 0 && zero_mean_template->get_height() > 0);
 
-  unsigned int
-    x_plus_w = local_x + zero_mean_template->get_width() -1,
-    y_plus_h = local_y + zero_mean_template->get_height() -1,
-    lxm1 = local_x - 1, // can wrap, it's checked later
-    lym1 = local_y - 1;
+double TemplateMatching::calc_xcorr(const TileImage_GS_BYTE_shptr master,
+				    const TileImage_SUM_UINT32_shptr summation_table_single,
+				    const TileImage_SUM_INT64_shptr summation_table_squared,
+				    const MemoryImage_GS_BYTE_shptr tmpl_img,
+				    double tmpl_mean,
+				    double denominator,
+				    unsigned int local_x,
+				    unsigned int local_y,
+				    RemainingRowSums const* remaining_rows,
+				    double min_corr,
+				    bool * rejected) const {
 
-  // calculate denominator
-  double
-    f1 = summation_table_single->get_pixel(x_plus_w, y_plus_h),
-    f2 = summation_table_squared->get_pixel(x_plus_w, y_plus_h);
+  stats.xcorr_calculations++;
+  if(rejected != NULL) *rejected = false;
 
-  if(local_x > 0) {
-    f1 -= summation_table_single->get_pixel(lxm1, y_plus_h);
-    f2 -= summation_table_squared->get_pixel(lxm1, y_plus_h);
-  }
-  if(local_y > 0) {
-    f1 -= summation_table_single->get_pixel(x_plus_w, lym1);
-    f2 -= summation_table_squared->get_pixel(x_plus_w, lym1);
-  }
-  if(local_x > 0 && local_y > 0) {
-    f1 += summation_table_single->get_pixel(lxm1, lym1);
-    f2 += summation_table_squared->get_pixel(lxm1, lym1);
-  }
-
-  double denominator = sqrt((f2 - f1*f1/template_size) * sum_over_zero_mean_template);
+  const unsigned int
+    tmpl_w = tmpl_img->get_width(),
+    tmpl_h = tmpl_img->get_height();
 
   // calculate nummerator
   if(std::isinf(denominator) || std::isnan(denominator) || denominator == 0) {
     debug(TM,
-	  "ERROR: The denominator is not a valid number: f1=%f f2=%f template_size=%f sum=%f "
-	  "local_x=%d local_y=%d x_plus_w=%d y_plus_h=%d lxm1=%d lym1=%d",
-	  f1, f2, template_size, sum_over_zero_mean_template,
-	  local_x, local_y, x_plus_w, y_plus_h, lxm1, lym1);
+	  "ERROR: The denominator is not a valid number: denominator=%f "
+	  "local_x=%d local_y=%d template_width=%d template_height=%d",
+	  denominator, local_x, local_y, tmpl_w, tmpl_h);
     return -1.0;
   }
 
-  unsigned int _x, _y;
+  // Rows per block between two checks for early rejection. A check
+  // costs eight lookups in the summation tables.
+  const unsigned int block_rows = 4;
+  const bool check_bound = early_rejection && remaining_rows != NULL && min_corr > -1;
+
+  // The nummerator is sum(f * (t - mean)) = sum(f * t) - mean * sum(f).
+  // Both sums are exact integers.
+  TileView<gs_byte_pixel_t> tmpl_view, view;
+  tmpl_img->get_tile_view(0, 0, tmpl_view);
+
+  uint64_t sum_ft = 0, sum_f = 0;
+  unsigned int _y;
   double nummerator = 0;
 
-  for(_y = 0; _y < zero_mean_template->get_height(); _y ++) {
-    for(_x = 0; _x < zero_mean_template->get_width(); _x ++) {
-      double f_xy = master->get_pixel(_x + local_x, _y + local_y);
-      double t_xy = zero_mean_template->get_pixel(_x, _y);
-      nummerator += f_xy * t_xy;
+  for(_y = 0; _y < tmpl_h; _y ++) {
+    gs_byte_pixel_t const * t = tmpl_view.get_ptr(0, _y);
+
+    for(unsigned int x = local_x; x < local_x + tmpl_w; ) {
+      master->get_tile_view(x, local_y + _y, view);
+      unsigned int n = std::min(local_x + tmpl_w, view.get_max_x()) - x;
+      uint64_t s;
+      sum_ft += dot_product_gs_byte(view.get_ptr(x, local_y + _y), t + (x - local_x), n, &s);
+      sum_f += s;
+      x += n;
+    }
+
+    nummerator = (double)sum_ft - tmpl_mean * (double)sum_f;
+
+    if(check_bound && (_y + 1) % block_rows == 0 && _y + 1 < tmpl_h) {
+
+      // For the remaining rows holds sum(f*t) = sum((f-c)*t) + c*sum(t)
+      // for any c. With c as the mean of f the first term is bounded
+      // by sqrt(sum((f-c)^2) * sum(t^2)).
+      const unsigned int rows = tmpl_h - _y - 1;
+      double s1, s2;
+      get_region_sums(summation_table_single, summation_table_squared,
+		      local_x, local_y + _y + 1, tmpl_w, rows, s1, s2);
+
+      const double mean = s1 / (tmpl_w * rows);
+      const double variance = std::max(0.0, s2 - s1 * mean);
+      const double bound = (nummerator +
+			    mean * remaining_rows->single[_y + 1] +
+			    sqrt(variance * remaining_rows->squared[_y + 1])) / denominator;
+
+      // Keep a margin for rounding errors.
+      if(bound < min_corr - 1e-6) {
+	stats.early_rejections++;
+	if(rejected != NULL) *rejected = true;
+	return bound;
+      }
     }
   }
 
@@ -666,6 +1268,193 @@ double TemplateMatching::calc_single_xcorr(const TileImage_GS_BYTE_shptr master,
   return q;
 }
 
+void TemplateMatching::prepare_xcorr_surface(struct prepared_template & tmpl) const {
+
+  const MemoryImage_GS_DOUBLE_shptr t = tmpl.zero_mean_template_scaled;
+  const unsigned int
+    tmpl_w = t->get_width(),
+    tmpl_h = t->get_height(),
+    img_w = gs_img_scaled->get_width(),
+    img_h = gs_img_scaled->get_height();
+
+  std::shared_ptr<xcorr_surface> s(new xcorr_surface());
+
+  // The block must be larger than the template. Otherwise most of the
+  // transform is spent on positions, that are not valid.
+  s->fft = std::shared_ptr<FFT2D>(new FFT2D(get_fft_size(std::max(2 * tmpl_w, 256U)),
+					    get_fft_size(std::max(2 * tmpl_h, 256U))));
+
+  const unsigned int n_w = s->fft->get_width(), n_h = s->fft->get_height();
+  s->block_w = n_w - tmpl_w + 1;
+  s->block_h = n_h - tmpl_h + 1;
+
+  // Keep a row or a column of blocks, depending on the scan direction.
+  s->max_blocks = std::max((img_w + s->block_w - 1) / s->block_w,
+			   (img_h + s->block_h - 1) / s->block_h) + 1;
+
+  s->tmpl_spectrum.resize(n_w * n_h);
+  for(unsigned int y = 0; y < tmpl_h; y++)
+    for(unsigned int x = 0; x < tmpl_w; x++)
+      s->tmpl_spectrum[y * n_w + x] = t->get_pixel(x, y);
+
+  s->fft->transform(&s->tmpl_spectrum[0]);
+
+  // A correlation is a convolution with the mirrored template.
+  for(std::vector<complex_t>::iterator iter = s->tmpl_spectrum.begin();
+      iter != s->tmpl_spectrum.end(); ++iter)
+    *iter = std::conj(*iter);
+
+  tmpl.surface_scaled = s;
+}
+
+
+void TemplateMatching::calc_xcorr_block(struct prepared_template const& tmpl,
+					unsigned int block_x, unsigned int block_y,
+					std::vector<double> & block) const {
+
+  xcorr_surface const& s = *tmpl.surface_scaled;
+
+  const unsigned int
+    n_w = s.fft->get_width(),
+    n_h = s.fft->get_height(),
+    tmpl_w = tmpl.zero_mean_template_scaled->get_width(),
+    tmpl_h = tmpl.zero_mean_template_scaled->get_height(),
+    img_w = gs_img_scaled->get_width(),
+    img_h = gs_img_scaled->get_height(),
+    min_x = block_x * s.block_w,
+    min_y = block_y * s.block_h;
+
+  assert(min_x < img_w && min_y < img_h);
+
+  // Copy the image region into the zero padded transform buffer.
+  std::vector<complex_t> data(n_w * n_h);
+  std::vector<gs_double_pixel_t> row(n_w);
+  const unsigned int w = std::min(n_w, img_w - min_x);
+
+  for(unsigned int y = 0; y < n_h && min_y + y < img_h; y++) {
+    read_row(gs_img_scaled, min_x, min_y + y, w, &row[0]);
+    for(unsigned int x = 0; x < w; x++) data[y * n_w + x] = row[x];
+  }
+
+  s.fft->transform(&data[0]);
+  for(unsigned int i = 0; i < data.size(); i++) data[i] *= s.tmpl_spectrum[i];
+  s.fft->transform(&data[0], true);
+
+  const double norm = 1.0 / ((double)n_w * n_h);
+
+  block.resize(s.block_w * s.block_h);
+  for(unsigned int v = 0; v < s.block_h; v++)
+    for(unsigned int u = 0; u < s.block_w; u++) {
+      unsigned int x = min_x + u, y = min_y + v;
+      double & q = block[v * s.block_w + u];
+
+      // The template does not fit into the image. Such positions
+      // are calculated directly, if they are requested at all.
+      if(x + tmpl_w > img_w || y + tmpl_h > img_h) {
+	q = NAN;
+	continue;
+      }
+
+      double denominator = calc_xcorr_denominator(sum_table_single_scaled,
+						  sum_table_squared_scaled,
+						  tmpl_w, tmpl_h,
+						  tmpl.sum_over_zero_mean_template_scaled,
+						  x, y);
+
+      if(std::isinf(denominator) || std::isnan(denominator) || denominator == 0) q = -1.0;
+      else q = data[v * n_w + u].real() * norm / denominator;
+    }
+}
+
+
+double TemplateMatching::get_scaled_xcorr(struct prepared_template const& tmpl,
+					  unsigned int local_x,
+					  unsigned int local_y,
+					  bool * rejected) const {
+
+  double q = NAN;
+  if(rejected != NULL) *rejected = false;
+
+  if(tmpl.surface_scaled != NULL &&
+     local_x < gs_img_scaled->get_width() && local_y < gs_img_scaled->get_height()) {
+
+    xcorr_surface & s = *tmpl.surface_scaled;
+    xcorr_surface::block_key key(local_x / s.block_w, local_y / s.block_h);
+
+    std::map<xcorr_surface::block_key, std::vector<double> >::iterator found = s.blocks.find(key);
+    if(found == s.blocks.end()) {
+      if(s.blocks.size() >= s.max_blocks) {
+	s.blocks.erase(s.order.front());
+	s.order.pop_front();
+      }
+      found = s.blocks.insert(std::make_pair(key, std::vector<double>())).first;
+      s.order.push_back(key);
+      calc_xcorr_block(tmpl, key.first, key.second, found->second);
+    }
+
+    q = found->second[(local_y % s.block_h) * s.block_w + (local_x % s.block_w)];
+  }
+
+  if(std::isnan(q)) {
+
+    region_statistics const* r = tmpl.region_stats.get();
+
+    if(r != NULL &&
+       local_x >= r->min_x && local_x < r->min_x + r->width &&
+       local_y >= r->min_y && local_y < r->min_y + r->height &&
+       !std::isnan(r->variance[(local_y - r->min_y) * r->width + local_x - r->min_x])) {
+
+      assert(r->tmpl_w == tmpl.zero_mean_template_scaled->get_width() &&
+	     r->tmpl_h == tmpl.zero_mean_template_scaled->get_height());
+
+      double variance = r->variance[(local_y - r->min_y) * r->width + local_x - r->min_x];
+      q = calc_xcorr(gs_img_scaled,
+		     sum_table_single_scaled,
+		     sum_table_squared_scaled,
+		     tmpl.tmpl_img_scaled,
+		     tmpl.mean_scaled,
+		     sqrt(variance * tmpl.sum_over_zero_mean_template_scaled),
+		     local_x, local_y,
+		     &tmpl.remaining_rows_scaled, get_scan_rejection_limit(), rejected);
+    }
+    else
+      q = calc_single_xcorr(gs_img_scaled,
+			    sum_table_single_scaled,
+			    sum_table_squared_scaled,
+			    tmpl.tmpl_img_scaled,
+			    tmpl.mean_scaled,
+			    tmpl.sum_over_zero_mean_template_scaled,
+			    local_x, local_y,
+			    &tmpl.remaining_rows_scaled, get_scan_rejection_limit(), rejected);
+  }
+  return q;
+}
+
+
+bool TemplateMatching::is_local_maximum(struct prepared_template const& tmpl,
+					unsigned int local_x,
+					unsigned int local_y,
+					double corr_val) const {
+
+  const unsigned int
+    tmpl_w = tmpl.zero_mean_template_scaled->get_width(),
+    tmpl_h = tmpl.zero_mean_template_scaled->get_height();
+
+  if(tmpl_w > gs_img_scaled->get_width() || tmpl_h > gs_img_scaled->get_height()) return true;
+
+  const unsigned int
+    max_x = gs_img_scaled->get_width() - tmpl_w,
+    max_y = gs_img_scaled->get_height() - tmpl_h;
+
+  for(unsigned int y = local_y > 0 ? local_y - 1 : 0; y <= std::min(local_y + 1, max_y); y++)
+    for(unsigned int x = local_x > 0 ? local_x - 1 : 0; x <= std::min(local_x + 1, max_x); x++)
+      if((x != local_x || y != local_y) && get_scaled_xcorr(tmpl, x, y) > corr_val)
+	return false;
+
+  return true;
+}
+
+
 bool TemplateMatchingNormal::get_next_pos(struct search_state * state,
 					  struct prepared_template const& tmpl) const {
 
@@ -769,6 +1558,55 @@ bool TemplateMatchingAlongGrid::initialize_state_struct(struct search_state * st
   return true;
 }
 
+bool TemplateMatchingAlongGrid::has_scan_parts() const {
+  return parallel_grid;
+}
+
+bool TemplateMatchingAlongGrid::get_scan_parts(struct prepared_template const& tmpl,
+					       BoundingBox const& search_area,
+					       std::vector<scan_part> & parts) const {
+
+  scan_part part;
+  init_search_state(part.start, search_area);
+  part.advance_first = false;
+
+  // The first part starts like the serial scan.
+  search_state grid_state = part.start;
+  if(!initialize_grid(&grid_state, tmpl)) return false;
+
+  parts.clear();
+
+  for(Grid::grid_iter iter = grid_state.iter_begin;
+      iter != grid_state.iter_end && *iter <= *(grid_state.iter_last); ++iter) {
+
+    part.line = iter;
+    parts.push_back(part);
+
+    // The other parts start at the end of the previous line. The next
+    // position is the first one on the line, as in the serial scan.
+    part.start = grid_state;
+    part.start.iter = iter;
+    part.start.x = grid_state.search_area.get_width();
+    part.start.y = grid_state.search_area.get_height();
+    part.advance_first = true;
+  }
+
+  return !parts.empty();
+}
+
+bool TemplateMatchingAlongGrid::is_in_scan_part(scan_part const& part,
+						struct search_state const& state) const {
+  return state.grid == NULL || state.iter == part.line;
+}
+
+bool TemplateMatchingInRows::initialize_grid(struct search_state * state,
+					     struct prepared_template const& tmpl) const {
+  return initialize_state_struct(state,
+				 state->search_area.get_min_y(),
+				 state->search_area.get_max_y() - tmpl.tmpl_img_normal->get_height(),
+				 false);
+}
+
 bool TemplateMatchingInRows::get_next_pos(struct search_state * state,
 					  struct prepared_template const& tmpl) const {
 
@@ -783,11 +1621,7 @@ bool TemplateMatchingInRows::get_next_pos(struct search_state * state,
   unsigned int step = state->step_size_search;
 
   // get grid and check if we are working on regular or irregular grid
-  if(state->grid == NULL &&
-     initialize_state_struct(state,
-			     state->search_area.get_min_y(),
-			     state->search_area.get_max_y() - tmpl_h,
-			     false) == false) {
+  if(state->grid == NULL && initialize_grid(state, tmpl) == false) {
     debug(TM, "Can't initialize search structure.");
     return false;
   }
@@ -838,6 +1672,14 @@ bool TemplateMatchingInRows::get_next_pos(struct search_state * state,
 }
 
 
+bool TemplateMatchingInCols::initialize_grid(struct search_state * state,
+					     struct prepared_template const& tmpl) const {
+  return initialize_state_struct(state,
+				 state->search_area.get_min_x(),
+				 state->search_area.get_max_x() - tmpl.tmpl_img_normal->get_width(),
+				 true);
+}
+
 bool TemplateMatchingInCols::get_next_pos(struct search_state * state,
 					  struct prepared_template const& tmpl) const {
 
@@ -852,11 +1694,7 @@ bool TemplateMatchingInCols::get_next_pos(struct search_state * state,
   unsigned int step = state->step_size_search;
 
   // get grid and check if we are working on regular or irregular grid
-  if(state->grid == NULL &&
-     initialize_state_struct(state,
-			     state->search_area.get_min_x(),
-			     state->search_area.get_max_x() - tmpl_w,
-			     true) == false)
+  if(state->grid == NULL && initialize_grid(state, tmpl) == false)
     return false;
 
 
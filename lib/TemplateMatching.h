@@ -26,6 +26,13 @@
 #include <Project.h>
 #include <Layer.h>
 #include <ProgressControl.h>
+#include <FFT.h>
+#include <PreparedTemplateCache.h>
+
+#include <vector>
+#include <map>
+#include <list>
+#include <atomic>
 
 namespace degate {
 
@@ -38,8 +45,16 @@ namespace degate {
     /** Number of template matches. */
     unsigned int hits;
 
+    /** Number of directly calculated correlation values. */
+    std::atomic<unsigned long> xcorr_calculations;
+
+    /** Number of correlation calculations, that were aborted early. */
+    std::atomic<unsigned long> early_rejections;
+
     void reset() {
       hits = 0;
+      xcorr_calculations = 0;
+      early_rejections = 0;
     }
   };
 
@@ -62,21 +77,67 @@ namespace degate {
   class TemplateMatching : public Matching {
   protected:
 
-    struct prepared_template {
-      TempImage_GS_BYTE_shptr tmpl_img_normal;
-      TempImage_GS_BYTE_shptr tmpl_img_scaled;
+    /**
+     * Dense correlation values of a template on the scaled background
+     * image. The values are calculated with FFTs in blocks of
+     * block_w x block_h positions, when a position in a block is
+     * requested first.
+     */
+    struct xcorr_surface {
+      std::shared_ptr<FFT2D> fft;
+
+      // Conjugated spectrum of the zero padded zero mean template.
+      std::vector<complex_t> tmpl_spectrum;
+
+      unsigned int block_w, block_h;
 
-      //TempImage_GS_BYTE_shptr zero_mean_template_normal; // GS_DOUBLE?
-      //TempImage_GS_BYTE_shptr zero_mean_template_scaled;
+      typedef std::pair<unsigned int, unsigned int> block_key;
+      std::map<block_key, std::vector<double> > blocks;
 
-      TempImage_GS_DOUBLE_shptr zero_mean_template_normal; // GS_DOUBLE?
-      TempImage_GS_DOUBLE_shptr zero_mean_template_scaled;
+      // Blocks in the order of their calculation. The oldest block is
+      // dropped, if there are more than max_blocks blocks.
+      std::list<block_key> order;
+      size_t max_blocks;
+    };
 
-      double sum_over_zero_mean_template_normal;
-      double sum_over_zero_mean_template_scaled;
+    /**
+     * The part of the denominator of the normalized cross correlation,
+     * that depends on the background only. It is calculated for all
+     * positions of a region on the scaled image and a template size.
+     * Positions, where the template does not fit, are NaN.
+     */
+    struct region_statistics {
+      unsigned int tmpl_w, tmpl_h;
+      unsigned int min_x, min_y, width, height;
+      std::vector<double> variance;
+    };
 
+    /**
+     * A gate template in a single orientation, that is prepared for
+     * matching. The images are shared with the prepared template cache
+     * of the gate library and must not be modified.
+     */
+    struct prepared_template : public PreparedTemplateImages {
       Gate::ORIENTATION orientation;
       GateTemplate_shptr gate_template;
+
+      // Only set, if FFT based correlation is used.
+      std::shared_ptr<xcorr_surface> surface_scaled;
+
+      // Only set in batched mode. It covers the current band and is
+      // shared by all templates of the same size.
+      std::shared_ptr<const region_statistics> region_stats;
+    };
+
+    /**
+     * The greyscale background image of the matching region on a
+     * scaling level and its summation tables.
+     */
+    struct background_level {
+      unsigned int scaling;
+      TileImage_GS_BYTE_shptr gs_img;
+      TileImage_SUM_UINT32_shptr sum_table_single;
+      TileImage_SUM_INT64_shptr sum_table_squared;
     };
 
 
@@ -93,7 +154,22 @@ namespace degate {
 	iter_end;
     };
 
-    struct TemplateMatchingStatistics stats;
+    /**
+     * A part of a scan, that can be processed independently from the
+     * other parts of the same scan.
+     */
+    struct scan_part {
+      search_state start;
+
+      // If true, the scan advances from the start state, before the
+      // first position is checked.
+      bool advance_first;
+
+      // The grid line of the part.
+      Grid::grid_iter line;
+    };
+
+    mutable struct TemplateMatchingStatistics stats;
 
   public:
 
@@ -107,21 +183,62 @@ namespace degate {
 
   private:
 
+    /**
+     * Matching of a single template in a single orientation. Tasks are
+     * processed in parallel. Their results are merged in task order.
+     */
+    struct matching_task {
+      GateTemplate_shptr tmpl;
+      Gate::ORIENTATION orientation;
+      BoundingBox search_area; // on unscaled uncropped image
+      std::list<match_found> matches;
+      double max_corr;
+    };
+
+    /**
+     * A part of the scan of a matching task. It is the whole scan, if
+     * \p part is npos.
+     */
+    struct part_task {
+      size_t task;
+      size_t part;
+      BoundingBox search_area;
+      std::list<match_found> matches;
+      double max_corr;
+    };
+
+    /**
+     * The scan state of a matching task in batched mode.
+     */
+    struct batch_task {
+      matching_task * task;
+      prepared_template tmpl;
+      search_state state;
+      bool done;
+    };
+
     // params for the matching
     double threshold_hc;
     double threshold_detection;
     unsigned int max_step_size_search;
     unsigned int scale_down;
+    bool use_fft;
+    bool coarse_to_fine;
+    bool early_rejection;
+    bool batched;
 
     // background images in greyscale
     TileImage_GS_BYTE_shptr gs_img_normal;
     TileImage_GS_BYTE_shptr gs_img_scaled;
 
     // summation tables
-    TileImage_GS_DOUBLE_shptr sum_table_single_normal;
-    TileImage_GS_DOUBLE_shptr sum_table_squared_normal;
-    TileImage_GS_DOUBLE_shptr sum_table_single_scaled;
-    TileImage_GS_DOUBLE_shptr sum_table_squared_scaled;
+    TileImage_SUM_UINT32_shptr sum_table_single_normal;
+    TileImage_SUM_INT64_shptr sum_table_squared_normal;
+    TileImage_SUM_UINT32_shptr sum_table_single_scaled;
+    TileImage_SUM_INT64_shptr sum_table_squared_scaled;
+
+    // Levels between the scaled and the normal image, from coarse to fine.
+    std::vector<background_level> refinement_levels;
 
     BoundingBox bounding_box; // bounding box on original unscaled background image
 
@@ -130,6 +247,7 @@ namespace degate {
 
     clock_t start, finish;
 
+    // The matches of the last run, sorted by correlation.
     std::list<match_found> matches;
 
   protected:
@@ -143,49 +261,236 @@ namespace degate {
 
 
 
-    void prepare_sum_tables(TileImage_GS_BYTE_shptr gs_img_normal,
-			    TileImage_GS_BYTE_shptr gs_img_scaled);
-
-    void precalc_sum_tables(TileImage_GS_BYTE_shptr img,
-			    TileImage_GS_DOUBLE_shptr summation_table_single,
-			    TileImage_GS_DOUBLE_shptr summation_table_squared);
-
-
     BoundingBox get_scaled_bounding_box(BoundingBox const& bounding_box,
 					double scale_down) const;
 
-    void prepare_background_images(ScalingManager_shptr sm,
-				   BoundingBox const& bounding_box,
-				   unsigned int scaling_factor);
+    /**
+     * Get the greyscale background image and the summation tables for
+     * the matching region on a scaling level. The data is cached in the
+     * directory, that the scaling manager provides for summation tables.
+     * A later run in the same region loads it from there.
+     */
+    background_level prepare_background_level(ScalingManager_shptr sm,
+					      BoundingBox const& bounding_box,
+					      unsigned int scaling_factor) const;
 
+    /**
+     * Calculate the greyscale background image and the summation tables
+     * of a region on a scaling level. The greyscale image is taken from
+     * the greyscale cache of the scaling manager.
+     * @param directory If not empty, the images are stored persistently
+     *   in this directory.
+     */
+    background_level build_background_level(ScalingManager_shptr sm,
+					    BoundingBox const& scaled_bounding_box,
+					    unsigned int scaling_factor,
+					    std::string const& directory) const;
+
+    /**
+     * Follow a candidate position from the scaled image through the
+     * refinement levels. On each level the best position in a small
+     * neighbourhood of the position from the previous level is taken.
+     * @param x Unscaled coordinate within the matching region. It
+     *   is updated.
+     * @param y Unscaled coordinate within the matching region. It
+     *   is updated.
+     * @param corr_val The correlation value. It is updated.
+     * @return Returns false, if the correlation drops below the hill
+     *   climbing threshold on a level.
+     */
+    bool refine_candidate(struct prepared_template const& tmpl,
+			  unsigned int & x, unsigned int & y,
+			  double & corr_val) const;
+
+    /**
+     * Prepare a gate template for matching. The images are taken from
+     * the prepared template cache of the gate library, if possible.
+     */
     struct prepared_template prepare_template(GateTemplate_shptr tmpl,
 					      Gate::ORIENTATION orientation);
 
+    /**
+     * Calculate the flipped, scaled and zero mean images of a gate template.
+     */
+    PreparedTemplateImages_shptr prepare_template_images(GateTemplate_shptr tmpl,
+							 Gate::ORIENTATION orientation) const;
+
 
     void hill_climbing(unsigned int start_x, unsigned int start_y, double xcorr_val,
 		       unsigned int * max_corr_x_out,
 		       unsigned int * max_corr_y_out,
 		       double * max_xcorr_out,
 		       const TileImage_GS_BYTE_shptr master,
-		       const TempImage_GS_DOUBLE_shptr zero_mean_template,
-		       double sum_over_zero_mean_template) const;
+		       const MemoryImage_GS_BYTE_shptr tmpl_img,
+		       double tmpl_mean,
+		       double sum_over_zero_mean_template,
+		       RemainingRowSums const& remaining_rows) const;
 
     /**
      * Adjust step size depending on correlation value.
      */
     void adjust_step_size(struct search_state & state, double corr_val) const;
 
+    /**
+     * Get the correlation value, below which positions of the scan are
+     * rejected early. Below this value adjust_step_size() keeps the
+     * maximum step size, so that a rejected position does not change
+     * the scan path.
+     */
+    double get_scan_rejection_limit() const;
+
     std::list<match_found> match_single_template(struct prepared_template & tmpl,
+						 BoundingBox const& search_area,
 						 double threshold_hc,
-						 double threshold_detection);
+						 double threshold_detection,
+						 double * max_corr_out);
+
+    /**
+     * Check the current scan position. If the correlation is high enough,
+     * candidates are refined and hill climbing starts.
+     * @param max_corr The maximum correlation value of the scan. It
+     *   is updated.
+     */
+    void match_position(struct prepared_template & tmpl,
+			struct search_state & state,
+			double threshold_hc,
+			double threshold_detection,
+			std::list<match_found> & matches,
+			double & max_corr) const;
+
+    /**
+     * Get the coordinate on the scaled image, that the scan advances
+     * along. It grows monotonically during a scan.
+     */
+    unsigned int get_scaled_scan_line(struct search_state const& state) const;
+
+    /**
+     * Get the position of a search state within the matching region.
+     */
+    void get_local_position(struct search_state const& state,
+			    unsigned int & x, unsigned int & y) const;
+
+    /**
+     * Match the templates in parts of the matching region. For each
+     * template an area is scanned, where the template overlaps a region.
+     * @param regions Regions on the unscaled uncropped image.
+     */
+    void match_regions(std::list<BoundingBox> const& regions);
+
+    /**
+     * Match all tasks, with the scans split into parts.
+     */
+    void run_in_parts(std::vector<matching_task> & tasks);
+
+    /**
+     * Process the part \p i of a scan.
+     */
+    void match_part(std::vector<part_task> & part_tasks,
+		    std::vector<prepared_template> & prepared,
+		    std::vector<std::vector<scan_part> > const& parts,
+		    size_t i);
+
+    /**
+     * Match all tasks in a single pass over the background image.
+     */
+    void run_batched(std::vector<matching_task> & tasks);
+
+    /**
+     * Continue the scan of the batched task \p i up to the end of a band.
+     * @param band_end The first scan line on the scaled image, that
+     *   is not part of the band.
+     */
+    void match_batch_task(std::vector<batch_task> & tasks,
+			  unsigned int band_end,
+			  size_t i);
+
+    /**
+     * Calculate the region statistics \p i for a band.
+     */
+    void calc_band_statistics(std::vector<std::shared_ptr<region_statistics> > & stats,
+			      size_t i) const;
+
+    /**
+     * Calculate the region statistics for the scaled image. The size and
+     * the region must be set in \p r.
+     */
+    void calc_region_statistics(region_statistics & r) const;
+
+    /**
+     * Process the matching task \p i.
+     */
+    void match_task(std::vector<matching_task> & tasks, size_t i);
 
 
     /**
      * Calculate a zero mean image from an image and return
      * the variance(?).
      */
-    double subtract_mean(TempImage_GS_BYTE_shptr img,
-			 TempImage_GS_DOUBLE_shptr zero_mean_img) const;
+    double subtract_mean(MemoryImage_GS_BYTE_shptr img,
+			 MemoryImage_GS_DOUBLE_shptr zero_mean_img) const;
+
+    /**
+     * Calculate the sums over the bottom rows of a zero mean template.
+     */
+    RemainingRowSums calc_remaining_row_sums(MemoryImage_GS_DOUBLE_shptr zero_mean_img) const;
+
+    /**
+     * Get the sum and the squared sum over a region of the background
+     * image from the summation tables.
+     */
+    void get_region_sums(const TileImage_SUM_UINT32_shptr summation_table_single,
+			 const TileImage_SUM_INT64_shptr summation_table_squared,
+			 unsigned int min_x, unsigned int min_y,
+			 unsigned int width, unsigned int height,
+			 double & sum_single, double & sum_squared) const;
+
+    /**
+     * Calculate the denominator of the normalized cross correlation from
+     * the summation tables.
+     * @return Returns the denominator. It might be NaN, infinite or 0, if
+     *   the image region is flat.
+     */
+    double calc_xcorr_denominator(const TileImage_SUM_UINT32_shptr summation_table_single,
+				  const TileImage_SUM_INT64_shptr summation_table_squared,
+				  unsigned int tmpl_width, unsigned int tmpl_height,
+				  double sum_over_zero_mean_template,
+				  unsigned int local_x,
+				  unsigned int local_y) const;
+
+    /**
+     * Prepare the FFT based correlation of a template on the scaled image.
+     */
+    void prepare_xcorr_surface(struct prepared_template & tmpl) const;
+
+    /**
+     * Calculate the correlation values of a block of positions with FFTs.
+     */
+    void calc_xcorr_block(struct prepared_template const& tmpl,
+			  unsigned int block_x, unsigned int block_y,
+			  std::vector<double> & block) const;
+
+    /**
+     * Get the correlation between a template and the scaled background
+     * image. Depending on the mode, the value is calculated directly or
+     * taken from the FFT based correlation surface.
+     * @param local_x Coordinate within the scaled image.
+     * @param local_y Coordinate within the scaled image.
+     * @param rejected If not NULL, it is set to true, if the position
+     *   was rejected early. The returned value is an upper bound then.
+     */
+    double get_scaled_xcorr(struct prepared_template const& tmpl,
+			    unsigned int local_x,
+			    unsigned int local_y,
+			    bool * rejected = NULL) const;
+
+    /**
+     * Check, if the correlation value at a position on the scaled image
+     * is not less than the values of its direct neighbours.
+     */
+    bool is_local_maximum(struct prepared_template const& tmpl,
+			  unsigned int local_x,
+			  unsigned int local_y,
+			  double corr_val) const;
 
     /**
      * Calculate correlation between template and background.
@@ -193,18 +498,49 @@ namespace degate {
      * @param master The image where we look for matchings.
      * @param summation_table_single
      * @param summation_table_squared
-     * @param zero_mean_template
+     * @param tmpl_img The template image.
+     * @param tmpl_mean The mean value of \p tmpl_img.
      * @param sum_over_zero_mean_template
      * @param local_x Coordinate within \p master.
      * @param local_y Coordinate within \p master.
+     * @param remaining_rows If not NULL and early rejection is enabled,
+     *   the calculation is aborted as soon as the correlation can not
+     *   reach \p min_corr any more.
+     * @param min_corr The correlation value of interest.
+     * @param rejected If not NULL, it is set to true, if the calculation
+     *   was aborted, else to false.
+     * @return Returns the correlation value. If the calculation is
+     *   aborted, an upper bound for the correlation is returned, that
+     *   is less than \p min_corr.
      */
     double calc_single_xcorr(const TileImage_GS_BYTE_shptr master,
-			     const TileImage_GS_DOUBLE_shptr summation_table_single,
-			     const TileImage_GS_DOUBLE_shptr summation_table_squared,
-			     const TempImage_GS_DOUBLE_shptr zero_mean_template,
+			     const TileImage_SUM_UINT32_shptr summation_table_single,
+			     const TileImage_SUM_INT64_shptr summation_table_squared,
+			     const MemoryImage_GS_BYTE_shptr tmpl_img,
+			     double tmpl_mean,
 			     double sum_over_zero_mean_template,
 			     unsigned int local_x,
-			     unsigned int local_y) const;
+			     unsigned int local_y,
+			     RemainingRowSums const* remaining_rows = NULL,
+			     double min_corr = -1,
+			     bool * rejected = NULL) const;
+
+    /**
+     * Calculate correlation between template and background with a
+     * known denominator.
+     * @see calc_single_xcorr()
+     */
+    double calc_xcorr(const TileImage_GS_BYTE_shptr master,
+		      const TileImage_SUM_UINT32_shptr summation_table_single,
+		      const TileImage_SUM_INT64_shptr summation_table_squared,
+		      const MemoryImage_GS_BYTE_shptr tmpl_img,
+		      double tmpl_mean,
+		      double denominator,
+		      unsigned int local_x,
+		      unsigned int local_y,
+		      RemainingRowSums const* remaining_rows,
+		      double min_corr,
+		      bool * rejected = NULL) const;
 
 
     bool add_gate(unsigned int x, unsigned int y,
@@ -226,6 +562,40 @@ namespace degate {
     virtual bool get_next_pos(struct search_state * state,
 			      struct prepared_template const& tmpl) const = 0;
 
+    /**
+     * Set a search state to the start of the scan.
+     * @param search_area The area to scan on the unscaled uncropped
+     *   image. It must be within the matching region.
+     */
+    void init_search_state(struct search_state & state,
+			   BoundingBox const& search_area) const;
+
+    /**
+     * Check, if the scan advances column by column instead of row by row.
+     */
+    virtual bool scans_in_columns() const { return false; }
+
+    /**
+     * Check, if scans are split into independent parts.
+     */
+    virtual bool has_scan_parts() const { return false; }
+
+    /**
+     * Split the scan of a template into independent parts. The parts
+     * must be processed in their order to get the result of the whole
+     * scan.
+     * @return Returns false, if the scan can't be split.
+     */
+    virtual bool get_scan_parts(struct prepared_template const& tmpl,
+				BoundingBox const& search_area,
+				std::vector<scan_part> & parts) const { return false; }
+
+    /**
+     * Check, if a scan position belongs to a part.
+     */
+    virtual bool is_in_scan_part(scan_part const& part,
+				 struct search_state const& state) const { return true; }
+
 
   public:
 
@@ -290,6 +660,99 @@ namespace degate {
 
     void set_scaling_factor(unsigned int factor) { scale_down = factor; }
 
+    /**
+     * Check, if FFT based correlation is used.
+     */
+
+    bool get_use_fft() const { return use_fft; }
+
+    /**
+     * Select the correlation engine for the scan on the scaled image.
+     *
+     * By default the correlation is calculated directly for each
+     * position, which costs O(w*h) per position for a template of the
+     * size w x h. To keep this affordable, the scan skips positions in
+     * areas of low correlation (see set_max_step_size()).
+     *
+     * With FFT based correlation, the correlation values of all positions
+     * are calculated block by block via fast fourier transforms. The scan
+     * then visits every position of the scaled image and starts hill
+     * climbing at local maxima only. This is faster for large templates
+     * and does not miss matches because of the step size.
+     */
+
+    void set_use_fft(bool state) { use_fft = state; }
+
+    /**
+     * Check, if candidates are refined on intermediate scaling levels.
+     */
+
+    bool get_coarse_to_fine() const { return coarse_to_fine; }
+
+    /**
+     * Enable or disable coarse-to-fine matching.
+     *
+     * Candidates are detected on the scaled image. If the scaling factor
+     * is larger than 2, there are prescaled images between the scaled and
+     * the normal image. With coarse-to-fine matching a candidate is
+     * followed through these levels, before hill climbing starts on the
+     * normal image. Candidates, that fall below the hill climbing
+     * threshold on a level, are dropped. It is enabled by default.
+     */
+
+    void set_coarse_to_fine(bool state) { coarse_to_fine = state; }
+
+    /**
+     * Check, if correlation calculations are aborted early.
+     */
+
+    bool get_early_rejection() const { return early_rejection; }
+
+    /**
+     * Enable or disable the early rejection of positions.
+     *
+     * The correlation is summed up in blocks of rows. After each block
+     * an upper bound for the final value is calculated. The rows, that
+     * are not summed up yet, are bounded with the Cauchy-Schwarz
+     * inequality. The sums over the background region are taken from the
+     * summation tables. If the bound is below the value of interest, the
+     * calculation is aborted. This is the hill climbing threshold for the
+     * scan and the best value so far for the refinement and the hill
+     * climbing.
+     *
+     * The refinement and the hill climbing return the same results as
+     * without early rejection. In the scan positions are only rejected
+     * below the correlation value, where the step size starts to shrink.
+     * So the scan visits the same positions and finds the same matches
+     * as without early rejection. It is enabled by default.
+     */
+
+    void set_early_rejection(bool state) { early_rejection = state; }
+
+    /**
+     * Check, if all templates are matched in a single pass.
+     */
+
+    bool get_batched() const { return batched; }
+
+    /**
+     * Enable or disable batched matching.
+     *
+     * By default each template in each orientation scans the whole
+     * matching region. The background tiles are loaded once per scan.
+     *
+     * In batched mode the scaled image is processed in bands of a few
+     * rows, or columns for column wise matching. All scans advance to
+     * the end of a band, before the next band is started. So the tiles
+     * of a band are used by all templates while they are in the tile
+     * cache. For each template size the denominators of the correlation
+     * on a band are calculated once from the summation tables.
+     *
+     * The matches are the same in both modes.
+     */
+
+    void set_batched(bool state) { batched = state; }
+
 
     /**
      * Run the template matching.
@@ -303,6 +766,22 @@ namespace degate {
 
     virtual void run();
 
+    /**
+     * Run the template matching again in parts of the matching region.
+     *
+     * This is meant for small corrections after a matching run, e.g.
+     * after gates were removed. The background images, the summation
+     * tables and the prepared templates from init() and the gate
+     * library are reused. Only positions, where a template overlaps a
+     * dirty region, are scanned. Positions, that are covered by placed
+     * gates, are skipped as in a full run.
+     *
+     * @param dirty_regions Regions on the unscaled uncropped image.
+     *   They are clipped to the matching region from init().
+     */
+
+    virtual void run_incremental(std::list<BoundingBox> const& dirty_regions);
+
     /**
      * Set templates that should be matched.
      * Templates become sorted, so that larger templates are matched first.
@@ -331,6 +810,31 @@ namespace degate {
       return stats.hits;
     }
 
+    /**
+     * Get the number of directly calculated correlation values of the
+     * last run.
+     */
+    unsigned long get_number_of_xcorr_calculations() const {
+      return stats.xcorr_calculations;
+    }
+
+    /**
+     * Get the number of correlation calculations of the last run, that
+     * were aborted early.
+     */
+    unsigned long get_number_of_early_rejections() const {
+      return stats.early_rejections;
+    }
+
+    /**
+     * Get the matches of the last run, sorted by correlation. This
+     * includes matches, that were not inserted as gates, because they
+     * overlap a gate with a higher correlation.
+     */
+    std::list<match_found> const& get_matches() const {
+      return matches;
+    }
+
   };
 
 
@@ -359,6 +863,10 @@ namespace degate {
 
   class TemplateMatchingAlongGrid : public TemplateMatching {
 
+  private:
+
+    bool parallel_grid;
+
   protected:
 
     bool initialize_state_struct(struct search_state * state,
@@ -366,13 +874,52 @@ namespace degate {
 				 int offs_max,
 				 bool is_horizontal_grid) const;
 
+    /**
+     * Set up the grid iteration of a search state.
+     * @return Returns false, if there is no usable grid.
+     */
+    virtual bool initialize_grid(struct search_state * state,
+				 struct prepared_template const& tmpl) const = 0;
+
     virtual bool get_next_pos(struct search_state * state,
 			      struct prepared_template const& tmpl) const = 0;
 
+    bool has_scan_parts() const;
+
+    /**
+     * Split the scan into grid lines.
+     */
+    bool get_scan_parts(struct prepared_template const& tmpl,
+			BoundingBox const& search_area,
+			std::vector<scan_part> & parts) const;
+
+    bool is_in_scan_part(scan_part const& part,
+			 struct search_state const& state) const;
+
   public:
 
+    TemplateMatchingAlongGrid() : parallel_grid(true) {}
+
     virtual ~TemplateMatchingAlongGrid() {}
 
+    /**
+     * Check, if grid lines are matched in parallel.
+     */
+
+    bool get_parallel_grid() const { return parallel_grid; }
+
+    /**
+     * Enable or disable the parallel matching of grid lines.
+     *
+     * Grid lines are independent from each other. If enabled, the lines
+     * of a template scan are handed to the worker threads. The matches
+     * of the lines are merged in grid order, so that the result is the
+     * same as with a serial scan. It is enabled by default. It is not
+     * used for FFT based correlation and in batched mode.
+     */
+
+    void set_parallel_grid(bool state) { parallel_grid = state; }
+
   };
 
 
@@ -383,6 +930,9 @@ namespace degate {
 
   protected:
 
+    bool initialize_grid(struct search_state * state,
+			 struct prepared_template const& tmpl) const;
+
     bool get_next_pos(struct search_state * state,
 		      struct prepared_template const& tmpl) const;
 
@@ -401,8 +951,13 @@ namespace degate {
 
   protected:
 
+    bool initialize_grid(struct search_state * state,
+			 struct prepared_template const& tmpl) const;
+
     bool get_next_pos(struct search_state * state,
 		      struct prepared_template const& tmpl) const;
+
+    bool scans_in_columns() const { return true; }
   public:
 
     TemplateMatchingInCols() {}
@@ -23,286 +23,720 @@
 #define __TILECACHE_H__
 
 #include <MemoryMap.h>
+#include <TilePackFile.h>
 #include <FileSystem.h>
 #include <Configuration.h>
 
 #include <string>
 #include <map>
+#include <list>
 #include <memory>
-#include <ctime>
+#include <atomic>
+#include <unordered_map>
+#include <set>
+#include <deque>
 #include <utility> // for make_pair
 #include <iostream>
 #include <iomanip>
 
-#ifdef __APPLE__
-  #include <sys/time.h> // for gettimeofday
-  #define GET_CLOCK(dst_variable) \
-  { \
-      struct timeval tv; \
-      gettimeofday(&tv, NULL); \
-      dst_variable.tv_sec = tv.tv_sec; \
-      dst_variable.tv_nsec = tv.tv_usec * 1000; \
-  }
-#else
-  #define GET_CLOCK(dst_variable) \
-      clock_gettime(CLOCK_MONOTONIC,  &dst_variable);
-#endif
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
 
 // #define TILECACHE_DEBUG
 
-/**
- * Overloaded comparison operator for timespec-structs.
- * @return Returns true, if \p a is completely before \p b. Else
- *   false is returned.
- */
-static bool operator<(struct timespec const & a, struct timespec const & b) {
-  if(a.tv_sec < b.tv_sec) return true;
-  else if(a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec) return true;
-  else return false;
-}
-
 namespace degate {
 
+  /**
+   * Identifies a tile within a TileCache. The upper 32 bits hold the
+   * tile number in x direction, the lower 32 bits the tile number
+   * in y direction.
+   */
+  typedef uint64_t tile_key_t;
+
+  inline tile_key_t make_tile_key(unsigned int tile_num_x, unsigned int tile_num_y) {
+    return (static_cast<tile_key_t>(tile_num_x) << 32) | tile_num_y;
+  }
+
+  inline unsigned int get_tile_num_x(tile_key_t key) { return key >> 32; }
+  inline unsigned int get_tile_num_y(tile_key_t key) { return key & 0xffffffff; }
+
 
   class TileCacheBase {
   public:
-    virtual void cleanup_cache() = 0;
+
+    virtual ~TileCacheBase() {}
+
+    /**
+     * Remove a single tile from the local cache. This method is called by
+     * the GlobalTileCache, if the tile was selected for eviction.
+     * @return Returns the removed tile. The caller releases it after it
+     *   dropped its locks, because releasing a tile might write it back.
+     */
+    virtual std::shared_ptr<void> evict_tile(tile_key_t key) = 0;
+
+    /**
+     * Load a tile into the local cache, if it is not there yet. This
+     * method is called by the TilePrefetcher from its worker threads.
+     */
+    virtual void prefetch_tile(tile_key_t key) = 0;
+
     virtual void print() const = 0;
+
+  protected:
+
+    /**
+     * Get a number that identifies a cache object for the whole program
+     * run. Unlike the object's address, the number is never reused.
+     */
+    static uint64_t create_cache_id() {
+      static std::atomic<uint64_t> next_id(1);
+      return next_id++;
+    }
+  };
+
+
+  /**
+   * Counters of the global tile cache.
+   */
+  struct TileCacheStatistics {
+
+    /** Number of tile lookups, that were served from the cache. */
+    uint64_t hits;
+
+    /** Number of tile lookups, that required loading a tile. */
+    uint64_t misses;
+
+    /** Number of tiles that were removed to make room for other tiles. */
+    uint64_t evictions;
+
+    /** Number of tiles, that were loaded by the prefetcher. */
+    uint64_t prefetches;
+
+    /** Number of prefetched tiles, that were used afterwards. */
+    uint64_t prefetch_hits;
+
+    /** Number of prefetched tiles, that were evicted without being used. */
+    uint64_t prefetch_misses;
+
+    /** Number of cached tiles. */
+    size_t tiles;
+
+    size_t allocated_memory;
+    size_t max_cache_memory;
+
+    /**
+     * Get the ratio of cache hits to all lookups.
+     */
+    double get_hit_rate() const {
+      return hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0;
+    }
+
+    /**
+     * Get the ratio of used prefetched tiles to all prefetched tiles.
+     */
+    double get_prefetch_hit_rate() const {
+      return prefetches > 0 ? (double)prefetch_hits / (double)prefetches : 0;
+    }
   };
 
+
+  /**
+   * The GlobalTileCache limits the memory, that is used by all TileCache
+   * objects together.
+   *
+   * Cached tiles are kept in least recently used lists. The lists are
+   * split into shards, each protected by its own mutex, so that threads
+   * working on different tiles rarely contend for the same lock. Touching
+   * and evicting a tile are O(1) operations. The memory limit is global:
+   * If a shard has no more tiles to free, eviction continues on the next
+   * shard.
+   *
+   * Locking order: A shard lock may be held while a TileCache locks
+   * its local cache in evict_tile(). A TileCache must therefore never call
+   * into the GlobalTileCache while it holds its own lock.
+   */
   class GlobalTileCache : public SingletonBase<GlobalTileCache> {
 
     friend class SingletonBase<GlobalTileCache>;
 
   private:
 
-    size_t max_cache_memory;
-    size_t allocated_memory;
+    static const unsigned int num_shards = 16;
+
+    struct cache_entry {
+      TileCacheBase * holder;
+      tile_key_t key;
+      size_t size;
+    };
+
+    typedef std::list<cache_entry> lru_list_t;
+    typedef std::pair<TileCacheBase *, tile_key_t> entry_id_t;
+
+    struct entry_id_hash {
+      size_t operator()(entry_id_t const& id) const {
+	uint64_t h = reinterpret_cast<uintptr_t>(id.first) ^ (id.second * 0x9e3779b97f4a7c15ULL);
+	return h ^ (h >> 29);
+      }
+    };
 
-    typedef std::pair<struct timespec, size_t> cache_entry_t;
-    typedef std::map<TileCacheBase *, cache_entry_t> cache_t;
+    typedef std::unordered_map<entry_id_t, lru_list_t::iterator, entry_id_hash> index_t;
 
-    cache_t cache;
+    struct shard {
+      boost::mutex mtx;
+      lru_list_t lru; // most recently used tiles are at the front
+      index_t index;
+    };
+
+    shard shards[num_shards];
+
+    const size_t max_cache_memory;
+    std::atomic<size_t> allocated_memory;
+
+    std::atomic<uint64_t> hits, misses, evictions;
+    std::atomic<uint64_t> prefetches, prefetch_hits, prefetch_misses;
 
   private:
 
-    GlobalTileCache() : allocated_memory(0) {
-      Configuration & conf = Configuration::get_instance();
-      max_cache_memory = conf.get_max_tile_cache_size() * 1024 *1024;
+    GlobalTileCache() :
+      max_cache_memory(Configuration::get_instance().get_max_tile_cache_size() * 1024 * 1024),
+      allocated_memory(0),
+      hits(0),
+      misses(0),
+      evictions(0),
+      prefetches(0),
+      prefetch_hits(0),
+      prefetch_misses(0) {
     }
 
-    void remove_oldest() {
-      struct timespec now;
-      GET_CLOCK(now);
+    shard & get_shard(TileCacheBase * holder, tile_key_t key) {
+      return shards[entry_id_hash()(entry_id_t(holder, key)) % num_shards];
+    }
 
-      TileCacheBase * oldest = NULL;
+    /**
+     * Remove the least recently used tile from a shard.
+     * @return Returns false, if the shard is empty.
+     */
+    bool remove_oldest(shard & s) {
+      std::shared_ptr<void> released;
+      boost::mutex::scoped_lock lock(s.mtx);
 
-      for(cache_t::iterator iter = cache.begin(); iter != cache.end(); ++iter) {
-	cache_entry_t & entry = iter->second;
-	if(entry.first < now) {
-	  now.tv_sec = entry.first.tv_sec;
-	  now.tv_nsec = entry.first.tv_nsec;
-	  oldest = iter->first;
-	}
-      }
+      if(s.lru.empty()) return false;
+
+      cache_entry const entry = s.lru.back();
+      s.index.erase(entry_id_t(entry.holder, entry.key));
+      s.lru.pop_back();
+      allocated_memory -= entry.size;
+      evictions++;
 
-      if(oldest) {
-#ifdef TILECACHE_DEBUG
-	debug(TM, "Will call cleanup on %p", oldest);
-#endif
-	oldest->cleanup_cache();
-      }
-      else {
 #ifdef TILECACHE_DEBUG
-	debug(TM, "there is nothing to free.");
-	print_table();
+      debug(TM, "Will evict tile %llx from %p", entry.key, entry.holder);
 #endif
-      }
+      // The shard lock is still held. This prevents the holder from
+      // being destroyed, while it removes the tile. The tile itself is
+      // released after the lock.
+      released = entry.holder->evict_tile(entry.key);
+      lock.unlock();
+      return true;
     }
 
   public:
 
-    void print_table() const {
+    void print_table() {
+      TileCacheStatistics s = get_statistics();
+
       std::cout << "Global Image Tile Cache:\n"
-        << "Used memory : " << allocated_memory << " bytes\n"
-        << "Max memory  : " << max_cache_memory << " bytes\n\n"
-        << "Holder           | Last access (sec,nsec)    | Amount of memory\n"
-        << "-----------------+---------------------------+------------------------------------\n";
-
-      for(cache_t::const_iterator iter = cache.begin(); iter != cache.end(); ++iter) {
-        cache_entry_t const& entry = iter->second;
-        std::cout << std::setw(16) << std::hex << static_cast<void*>(iter->first);
-        std::cout << " | ";
-        std::cout << std::setw(12) << entry.first.tv_sec;
-        std::cout << ".";
-        std::cout << std::setw(12) << entry.first.tv_nsec;
-        std::cout << " | ";
-        std::cout << entry.second/(1024*1024) << " M (" << entry.second << " bytes)\n";
-        iter->first->print();
+		<< "Used memory : " << s.allocated_memory << " bytes\n"
+		<< "Max memory  : " << s.max_cache_memory << " bytes\n"
+		<< "Tiles       : " << s.tiles << "\n"
+		<< "Hits        : " << s.hits << "\n"
+		<< "Misses      : " << s.misses << "\n"
+		<< "Evictions   : " << s.evictions << "\n"
+		<< "Hit rate    : " << s.get_hit_rate() * 100.0 << " %\n"
+		<< "Prefetches  : " << s.prefetches << "\n"
+		<< "Prefetch hit rate : " << s.get_prefetch_hit_rate() * 100.0 << " %\n\n"
+		<< "Shard | Tiles | Amount of memory\n"
+		<< "------+-------+------------------------------------\n";
+
+      for(unsigned int i = 0; i < num_shards; i++) {
+	boost::mutex::scoped_lock lock(shards[i].mtx);
+	size_t mem = 0;
+	for(lru_list_t::const_iterator iter = shards[i].lru.begin();
+	    iter != shards[i].lru.end(); ++iter) mem += iter->size;
+
+	std::cout << std::setw(5) << i << " | "
+		  << std::setw(5) << shards[i].lru.size() << " | "
+		  << mem/(1024*1024) << " M (" << mem << " bytes)\n";
       }
       std::cout << "\n";
     }
 
-    bool request_cache_memory(TileCacheBase * requestor, size_t amount) {
+    /**
+     * Get the cache counters.
+     */
+    TileCacheStatistics get_statistics() {
+      TileCacheStatistics s;
+      s.hits = hits;
+      s.misses = misses;
+      s.evictions = evictions;
+      s.prefetches = prefetches;
+      s.prefetch_hits = prefetch_hits;
+      s.prefetch_misses = prefetch_misses;
+      s.allocated_memory = allocated_memory;
+      s.max_cache_memory = max_cache_memory;
+      s.tiles = 0;
+      for(unsigned int i = 0; i < num_shards; i++) {
+	boost::mutex::scoped_lock lock(shards[i].mtx);
+	s.tiles += shards[i].lru.size();
+      }
+      return s;
+    }
+
+    /**
+     * Reset the hit, miss, eviction and prefetch counters.
+     */
+    void reset_statistics() {
+      hits = 0;
+      misses = 0;
+      evictions = 0;
+      prefetches = 0;
+      prefetch_hits = 0;
+      prefetch_misses = 0;
+    }
+
+    /**
+     * Get the memory limit of the cache in bytes.
+     */
+    size_t get_max_cache_memory() const { return max_cache_memory; }
+
+    /**
+     * Count a tile lookup, that was served from a local cache.
+     */
+    void record_hit() { hits++; }
+
+    /**
+     * Count a tile lookup, that required loading the tile.
+     */
+    void record_miss() { misses++; }
+
+    /**
+     * Count a tile, that was loaded by the prefetcher.
+     */
+    void record_prefetch() { prefetches++; }
+
+    /**
+     * Count the first lookup of a prefetched tile.
+     */
+    void record_prefetch_hit() { prefetch_hits++; }
+
+    /**
+     * Count a prefetched tile, that was evicted before it was used.
+     */
+    void record_prefetch_miss() { prefetch_misses++; }
+
+    /**
+     * Register a newly loaded tile. If there is not enough memory left,
+     * least recently used tiles are evicted. Eviction starts in the shard
+     * of the new tile.
+     */
+    void insert_tile(TileCacheBase * holder, tile_key_t key, size_t amount) {
 
 #ifdef TILECACHE_DEBUG
-      debug(TM, "Local cache %p requests %d bytes.", requestor, amount);
-#endif
-      while(allocated_memory + amount > max_cache_memory) {
-#ifdef TILECACHE_DEBUG
-	debug(TM, "Try to free memory");
+      debug(TM, "Local cache %p requests %d bytes.", holder, amount);
 #endif
-	remove_oldest();
+      shard & s = get_shard(holder, key);
+      unsigned int start = &s - shards;
+
+      for(unsigned int i = 0;
+	  allocated_memory + amount > max_cache_memory && i < num_shards; ) {
+	if(!remove_oldest(shards[(start + i) % num_shards])) i++;
       }
 
-      if(allocated_memory + amount <= max_cache_memory) {
-	struct timespec now;
-	GET_CLOCK(now);
-
-	cache_t::iterator found = cache.find(requestor);
-	if(found == cache.end()) {
-	  cache[requestor] = std::make_pair(now, amount);
-	}
-	else {
-	  cache_entry_t & entry = found->second;
-	  entry.first.tv_sec = now.tv_sec;
-	  entry.first.tv_nsec = now.tv_nsec;
-	  entry.second += amount;
-	}
+      if(allocated_memory + amount > max_cache_memory)
+	debug(TM, "Can't free memory. Tile cache will exceed its limit.");
 
+      boost::mutex::scoped_lock lock(s.mtx);
+      entry_id_t id(holder, key);
+      if(s.index.find(id) == s.index.end()) {
+	cache_entry entry = { holder, key, amount };
+	s.lru.push_front(entry);
+	s.index[id] = s.lru.begin();
 	allocated_memory += amount;
-#ifdef TILECACHE_DEBUG
-	print_table();
-#endif
-	return true;
       }
+    }
 
-      debug(TM, "Can't free memory.");
+    /**
+     * Mark a tile as recently used.
+     */
+    void touch_tile(TileCacheBase * holder, tile_key_t key) {
+      shard & s = get_shard(holder, key);
+      boost::mutex::scoped_lock lock(s.mtx);
 
-      print_table();
-      return false;
+      index_t::iterator found = s.index.find(entry_id_t(holder, key));
+      if(found != s.index.end())
+	s.lru.splice(s.lru.begin(), s.lru, found->second);
     }
 
-    void release_cache_memory(TileCacheBase * requestor, size_t amount) {
+    /**
+     * Unregister all tiles of a local cache. After this method returned,
+     * the local cache will not be called back anymore.
+     */
+    void release_tiles(TileCacheBase * holder) {
 
 #ifdef TILECACHE_DEBUG
-      debug(TM, "Local cache %p releases %d bytes.", requestor, amount);
+      debug(TM, "Local cache %p releases its tiles.", holder);
 #endif
 
-      cache_t::iterator found = cache.find(requestor);
+      for(unsigned int i = 0; i < num_shards; i++) {
+	shard & s = shards[i];
+	boost::mutex::scoped_lock lock(s.mtx);
 
-      if(found == cache.end()) {
-	debug(TM, "Unknown memory should be released.");
-	print_table();
-	assert(1==0);
-      }
-      else {
-	cache_entry_t & entry = found->second;
-
-	if(entry.second >= amount) {
-	  entry.second -= amount;
-	  assert(allocated_memory >= amount);
-	  if(allocated_memory >= amount) allocated_memory -= amount;
-	  else {
-	    debug(TM, "More mem to release than available.");
-	    print_table();
-	    assert(1==0);
+	for(lru_list_t::iterator iter = s.lru.begin(); iter != s.lru.end(); ) {
+	  if(iter->holder == holder) {
+	    s.index.erase(entry_id_t(iter->holder, iter->key));
+	    allocated_memory -= iter->size;
+	    iter = s.lru.erase(iter);
 	  }
+	  else ++iter;
 	}
-	else {
-	  print_table();
-	  assert(entry.second >= amount); // will break
-	}
+      }
+    }
 
-	if(entry.second == 0) {
-#ifdef TILECACHE_DEBUG
-	  debug(TM, "Memory completely released. Remove entry from global cache.");
-#endif
-	  cache.erase(found);
+  };
+
+
+  /**
+   * The TilePrefetcher loads tiles in background threads, before they are
+   * accessed. TileCache objects queue tiles, that they expect to be
+   * accessed soon. A worker thread calls back the TileCache, which loads
+   * the tile, asks the kernel to read the file in advance and faults in
+   * its pages.
+   *
+   * The queue has a limited length. If it is full, the oldest requests
+   * are dropped, because they are the most likely ones to be outdated.
+   * The number of threads is configured via Configuration::get_prefetch_threads().
+   */
+  class TilePrefetcher : public SingletonBase<TilePrefetcher> {
+
+    friend class SingletonBase<TilePrefetcher>;
+
+  private:
+
+    static const size_t max_queue_length = 1024;
+
+    typedef std::pair<TileCacheBase *, tile_key_t> request_t;
+
+    std::deque<request_t> queue;
+    std::set<request_t> queued;
+
+    // Caches, for which a worker currently loads a tile.
+    std::multiset<TileCacheBase *> active;
+
+    boost::mutex mtx;
+    boost::condition_variable cond;
+    boost::thread_group threads;
+    bool stop;
+
+    const unsigned int num_threads;
+
+  private:
+
+    TilePrefetcher() :
+      stop(false),
+      num_threads(Configuration::get_instance().get_prefetch_threads()) {
+
+      // The workers use the GlobalTileCache. Make sure it exists.
+      GlobalTileCache::get_instance();
+
+      for(unsigned int i = 0; i < num_threads; i++)
+	threads.create_thread(boost::bind(&TilePrefetcher::worker, this));
+    }
+
+    void worker() {
+      boost::mutex::scoped_lock lock(mtx);
+
+      while(true) {
+	while(queue.empty() && !stop) cond.wait(lock);
+	if(stop) return;
+
+	request_t r = queue.front();
+	queue.pop_front();
+	queued.erase(r);
+	active.insert(r.first);
+	lock.unlock();
+
+	try {
+	  r.first->prefetch_tile(r.second);
+	}
+	catch(std::exception const& ex) {
+	  // The thread, that accesses the tile, will get the error, too.
+	  debug(TM, "Prefetching a tile failed: %s", ex.what());
 	}
+	catch(...) {
+	  debug(TM, "Prefetching a tile failed.");
+	}
+
+	lock.lock();
+	active.erase(active.find(r.first));
+	cond.notify_all();
       }
+    }
+
+  public:
 
+    ~TilePrefetcher() {
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	stop = true;
+	cond.notify_all();
+      }
+      threads.join_all();
     }
 
+    /**
+     * Check, if prefetching is enabled.
+     */
+    bool is_enabled() const { return num_threads > 0; }
+
+    /**
+     * Queue a tile for prefetching.
+     */
+    void request(TileCacheBase * holder, tile_key_t key) {
+      if(!is_enabled()) return;
+
+      boost::mutex::scoped_lock lock(mtx);
+      request_t r(holder, key);
+      if(!queued.insert(r).second) return;
+
+      if(queue.size() >= max_queue_length) {
+	queued.erase(queue.front());
+	queue.pop_front();
+      }
+      queue.push_back(r);
+      cond.notify_all();
+    }
+
+    /**
+     * Remove all queued requests of a cache and wait until no worker
+     * loads a tile for it anymore. After this method returned, the cache
+     * will not be called back anymore, unless it queues new requests.
+     */
+    void cancel(TileCacheBase * holder) {
+      if(!is_enabled()) return;
+
+      boost::mutex::scoped_lock lock(mtx);
+      for(std::deque<request_t>::iterator iter = queue.begin(); iter != queue.end(); ) {
+	if(iter->first == holder) {
+	  queued.erase(*iter);
+	  iter = queue.erase(iter);
+	}
+	else ++iter;
+      }
+      while(active.find(holder) != active.end()) cond.wait(lock);
+    }
+
+    /**
+     * Wait until all queued tiles are loaded.
+     */
+    void wait() {
+      boost::mutex::scoped_lock lock(mtx);
+      while(!queue.empty() || !active.empty()) cond.wait(lock);
+    }
   };
 
 
   /**
    * The TileCache class handles caching of image tiles.
    *
-   * The implementation keeps track how old the cached tile is.
-   * If new tiles become loaded, old tiles are removed from the
-   * cache. You can control the numer of cached tiles via the
-   * constructor parameter \p _min_cache_tiles. The memory
-   * requirement is around
-   * \p _min_cache_tiles*sizeof(PixelPolicy::pixel_type)*(2^_tile_width_exp)^2 ,
+   * Loaded tiles are registered in the GlobalTileCache, that decides
+   * which tiles are removed, if the memory limit is reached. The memory
+   * requirement per tile is
+   * sizeof(PixelPolicy::pixel_type)*(2^_tile_width_exp)^2 ,
    * where \p sizeof(PixelPolicy::pixel_type) is the size of a pixel.
+   *
+   * Tiles can be requested from multiple threads. For pixel access there
+   * is a fast path: Each thread remembers the tile it used last in a
+   * TileHandle. As long as pixel accesses stay within that tile, no
+   * lookup, no locking and no reference counting happens.
+   *
+   * Tiles are either stored as raw files, that are mapped into memory
+   * (MAP_STORAGE_TYPE_PERSISTENT_FILE), as compressed files
+   * (MAP_STORAGE_TYPE_COMPRESSED_FILE) or in a level of a TilePackFile
+   * (MAP_STORAGE_TYPE_PACK_FILE). Compressed tiles are decompressed
+   * on load and written back, when the last reference to a tile, that
+   * was marked as modified, is dropped. Tiles of a pack file refer to the file's mapping.
+   *
+   * The cache watches the order of tile lookups. If consecutive lookups
+   * move in a constant direction, as scanners in raster order do, the
+   * next tiles in that direction are queued in the TilePrefetcher.
+   * Users, that know which region they will read, can queue it with
+   * prefetch().
    */
 
   template<class PixelPolicy>
   class TileCache : public TileCacheBase {
 
-    friend class GlobalTileCache;
+  public:
+
+    typedef typename PixelPolicy::pixel_type pixel_type;
+    typedef std::shared_ptr<MemoryMap<pixel_type> > MemoryMap_shptr;
+
+    /**
+     * A reference to a single tile. The handle pins the tile's memory
+     * mapping, so the raw \p data pointer stays valid even if the tile
+     * is evicted from the cache in the meantime. The pinned memory is
+     * not accounted in the GlobalTileCache.
+     */
+    struct TileHandle {
+      uint64_t cache_id;
+      tile_key_t key;
+      MemoryMap_shptr pin;
+      pixel_type * data;
+
+      TileHandle() : cache_id(0), key(0), data(NULL) {}
+    };
 
   private:
 
-    typedef std::shared_ptr<MemoryMap<typename PixelPolicy::pixel_type> > MemoryMap_shptr;
-    typedef std::map< std::string, // filename
-		      std::pair<MemoryMap_shptr, struct timespec> > cache_type;
+    typedef std::map<tile_key_t, MemoryMap_shptr> cache_type;
+
+    /**
+     * Bookkeeping for compressed tiles. A tile, that is pinned by a handle,
+     * might outlive its cache entry. Such a tile is reused, if it is
+     * requested again. A tile, that is being loaded or written back, is
+     * marked as busy, so that no one reads an outdated file meanwhile.
+     * The state is shared with the tiles and outlives the TileCache.
+     */
+    struct compressed_tiles {
+      boost::mutex mtx;
+      boost::condition_variable cond;
+      std::map<tile_key_t, std::weak_ptr<MemoryMap<pixel_type> > > live;
+      std::set<tile_key_t> busy;
+    };
+
+    // Number of tiles to prefetch ahead of a detected scan direction.
+    static const unsigned int prefetch_distance = 4;
+
+    // Number of handles per thread and pixel type.
+    static const unsigned int thread_handle_slots = 16;
 
+    const unsigned int tiles_x, tiles_y;
     const std::string directory;
     const unsigned int tile_width_exp;
     const bool persistent;
+    const MAP_STORAGE_TYPE tile_storage;
+    const uint64_t cache_id;
 
     cache_type cache;
 
-    // Used for caching the working tile.
-    mutable MemoryMap_shptr current_tile;
-    mutable unsigned curr_tile_num_x;
-    mutable unsigned curr_tile_num_y;
+    // Prefetched tiles, that were not looked up yet.
+    std::set<tile_key_t> prefetched;
+
+    mutable boost::mutex mtx;
+
+    // The tile, that was looked up last.
+    std::atomic<tile_key_t> last_key;
+
+    std::shared_ptr<compressed_tiles> compressed;
 
+    const TilePackFile_shptr pack;
+    const unsigned int pack_level;
 
   public:
 
     /**
      * Create a TileCache object.
+     * @param _width The width of the image in pixels.
+     * @param _height The height of the image in pixels.
      * @param _directory The directory where all the tiles are for a TileImage.
      * @param _tile_width_exp
      * @param _persistent
+     * @param _tile_storage The file format of the tiles. Either
+     *   MAP_STORAGE_TYPE_PERSISTENT_FILE, MAP_STORAGE_TYPE_COMPRESSED_FILE
+     *   or MAP_STORAGE_TYPE_PACK_FILE.
+     * @param _pack The pack file for MAP_STORAGE_TYPE_PACK_FILE.
+     * @param _pack_level The level within the pack file.
      */
 
-    TileCache(std::string const& _directory,
+    TileCache(unsigned int _width,
+	      unsigned int _height,
+	      std::string const& _directory,
 	      unsigned int _tile_width_exp,
 	      bool _persistent,
-	      unsigned int _min_cache_tiles = 4) :
+	      MAP_STORAGE_TYPE _tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE,
+	      TilePackFile_shptr _pack = TilePackFile_shptr(),
+	      unsigned int _pack_level = 0) :
+      tiles_x((_width + (1 << _tile_width_exp) - 1) >> _tile_width_exp),
+      tiles_y((_height + (1 << _tile_width_exp) - 1) >> _tile_width_exp),
       directory(_directory),
       tile_width_exp(_tile_width_exp),
-      persistent(_persistent) {}
+      persistent(_persistent),
+      tile_storage(_tile_storage),
+      cache_id(create_cache_id()),
+      last_key(make_tile_key(UINT_MAX, UINT_MAX)),
+      pack(_pack),
+      pack_level(_pack_level) {
+
+      assert(tile_storage == MAP_STORAGE_TYPE_PERSISTENT_FILE ||
+	     tile_storage == MAP_STORAGE_TYPE_COMPRESSED_FILE ||
+	     tile_storage == MAP_STORAGE_TYPE_PACK_FILE);
+      assert((tile_storage == MAP_STORAGE_TYPE_PACK_FILE) == (pack != NULL));
+
+      if(tile_storage == MAP_STORAGE_TYPE_COMPRESSED_FILE)
+	compressed = std::shared_ptr<compressed_tiles>(new compressed_tiles());
+    }
 
     /**
      * Destroy a TileCache object.
      */
 
     ~TileCache() {
-      if(cache.size() > 0) {
-	GlobalTileCache & gtc = GlobalTileCache::get_instance();
-	gtc.release_cache_memory(this, cache.size() * get_image_size());
-      }
+      TilePrefetcher::get_instance().cancel(this);
+      GlobalTileCache::get_instance().release_tiles(this);
+
+      // Unpin the tile of the destroying thread. Other threads release
+      // their handle when another cache uses the same slot.
+      TileHandle & h = get_thread_handle(cache_id);
+      if(h.cache_id == cache_id) h = TileHandle();
     }
 
+    /**
+     * Get the file format of the tiles.
+     */
+    MAP_STORAGE_TYPE get_tile_storage() const { return tile_storage; }
+
     void print() const {
+      boost::mutex::scoped_lock lock(mtx);
       for(typename cache_type::const_iterator iter = cache.begin();
 	  iter != cache.end(); ++iter) {
 	std::cout << "\t+ "
 		  << directory << "/"
-		  << (*iter).first << " "
-		  << (*iter).second.second.tv_sec
-		  << "/"
-		  << (*iter).second.second.tv_nsec
+		  << get_tile_filename(iter->first)
 		  << std::endl;
       }
     }
 
+    /**
+     * Write modified tiles of the cache back into their files.
+     */
+    void sync() {
+      if(pack != NULL) {
+	pack->sync();
+	return;
+      }
+
+      std::list<MemoryMap_shptr> tiles;
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	for(typename cache_type::const_iterator iter = cache.begin();
+	    iter != cache.end(); ++iter) tiles.push_back(iter->second);
+      }
+
+      for(typename std::list<MemoryMap_shptr>::iterator iter = tiles.begin();
+	  iter != tiles.end(); ++iter) (*iter)->sync();
+    }
+
     /**
      * Get a tile. If the tile is not in the cache, the tile is loaded.
      *
@@ -311,86 +745,224 @@ namespace degate {
      * @return Returns a shared pointer to a MemoryMap object.
      */
 
-    std::shared_ptr<MemoryMap<typename PixelPolicy::pixel_type> >
-    inline get_tile(unsigned int x, unsigned int y) {
+    inline MemoryMap_shptr get_tile(unsigned int x, unsigned int y) {
+      return get_tile(make_tile_key(x >> tile_width_exp, y >> tile_width_exp));
+    }
 
-      unsigned int tile_num_x = x >> tile_width_exp;
-      unsigned int tile_num_y = y >> tile_width_exp;
+    /**
+     * Get a pointer to the pixel data of the tile, that contains the
+     * absolute pixel coordinate \p x, \p y. The tile is pinned in the
+     * handle \p h. If the handle already refers to the tile, the pointer
+     * is returned without any lookup.
+     */
+    inline pixel_type * get_tile_data(unsigned int x, unsigned int y, TileHandle & h) {
+      tile_key_t key = make_tile_key(x >> tile_width_exp, y >> tile_width_exp);
+      if(h.data != NULL && h.key == key && h.cache_id == cache_id) return h.data;
+
+      h.pin = get_tile(key);
+      h.data = h.pin->get_data_ptr();
+      h.key = key;
+      h.cache_id = cache_id;
+      return h.data;
+    }
 
-      if(!(current_tile != NULL &&
-	   tile_num_x == curr_tile_num_x &&
-	   tile_num_y == curr_tile_num_y)) {
+    /**
+     * Get a pointer to the pixel data of a tile using the calling
+     * thread's handle for this cache.
+     * @see get_tile_data(unsigned int, unsigned int, TileHandle &)
+     */
+    inline pixel_type * get_tile_data(unsigned int x, unsigned int y) {
+      return get_tile_data(x, y, get_thread_handle(cache_id));
+    }
+
+    /**
+     * Get a pointer to the pixel data of a tile, that the caller is going
+     * to modify. The tile is marked as modified, so that a compressed
+     * tile is written back.
+     * @see get_tile_data(unsigned int, unsigned int)
+     */
+    inline pixel_type * get_writable_tile_data(unsigned int x, unsigned int y) {
+      TileHandle & h = get_thread_handle(cache_id);
+      pixel_type * data = get_tile_data(x, y, h);
+      h.pin->mark_dirty();
+      return data;
+    }
+
+    /**
+     * Queue the tiles of a region for prefetching in raster order. Call
+     * this method, before you read the region. The number of queued tiles
+     * is limited to a quarter of the cache size. Tiles beyond that are
+     * prefetched, as soon as the scan direction is detected.
+     * @param min_x Absolut pixel coordinate.
+     * @param max_x Absolut pixel coordinate. It is not part of the region.
+     * @param min_y Absolut pixel coordinate.
+     * @param max_y Absolut pixel coordinate. It is not part of the region.
+     */
+    void prefetch(unsigned int min_x, unsigned int max_x,
+		  unsigned int min_y, unsigned int max_y) {
+
+      TilePrefetcher & prefetcher = TilePrefetcher::get_instance();
+      if(!prefetcher.is_enabled() || min_x >= max_x || min_y >= max_y) return;
 
-	// create a file name from tile number
-	char filename[PATH_MAX];
-	snprintf(filename, sizeof(filename), "%d_%d.dat", tile_num_x, tile_num_y);
-	//debug(TM, "filename is: [%s]", filename);
+      size_t max_tiles = GlobalTileCache::get_instance().get_max_cache_memory() / get_image_size() / 4;
+      unsigned int x1 = std::min((max_x - 1) >> tile_width_exp, tiles_x - 1);
+      unsigned int y1 = std::min((max_y - 1) >> tile_width_exp, tiles_y - 1);
 
-	// if filename/ object is not in cache, load the tile
-	typename cache_type::const_iterator iter = cache.find(filename);
+      for(unsigned int y = min_y >> tile_width_exp; y <= y1; y++)
+	for(unsigned int x = min_x >> tile_width_exp; x <= x1; x++) {
+	  if(max_tiles-- == 0) return;
+	  prefetcher.request(this, make_tile_key(x, y));
+	}
+    }
 
-	if(iter == cache.end()) {
-	  //cleanup_cache();
-	  GlobalTileCache & gtc = GlobalTileCache::get_instance();
-	  bool ok = gtc.request_cache_memory(this, get_image_size());
-	  assert(ok == true);
-	  struct timespec now;
-	  GET_CLOCK(now);
+  protected:
 
-	  cache[filename] = std::make_pair(load(filename), now);
+    /**
+     * Remove a tile from the cache.
+     */
+    std::shared_ptr<void> evict_tile(tile_key_t key) {
+      boost::mutex::scoped_lock lock(mtx);
+      std::shared_ptr<void> tile;
+      typename cache_type::iterator iter = cache.find(key);
+      if(iter != cache.end()) {
+	tile = iter->second;
+	cache.erase(iter);
+      }
+      if(!prefetched.empty() && prefetched.erase(key) > 0)
+	GlobalTileCache::get_instance().record_prefetch_miss();
 #ifdef TILECACHE_DEBUG
-	  gtc.print_table();
+      debug(TM, "local cache: %d entries after remove\n", cache.size());
 #endif
-	}
+      return tile;
+    }
 
-	current_tile = cache[filename].first;
-	curr_tile_num_x = tile_num_x;
-	curr_tile_num_y = tile_num_y;
+    /**
+     * Load a tile on behalf of the TilePrefetcher.
+     */
+    void prefetch_tile(tile_key_t key) {
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	if(cache.find(key) != cache.end()) return;
+      }
 
+      MemoryMap_shptr mem = compressed != NULL ? load_compressed(key) : load(key);
+      mem->prefault();
+
+      bool inserted = false;
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	inserted = cache.insert(std::make_pair(key, mem)).second;
+	if(inserted) prefetched.insert(key);
       }
 
-      return current_tile;
+      if(inserted) {
+	GlobalTileCache & gtc = GlobalTileCache::get_instance();
+	gtc.insert_tile(this, key, get_image_size());
+	gtc.record_prefetch();
+      }
     }
 
-  protected:
+
+  private:
 
     /**
-     * Remove the oldest entry from the cache.
+     * Get the handle, that the calling thread uses for a TileCache object.
+     * Each thread has a small table of handles per pixel type, that is
+     * indexed by the cache id. Loops, that alternate between a few images,
+     * e.g. a source and a destination image, use different slots then.
+     * A handle identifies its cache via the cache id.
      */
-    void cleanup_cache() {
+    static TileHandle & get_thread_handle(uint64_t id) {
+      static thread_local TileHandle handles[thread_handle_slots];
+      return handles[id % thread_handle_slots];
+    }
 
-      if(cache.size() == 0) return;
+    /**
+     * Queue the tiles ahead of the scan direction, if the lookup of tile
+     * \p key continues a horizontal or vertical scan.
+     * @param miss If true, the tile was not in the cache. The prefetcher
+     *   is behind then and all tiles up to the prefetch distance are
+     *   requested. Otherwise only the tile at the prefetch distance is.
+     */
+    void predict(tile_key_t key, bool miss) {
+
+      tile_key_t prev = last_key.exchange(key);
+      if(prev == key) return;
+
+      int dx = get_tile_num_x(key) - get_tile_num_x(prev);
+      int dy = get_tile_num_y(key) - get_tile_num_y(prev);
+      if(abs(dx) + abs(dy) != 1) return;
+
+      TilePrefetcher & prefetcher = TilePrefetcher::get_instance();
+      for(unsigned int i = miss ? 1 : prefetch_distance; i <= prefetch_distance; i++) {
+	unsigned int x = get_tile_num_x(key) + i * dx;
+	unsigned int y = get_tile_num_y(key) + i * dy;
+	// Negative coordinates wrap around and are out of range, too.
+	if(x >= tiles_x || y >= tiles_y) return;
+
+	tile_key_t next = make_tile_key(x, y);
+	bool cached;
+	{
+	  boost::mutex::scoped_lock lock(mtx);
+	  cached = cache.find(next) != cache.end();
+	}
+	if(!cached) prefetcher.request(this, next);
+      }
+    }
 
-      struct timespec oldest_clock_val;
-      GET_CLOCK(oldest_clock_val);
+    /**
+     * Look up a tile by its key and load it if necessary.
+     */
+    MemoryMap_shptr get_tile(tile_key_t key) {
 
-      typename cache_type::iterator oldest = cache.begin();
+      GlobalTileCache & gtc = GlobalTileCache::get_instance();
+      MemoryMap_shptr mem;
+      bool was_prefetched = false;
+
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	typename cache_type::const_iterator iter = cache.find(key);
+	if(iter != cache.end()) {
+	  mem = iter->second;
+	  was_prefetched = !prefetched.empty() && prefetched.erase(key) > 0;
+	}
+      }
 
-      for(typename cache_type::iterator iter = cache.begin();
-	  iter != cache.end(); ++iter) {
+      if(mem != NULL) {
+	gtc.record_hit();
+	if(was_prefetched) gtc.record_prefetch_hit();
+	gtc.touch_tile(this, key);
+	if(TilePrefetcher::get_instance().is_enabled()) predict(key, false);
+	return mem;
+      }
 
-	struct timespec clock_val = (*iter).second.second;
-	if(clock_val < oldest_clock_val) {
-	  oldest_clock_val.tv_sec = clock_val.tv_sec;
-	  oldest_clock_val.tv_nsec = clock_val.tv_nsec;
-	  oldest = iter;
-	}
+      if(TilePrefetcher::get_instance().is_enabled()) predict(key, true);
+
+      // The tile is loaded without holding the lock. If another thread
+      // loaded the same tile in the meantime, we drop our mapping.
+      gtc.record_miss();
+      mem = compressed != NULL ? load_compressed(key) : load(key);
+
+      bool inserted = false;
+      {
+	boost::mutex::scoped_lock lock(mtx);
+	std::pair<typename cache_type::iterator, bool> r =
+	  cache.insert(std::make_pair(key, mem));
+	mem = r.first->second;
+	inserted = r.second;
+	// The prefetcher was a bit late.
+	was_prefetched = !inserted && prefetched.erase(key) > 0;
       }
 
-      assert(oldest != cache.end());
-      (*oldest).second.first.reset(); // explicit reset of smart pointer
-      cache.erase(oldest);
+      if(inserted) gtc.insert_tile(this, key, get_image_size());
+      if(was_prefetched) gtc.record_prefetch_hit();
+
 #ifdef TILECACHE_DEBUG
-      debug(TM, "local cache: %d entries after remove\n", cache.size());
+      gtc.print_table();
 #endif
-      GlobalTileCache & gtc = GlobalTileCache::get_instance();
-      gtc.release_cache_memory(this, get_image_size());
-
+      return mem;
     }
 
-
-  private:
-
     /**
      * Get image size in bytes.
      */
@@ -398,24 +970,100 @@ namespace degate {
       return sizeof(typename PixelPolicy::pixel_type) * (1<< tile_width_exp) * (1<< tile_width_exp);
     }
 
+    /**
+     * Get the name of a tile's file relative to the \p directory.
+     */
+    std::string get_tile_filename(tile_key_t key) const {
+      char filename[PATH_MAX];
+      snprintf(filename, sizeof(filename),
+	       tile_storage == MAP_STORAGE_TYPE_COMPRESSED_FILE ? "%d_%d.dtz" : "%d_%d.dat",
+	       get_tile_num_x(key), get_tile_num_y(key));
+      return filename;
+    }
+
     /**
      * Load a tile from an image file.
-     * @param filename Just the name of the file to load. The filename is
-     *     relative to the \p directory.
+     * @param key The tile to load. The filename is derived from the tile
+     *   number and is relative to the \p directory.
      */
-    std::shared_ptr<MemoryMap<typename PixelPolicy::pixel_type> >
-    load(std::string const& filename) const {
+    MemoryMap_shptr load(tile_key_t key) const {
+
+      if(pack != NULL) {
+	void * data = pack->get_tile_ptr(pack_level, get_tile_num_x(key), get_tile_num_y(key));
+	return MemoryMap_shptr(new MemoryMap<pixel_type>(1 << tile_width_exp,
+							 1 << tile_width_exp,
+							 static_cast<pixel_type *>(data),
+							 pack));
+      }
 
-      //debug(TM, "directory: [%s] file: [%s]", directory.c_str(), filename.c_str());
-      MemoryMap_shptr mem(new MemoryMap<typename PixelPolicy::pixel_type>
+      //debug(TM, "directory: [%s] file: [%s]", directory.c_str(), filename);
+      MemoryMap_shptr mem(new MemoryMap<pixel_type>
 			  (1 << tile_width_exp,
 			   1 << tile_width_exp,
 			   MAP_STORAGE_TYPE_PERSISTENT_FILE,
-			   join_pathes(directory, filename)));
+			   join_pathes(directory, get_tile_filename(key))));
 
       return mem;
     }
 
+    /**
+     * Load a compressed tile. If the tile is still in use, it is reused.
+     * If it is being written back, we wait for it.
+     */
+    MemoryMap_shptr load_compressed(tile_key_t key) const {
+
+      std::shared_ptr<compressed_tiles> c = compressed;
+      boost::mutex::scoped_lock lock(c->mtx);
+
+      for(;;) {
+	if(c->busy.find(key) == c->busy.end()) {
+	  typename std::map<tile_key_t, std::weak_ptr<MemoryMap<pixel_type> > >::iterator
+	    iter = c->live.find(key);
+	  if(iter == c->live.end()) break;
+
+	  MemoryMap_shptr mem = iter->second.lock();
+	  if(mem != NULL) return mem;
+	  // An expired entry is about to be written back.
+	}
+	c->cond.wait(lock);
+      }
+
+      c->busy.insert(key);
+      lock.unlock();
+
+      MemoryMap<pixel_type> * m = NULL;
+      try {
+	m = new MemoryMap<pixel_type>(1 << tile_width_exp,
+				      1 << tile_width_exp,
+				      MAP_STORAGE_TYPE_COMPRESSED_FILE,
+				      join_pathes(directory, get_tile_filename(key)));
+      }
+      catch(...) {
+	lock.lock();
+	c->busy.erase(key);
+	c->cond.notify_all();
+	throw;
+      }
+
+      // The deleter writes the tile back, when the last reference is gone.
+      MemoryMap_shptr mem(m, [c, key](MemoryMap<pixel_type> * p) {
+	  {
+	    boost::mutex::scoped_lock lock(c->mtx);
+	    c->live.erase(key);
+	    c->busy.insert(key);
+	  }
+	  delete p;
+	  boost::mutex::scoped_lock lock(c->mtx);
+	  c->busy.erase(key);
+	  c->cond.notify_all();
+	});
+
+      lock.lock();
+      c->live[key] = mem;
+      c->busy.erase(key);
+      c->cond.notify_all();
+      return mem;
+    }
 
   }; // end of class TileCache
 
@@ -0,0 +1,150 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <TileCompression.h>
+#include <FileSystem.h>
+#include <degate_exceptions.h>
+
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <boost/format.hpp>
+
+using namespace degate;
+
+/*
+ * File layout: A tile_header in host byte order, followed by the zlib
+ * stream of the prediction errors.
+ */
+struct tile_header {
+  char magic[4];
+  uint8_t version;
+  uint8_t pixel_size;
+  uint16_t reserved;
+  uint32_t width;
+  uint32_t height;
+  uint32_t compressed_size;
+};
+
+static const char tile_magic[4] = { 'D', 'T', 'Z', '1' };
+
+// zlib level 3 is about as fast as level 1, but compresses noticeably better.
+static const int compression_level = 3;
+
+
+bool degate::read_compressed_tile(std::string const& filename, void * data,
+				  unsigned int width, unsigned int height, size_t pixel_size) {
+
+  FILE * f = fopen(filename.c_str(), "rb");
+  if(f == NULL) return false;
+
+  tile_header header;
+  std::vector<Bytef> compressed;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+    memcmp(header.magic, tile_magic, sizeof(tile_magic)) == 0 &&
+    header.pixel_size == pixel_size &&
+    header.width == width &&
+    header.height == height;
+
+  const size_t row_size = width * pixel_size;
+
+  // A corrupted size field must not cause a huge allocation.
+  ok = ok && header.compressed_size > 0 &&
+    header.compressed_size <= compressBound(row_size * height);
+
+  if(ok) {
+    compressed.resize(header.compressed_size);
+    ok = fread(&compressed[0], 1, compressed.size(), f) == compressed.size();
+  }
+  fclose(f);
+
+  uLongf size = row_size * height;
+  uint8_t * p = static_cast<uint8_t *>(data);
+
+  if(!ok || uncompress(p, &size, &compressed[0], compressed.size()) != Z_OK ||
+     size != row_size * height) {
+    boost::format fmter("Error in read_compressed_tile(): The file %1% is corrupted.");
+    fmter % filename;
+    throw InvalidFileFormatException(fmter.str());
+  }
+
+  // Undo the prediction.
+  for(unsigned int y = 0; y < height; y++) {
+    uint8_t * row = p + y * row_size;
+    if(y > 0)
+      for(size_t i = 0; i < pixel_size; i++) row[i] += row[i - row_size];
+    for(size_t i = pixel_size; i < row_size; i++) row[i] += row[i - pixel_size];
+  }
+
+  return true;
+}
+
+
+void degate::write_compressed_tile(std::string const& filename, void const * data,
+				   unsigned int width, unsigned int height, size_t pixel_size) {
+
+  const size_t row_size = width * pixel_size;
+  uint8_t const * p = static_cast<uint8_t const *>(data);
+
+  // Replace each byte by its prediction error.
+  std::vector<uint8_t> residuals(row_size * height);
+  for(unsigned int y = 0; y < height; y++) {
+    uint8_t const * row = p + y * row_size;
+    uint8_t * out = &residuals[y * row_size];
+    for(size_t i = 0; i < pixel_size; i++) out[i] = y > 0 ? row[i] - row[i - row_size] : row[i];
+    for(size_t i = pixel_size; i < row_size; i++) out[i] = row[i] - row[i - pixel_size];
+  }
+
+  uLongf compressed_size = compressBound(residuals.size());
+  std::vector<Bytef> compressed(compressed_size);
+  if(compress2(&compressed[0], &compressed_size,
+	       &residuals[0], residuals.size(), compression_level) != Z_OK)
+    throw DegateRuntimeException("Error in write_compressed_tile(): compression failed.");
+
+  tile_header header;
+  memcpy(header.magic, tile_magic, sizeof(tile_magic));
+  header.version = 1;
+  header.pixel_size = pixel_size;
+  header.reserved = 0;
+  header.width = width;
+  header.height = height;
+  header.compressed_size = compressed_size;
+
+  // Write into a temporary file first, so that a crash never leaves a
+  // partially written tile behind.
+  std::string tmp_filename = filename + ".tmp";
+  FILE * f = fopen(tmp_filename.c_str(), "wb");
+  bool ok = f != NULL &&
+    fwrite(&header, sizeof(header), 1, f) == 1 &&
+    fwrite(&compressed[0], 1, compressed_size, f) == compressed_size;
+  if(f != NULL && fclose(f) != 0) ok = false;
+
+  if(!ok) {
+    boost::format fmter("Error in write_compressed_tile(): Cannot write file %1%.");
+    fmter % tmp_filename;
+    throw FileSystemException(fmter.str());
+  }
+
+  rename_file(tmp_filename, filename);
+}
+
@@ -0,0 +1,59 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TILECOMPRESSION_H__
+#define __TILECOMPRESSION_H__
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace degate {
+
+  /*
+   * Compressed tile files store a block of pixels losslessly. Each byte
+   * is predicted from the same byte of the left neighbour pixel (the
+   * upper pixel for the first column), like the PNG "sub" filter. The
+   * prediction errors are compressed with zlib.
+   */
+
+  /**
+   * Read a compressed tile file into a buffer of width * height pixels.
+   * @return Returns false, if the file does not exist. The buffer is not
+   *   modified in that case.
+   * @exception InvalidFileFormatException This exception is thrown, if the
+   *   file is corrupted or has a different geometry.
+   */
+  bool read_compressed_tile(std::string const& filename, void * data,
+			    unsigned int width, unsigned int height, size_t pixel_size);
+
+  /**
+   * Write a buffer of width * height pixels into a compressed tile file.
+   * The file is replaced atomically.
+   * @exception FileSystemException This exception is thrown, if the file
+   *   cannot be written.
+   */
+  void write_compressed_tile(std::string const& filename, void const * data,
+			     unsigned int width, unsigned int height, size_t pixel_size);
+
+}
+
+#endif
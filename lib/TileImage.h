@@ -55,11 +55,32 @@ namespace degate {
     // The place where we store the image data.
     const std::string directory;
 
+    // The pack file, if tiles are stored in a pack file.
+    const TilePackFile_shptr pack;
+    const unsigned int pack_level;
+
     // A helper class to load tiles.
     mutable TileCache<PixelPolicy> tile_cache;
 
   private:
 
+    /**
+     * Open the pack file of an image directory. The directory is created,
+     * if it does not exist.
+     * @return Returns a NULL pointer, if the image does not use a pack file.
+     */
+    static TilePackFile_shptr open_pack_file(unsigned int width, unsigned int height,
+					     std::string const& directory,
+					     bool persistent,
+					     unsigned int tile_width_exp,
+					     MAP_STORAGE_TYPE tile_storage) {
+
+      if(!persistent || tile_storage != MAP_STORAGE_TYPE_PACK_FILE) return TilePackFile_shptr();
+      if(!file_exists(directory)) create_directory(directory);
+      return TilePackFile_shptr(new TilePackFile(join_pathes(directory, "tiles.pack"),
+						 width, height, tile_width_exp,
+						 sizeof(typename PixelPolicy::pixel_type)));
+    }
 
     /**
      * Get the minimum width or height of an tile based image, that
@@ -98,21 +119,55 @@ namespace degate {
      *      value is specified as an exponent to the base 2. This means for
      *      example that if you want to use a width of 1024 pixel, you have
      *      to give a value of 10, because 2^10 is 1024.
+     * @param _tile_storage The file format of the tiles. Use
+     *      MAP_STORAGE_TYPE_COMPRESSED_FILE for compressed tiles or
+     *      MAP_STORAGE_TYPE_PACK_FILE to store the tiles of the image and
+     *      its prescaled images in a single file. Images, that are not
+     *      persistent, always use raw tile files.
      */
     StoragePolicy_Tile(unsigned int _width, unsigned int _height,
 		       std::string const& _directory,
 		       bool _persistent = false,
-		       unsigned int _tile_width_exp = 10) :
+		       unsigned int _tile_width_exp = 10,
+		       MAP_STORAGE_TYPE _tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE) :
       persistent(_persistent),
       tile_width_exp(_tile_width_exp),
       offset_bitmask((1 << _tile_width_exp) - 1),
       directory(_directory),
-      tile_cache(_directory, _tile_width_exp, _persistent) {
+      pack(open_pack_file(_width, _height, _directory, _persistent, _tile_width_exp, _tile_storage)),
+      pack_level(0),
+      tile_cache(_width, _height, _directory, _tile_width_exp, _persistent,
+		 _persistent ? _tile_storage : MAP_STORAGE_TYPE_PERSISTENT_FILE,
+		 pack, 0) {
 
       if(!file_exists(_directory)) create_directory(_directory);
 
     }
 
+    /**
+     * The constructor for a downscaled level of a pack file based image.
+     * The image is persistent.
+     *
+     * @param _width The width of the level.
+     * @param _height The height of the level.
+     * @param _pack The pack file.
+     * @param _level The level within the pack file. Level 0 is the
+     *      image itself.
+     */
+    StoragePolicy_Tile(unsigned int _width, unsigned int _height,
+		       TilePackFile_shptr _pack,
+		       unsigned int _level) :
+      persistent(true),
+      tile_width_exp(_pack->get_tile_width_exp()),
+      offset_bitmask((1 << _pack->get_tile_width_exp()) - 1),
+      directory(get_basedir(_pack->get_filename())),
+      pack(_pack),
+      pack_level(_level),
+      tile_cache(_width, _height, directory, tile_width_exp, true,
+		 MAP_STORAGE_TYPE_PACK_FILE, _pack, _level) {
+
+    }
+
     /**
      * The destructor.
      */
@@ -140,6 +195,32 @@ namespace degate {
      */
     bool is_persistent() const { return persistent; }
 
+    /**
+     * Get the file format of the tiles.
+     */
+    MAP_STORAGE_TYPE get_tile_storage() const { return tile_cache.get_tile_storage(); }
+
+    /**
+     * Get the exponent (to base 2) of the tile width.
+     */
+    unsigned int get_tile_width_exp() const { return tile_width_exp; }
+
+    /**
+     * Get the pack file of the image.
+     * @return Returns a NULL pointer, if the tiles are not stored in a pack file.
+     */
+    TilePackFile_shptr get_pack_file() const { return pack; }
+
+    /**
+     * Get the level of the image within its pack file.
+     */
+    unsigned int get_pack_level() const { return pack_level; }
+
+    /**
+     * Write modified tiles back into their files.
+     */
+    void sync() { tile_cache.sync(); }
+
 
     inline typename PixelPolicy::pixel_type get_pixel(unsigned int x, unsigned int y) const;
 
@@ -153,6 +234,39 @@ namespace degate {
       mem->raw_copy(dst_buf);
     }
 
+    /**
+     * Load the tiles of a region in background threads.
+     * @see TileCache::prefetch()
+     */
+    void prefetch(unsigned int min_x, unsigned int max_x,
+		  unsigned int min_y, unsigned int max_y) const {
+      tile_cache.prefetch(min_x, max_x, min_y, max_y);
+    }
+
+    /**
+     * Get a view on the tile, that contains the pixel \p x, \p y.
+     */
+    void get_tile_view(unsigned int x, unsigned int y,
+		       TileView<typename PixelPolicy::pixel_type> & view) const {
+      MemoryMap_shptr mem = tile_cache.get_tile(x, y);
+      view.data = mem->get_data_ptr();
+      view.pin = mem;
+      view.stride = get_tile_size();
+      view.min_x = x & ~offset_bitmask;
+      view.min_y = y & ~offset_bitmask;
+      view.width = view.height = get_tile_size();
+    }
+
+    /**
+     * Get a view on the tile, that contains the pixel \p x, \p y, in
+     * order to modify it. The tile is marked as modified.
+     */
+    void get_writable_tile_view(unsigned int x, unsigned int y,
+				TileView<typename PixelPolicy::pixel_type> & view) {
+      get_tile_view(x, y, view);
+      std::static_pointer_cast<MemoryMap<typename PixelPolicy::pixel_type> >(view.pin)->mark_dirty();
+    }
+
 
   };
 
@@ -160,8 +274,8 @@ namespace degate {
   inline typename PixelPolicy::pixel_type
   StoragePolicy_Tile<PixelPolicy>::get_pixel(unsigned int x,
 					     unsigned int y) const {
-    MemoryMap_shptr mem = tile_cache.get_tile(x, y);
-    return mem->get(x & offset_bitmask, y & offset_bitmask);
+    typename PixelPolicy::pixel_type * tile = tile_cache.get_tile_data(x, y);
+    return tile[((y & offset_bitmask) << tile_width_exp) + (x & offset_bitmask)];
   }
 
   template<class PixelPolicy>
@@ -169,8 +283,8 @@ namespace degate {
   StoragePolicy_Tile<PixelPolicy>::set_pixel(unsigned int x, unsigned int y,
 					     typename PixelPolicy::pixel_type new_val) {
 
-    MemoryMap_shptr mem = tile_cache.get_tile(x, y);
-    mem->set(x & offset_bitmask, y & offset_bitmask, new_val);
+    typename PixelPolicy::pixel_type * tile = tile_cache.get_writable_tile_data(x, y);
+    tile[((y & offset_bitmask) << tile_width_exp) + (x & offset_bitmask)] = new_val;
   }
 
 
@@ -0,0 +1,156 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <TilePackFile.h>
+#include <degate_exceptions.h>
+#include <globals.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+using namespace degate;
+
+static const char pack_magic[4] = { 'D', 'T', 'P', 'K' };
+
+// Tiles start at this offset. Keeps the tiles page aligned.
+static const size_t data_offset = 4096;
+
+
+TilePackFile::TilePackFile(std::string const& _filename,
+			   unsigned int width, unsigned int height,
+			   unsigned int tile_width_exp, size_t pixel_size) :
+  filename(_filename),
+  fd(-1),
+  filesize(0),
+  tile_size_bytes(pixel_size << (2 * tile_width_exp)),
+  mem(NULL),
+  hdr(NULL) {
+
+  static_assert(sizeof(header) <= data_offset, "pack file header exceeds data offset");
+
+  // Calculate the expected index.
+  header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, pack_magic, sizeof(pack_magic));
+  h.version = 1;
+  h.tile_width_exp = tile_width_exp;
+  h.pixel_size = pixel_size;
+  h.width = width;
+  h.height = height;
+
+  uint64_t tiles = 0;
+  const unsigned int tile_size = 1 << tile_width_exp;
+  for(unsigned int l = 0; l < max_levels && (l == 0 || (width >> l) > 0 || (height >> l) > 0); l++) {
+    unsigned int w = std::max(width >> l, 1U), h_l = std::max(height >> l, 1U);
+    h.level[l].first_tile = tiles;
+    h.level[l].tiles_x = (w + tile_size - 1) / tile_size;
+    h.level[l].tiles_y = (h_l + tile_size - 1) / tile_size;
+    tiles += (uint64_t)h.level[l].tiles_x * h.level[l].tiles_y;
+    h.levels = l + 1;
+  }
+
+  filesize = data_offset + tiles * tile_size_bytes;
+
+  if((fd = open(filename.c_str(), O_RDWR | O_CREAT, 0600)) == -1) {
+    boost::format fmter("Error in TilePackFile(): Cannot open file %1%.");
+    fmter % filename;
+    throw FileSystemException(fmter.str());
+  }
+
+  struct stat st;
+  bool created = fstat(fd, &st) == 0 && st.st_size == 0;
+
+  if(created) {
+    // The file is sparse. Unwritten tiles read as zero.
+    if(ftruncate(fd, filesize) != 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+      close(fd);
+      boost::format fmter("Error in TilePackFile(): Cannot create file %1%.");
+      fmter % filename;
+      throw FileSystemException(fmter.str());
+    }
+  }
+  else {
+    header existing;
+    if(pread(fd, &existing, sizeof(existing), 0) != sizeof(existing) ||
+       memcmp(&existing, &h, offsetof(header, level)) != 0 ||
+       (size_t)st.st_size < filesize) {
+      close(fd);
+      boost::format fmter("Error in TilePackFile(): The file %1% is not a pack file for this image.");
+      fmter % filename;
+      throw InvalidFileFormatException(fmter.str());
+    }
+  }
+
+  if((mem = (uint8_t *) mmap(NULL, filesize, PROT_READ | PROT_WRITE,
+			     MAP_FILE | MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    close(fd);
+    boost::format fmter("Error in TilePackFile(): Cannot map file %1%.");
+    fmter % filename;
+    throw FileSystemException(fmter.str());
+  }
+
+  hdr = reinterpret_cast<header *>(mem);
+}
+
+
+TilePackFile::~TilePackFile() {
+  sync();
+  if(munmap(mem, filesize) == -1) perror("munmap failed");
+  close(fd);
+}
+
+
+void * TilePackFile::get_tile_ptr(unsigned int level, unsigned int tile_x, unsigned int tile_y) const {
+  if(level >= hdr->levels ||
+     tile_x >= hdr->level[level].tiles_x ||
+     tile_y >= hdr->level[level].tiles_y) {
+    boost::format fmter("Error in get_tile_ptr(): There is no tile %1%/%2% in level %3%.");
+    fmter % tile_x % tile_y % level;
+    throw DegateLogicException(fmter.str());
+  }
+
+  level_entry const& l = hdr->level[level];
+  uint64_t tile = l.first_tile + (uint64_t)tile_y * l.tiles_x + tile_x;
+  return mem + data_offset + tile * tile_size_bytes;
+}
+
+
+bool TilePackFile::is_level_valid(unsigned int level) const {
+  return level < hdr->levels && hdr->level[level].valid != 0;
+}
+
+
+void TilePackFile::set_level_valid(unsigned int level, bool valid) {
+  if(level < hdr->levels) hdr->level[level].valid = valid ? 1 : 0;
+}
+
+
+void TilePackFile::sync() {
+  if(msync(mem, filesize, MS_SYNC) == -1) perror("msync() failed");
+}
@@ -0,0 +1,142 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TILEPACKFILE_H__
+#define __TILEPACKFILE_H__
+
+#include <string>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/utility.hpp>
+
+namespace degate {
+
+  /**
+   * A single file, that stores the tiles of an image and of all its
+   * downscaled versions. Level 0 is the image itself, level n has the
+   * size width >> n, height >> n. Levels are added until the image is
+   * reduced to a single pixel.
+   *
+   * The file starts with an index header. The tiles follow at fixed
+   * offsets. The whole file is mapped into memory with a single mmap().
+   * The file is created as a sparse file, so tiles, that were never
+   * written, do not occupy disk space.
+   */
+  class TilePackFile : boost::noncopyable {
+
+  public:
+
+    /** Maximum number of levels. */
+    static const unsigned int max_levels = 32;
+
+  private:
+
+    struct level_entry {
+      uint64_t first_tile;
+      uint32_t tiles_x, tiles_y;
+      uint32_t valid;
+      uint32_t reserved;
+    };
+
+    struct header {
+      char magic[4];
+      uint32_t version;
+      uint32_t tile_width_exp;
+      uint32_t pixel_size;
+      uint32_t width;
+      uint32_t height;
+      uint32_t levels;
+      uint32_t reserved;
+      level_entry level[max_levels];
+    };
+
+    const std::string filename;
+    int fd;
+    size_t filesize;
+    size_t tile_size_bytes;
+    uint8_t * mem;
+    header * hdr;
+
+  public:
+
+    /**
+     * Open a pack file. If the file does not exist, it is created.
+     * @param filename The pack file.
+     * @param width The width of level 0.
+     * @param height The height of level 0.
+     * @param tile_width_exp The width (and height) of a tile as exponent to base 2.
+     * @param pixel_size The size of a pixel in bytes.
+     * @exception FileSystemException This exception is thrown, if the file
+     *   cannot be created or mapped.
+     * @exception InvalidFileFormatException This exception is thrown, if the
+     *   file exists, but is not a pack file for the given geometry.
+     */
+    TilePackFile(std::string const& filename,
+		 unsigned int width, unsigned int height,
+		 unsigned int tile_width_exp, size_t pixel_size);
+
+    /**
+     * Write back and unmap the file.
+     */
+    ~TilePackFile();
+
+    std::string const& get_filename() const { return filename; }
+
+    /**
+     * Get the width (and height) of a tile as exponent to base 2.
+     */
+    unsigned int get_tile_width_exp() const { return hdr->tile_width_exp; }
+
+    /**
+     * Get the number of levels in the file.
+     */
+    unsigned int get_num_levels() const { return hdr->levels; }
+
+    /**
+     * Get a pointer to the pixel data of a tile. The tile is stored
+     * row by row. The pointer is valid as long as the object exists.
+     * @exception DegateLogicException This exception is thrown, if the
+     *   tile is not part of the file.
+     */
+    void * get_tile_ptr(unsigned int level, unsigned int tile_x, unsigned int tile_y) const;
+
+    /**
+     * Check, if a level was completely calculated.
+     */
+    bool is_level_valid(unsigned int level) const;
+
+    /**
+     * Mark a level as completely calculated or not.
+     */
+    void set_level_valid(unsigned int level, bool valid);
+
+    /**
+     * Write modified tiles back to disk.
+     */
+    void sync();
+  };
+
+  typedef std::shared_ptr<TilePackFile> TilePackFile_shptr;
+
+}
+
+#endif
@@ -24,7 +24,12 @@
 #include <MedianFilter.h>
 #include <EdgeDetection.h>
 #include <LogicModelHelper.h>
+#include <IntegralImage.h>
+#include <PixelKernels.h>
+#include <Configuration.h>
+#include <WorkerThreads.h>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 using namespace degate;
 
@@ -82,6 +87,8 @@ void ViaMatching::run() {
 
   if(via_diameter == 0) throw DegateLogicException("Parameter via diameter was not set.");
 
+  matches.clear();
+
   unsigned int max_r = 0;
 
   // lists for images of vias on the current layer
@@ -164,32 +171,69 @@ void ViaMatching::run() {
   if(substeps > 0) set_progress_step_size(1.0/( substeps * (bounding_box.get_height()-max_r*2) ));
 
   // run via matching
-  if(via_up_gs) scan(bounding_box, img, via_up_gs, Via::DIRECTION_UP);
-  if(via_down_gs) scan(bounding_box, img, via_down_gs, Via::DIRECTION_DOWN);
+  if(via_up_gs || via_down_gs) prepare_background();
+  if(via_up_gs) scan(bounding_box, via_up_gs, Via::DIRECTION_UP);
+  if(via_down_gs) scan(bounding_box, via_down_gs, Via::DIRECTION_DOWN);
 
 }
 
-template<class BGImageType, class TemplateImageType>
-double calc_xcorr(unsigned int start_x, unsigned int start_y,
-		  std::shared_ptr<BGImageType> bg_img, double f_avg, double sigma_f,
-		  std::shared_ptr<TemplateImageType> tmpl_img, double t_avg, double sigma_t) {
+void ViaMatching::prepare_background() {
 
-  double sum = 0;
-  double n = tmpl_img->get_width() * tmpl_img->get_height();
+  assert(bounding_box.get_min_x() >= 0);
+  assert(bounding_box.get_min_y() >= 0);
 
-  for(unsigned int y = 0; y < tmpl_img->get_height(); y++) {
-    for(unsigned int x = 0; x < tmpl_img->get_width(); x++) {
-      double f_xy = bg_img->template get_pixel_as<double>(start_x + x, start_y + y);
-      double t_xy = tmpl_img->template get_pixel_as<double>(x, y);
-      
-      sum += (f_xy - f_avg) * (t_xy - t_avg) / (sigma_f * sigma_t); // extract commons
-    }
-  }
+  unsigned int
+    w = bounding_box.get_width(),
+    h = bounding_box.get_height();
+
+  gs_img = TileImage_GS_BYTE_shptr(new TileImage_GS_BYTE(w, h));
+  sum_table_single = TileImage_SUM_UINT32_shptr(new TileImage_SUM_UINT32(w, h));
+  sum_table_squared = TileImage_SUM_INT64_shptr(new TileImage_SUM_INT64(w, h));
+
+  TileImage_GS_BYTE_shptr cached =
+    layer->get_scaling_manager()->get_greyscale_cache()->get_gs_byte_image(1, bounding_box);
+
+  extract_partial_image(gs_img, cached, bounding_box);
+  build_integral_images(sum_table_single, sum_table_squared, gs_img);
+}
+
+double ViaMatching::calc_xcorr(unsigned int x, unsigned int y,
+			       MemoryImage_GS_BYTE_shptr tmpl_img,
+			       double t_avg, double sigma_t) const {
+
+  const unsigned int
+    tmpl_w = tmpl_img->get_width(),
+    tmpl_h = tmpl_img->get_height(),
+    local_x = x - bounding_box.get_min_x(),
+    local_y = y - bounding_box.get_min_y();
+
+  const double n = tmpl_w * tmpl_h;
 
-  sum *= 1/(n - 1);
+  // Mean and standard deviation of the background window.
+  double s1, s2;
+  get_region_sums(sum_table_single, sum_table_squared,
+		  local_x, local_y, tmpl_w, tmpl_h, s1, s2);
 
+  const double variance_f = (s2 - s1 * s1 / n) / n;
+  if(variance_f <= 0) return -1.0; // A flat window does not correlate.
 
-  return sum;
+  // sum((f - f_avg) * (t - t_avg)) = sum(f * t) - t_avg * sum(f)
+  TileView<gs_byte_pixel_t> tmpl_view, view;
+  tmpl_img->get_tile_view(0, 0, tmpl_view);
+
+  uint64_t sum_ft = 0, sum_f;
+  for(unsigned int _y = 0; _y < tmpl_h; _y++) {
+    gs_byte_pixel_t const * t = tmpl_view.get_ptr(0, _y);
+
+    for(unsigned int _x = local_x; _x < local_x + tmpl_w; ) {
+      gs_img->get_tile_view(_x, local_y + _y, view);
+      unsigned int len = std::min(local_x + tmpl_w, view.get_max_x()) - _x;
+      sum_ft += dot_product_gs_byte(view.get_ptr(_x, local_y + _y), t + (_x - local_x), len, &sum_f);
+      _x += len;
+    }
+  }
+
+  return ((double)sum_ft - t_avg * s1) / (sqrt(variance_f) * sigma_t * (n - 1));
 }
 
 
@@ -218,18 +262,20 @@ bool ViaMatching::add_via(unsigned int x, unsigned int y,
   return false;
 }
 
-void ViaMatching::scan(BoundingBox const& bbox, BackgroundImage_shptr bg_img,
+void ViaMatching::scan(BoundingBox const& bbox,
 		       MemoryImage_GS_BYTE_shptr tmpl_img, Via::DIRECTION direction) {
 
-  std::list<match_found> matches;
-  
   debug(TM, "run scanning");
-  double f_avg, sigma_f;
   double t_avg, sigma_t;
   average_and_stddev(tmpl_img, 0, 0, 
 		     tmpl_img->get_width(), tmpl_img->get_height(), 
 		     &t_avg, &sigma_t);
 
+  if(sigma_t == 0) {
+    debug(TM, "via template is flat, there is nothing to match");
+    return;
+  }
+
   assert(bbox.get_max_x() >= 0);
   assert(bbox.get_max_y() >= 0);
 
@@ -238,16 +284,63 @@ void ViaMatching::scan(BoundingBox const& bbox, BackgroundImage_shptr bg_img,
   int max_y = static_cast<unsigned int>(bbox.get_max_y()) > tmpl_img->get_height() ? 
     bbox.get_max_y() - tmpl_img->get_height() : bbox.get_min_y();
 
-  for(int y = bbox.get_min_y(); y < max_y; y++) {
-    for(int x = bbox.get_min_x(); x < max_x; x++) {
+  // Split the rows into bands. There are more bands than threads, so
+  // that the load is balanced.
+  const unsigned int band_rows = 16;
+
+  std::vector<scan_band> bands;
+  for(int y = bbox.get_min_y(); y < max_y; y += band_rows) {
+    scan_band b;
+    b.min_x = bbox.get_min_x();
+    b.max_x = max_x;
+    b.min_y = y;
+    b.max_y = std::min(y + (int)band_rows, max_y);
+    bands.push_back(b);
+  }
 
-      average_and_stddev(bg_img, x, y, 
-			 tmpl_img->get_width(), tmpl_img->get_height(), 
-			 &f_avg, &sigma_f);
+  try {
+    run_parallel_for(Configuration::get_instance().get_max_worker_threads(), bands.size(),
+		     boost::bind(&ViaMatching::scan_band_for_vias, this,
+				 boost::ref(bands), tmpl_img, t_avg, sigma_t, _1));
+  }
+  catch(...) {
+    reset_progress();
+    throw;
+  }
 
-      double xcorr = calc_xcorr(x, y,
-				bg_img, f_avg, sigma_f,
-				tmpl_img, t_avg, sigma_t);
+  // check if scanning was canceled
+  if(is_canceled()) {
+    reset_progress();
+    return;
+  }
+
+  // Merge the matches in scan order. The sort is stable, therefore the
+  // result does not depend on the number of threads.
+  std::list<match_found> found;
+  BOOST_FOREACH(scan_band & b, bands) {
+    found.splice(found.end(), b.matches);
+  }
+
+  found.sort(compare_correlation);
+  BOOST_FOREACH(match_found const& m, found) {
+    add_via(m.x, m.y, via_diameter, direction, m.correlation, threshold_match);
+  }
+
+  matches.splice(matches.end(), found);
+
+}
+
+void ViaMatching::scan_band_for_vias(std::vector<scan_band> & bands,
+				     MemoryImage_GS_BYTE_shptr tmpl_img,
+				     double t_avg, double sigma_t,
+				     size_t i) {
+
+  scan_band & b = bands[i];
+
+  for(int y = b.min_y; y < b.max_y && !is_canceled(); y++) {
+    for(int x = b.min_x; x < b.max_x; x++) {
+
+      double xcorr = calc_xcorr(x, y, tmpl_img, t_avg, sigma_t);
 
       if(xcorr > threshold_match) {
 	match_found m;
@@ -255,26 +348,11 @@ void ViaMatching::scan(BoundingBox const& bbox, BackgroundImage_shptr bg_img,
 	m.y = y;
 	m.correlation = xcorr;
 
-	matches.push_back(m);
-	//debug(TM, "%d,%d -> %f sigma-f=%f sigma-t=%f f_avg=%f t_avg=%f", x, y, xcorr, sigma_f,sigma_t, f_avg, sigma_f);	
+	b.matches.push_back(m);
       }
     }
 
     // update progress
     progress_step_done();
-
-    // check if scanning was canceled
-    if(is_canceled()) {
-      reset_progress();
-      return;
-    }
-
   }
-
-  matches.sort(compare_correlation);
-  BOOST_FOREACH(match_found const& m, matches) {
-    add_via(m.x, m.y, via_diameter, direction, m.correlation, threshold_match);
-  }
-
 }
-
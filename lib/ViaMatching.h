@@ -42,6 +42,12 @@ namespace degate {
 
     BoundingBox bounding_box;
 
+    // Greyscaled background image for the bounding box and its
+    // summation tables.
+    TileImage_GS_BYTE_shptr gs_img;
+    TileImage_SUM_UINT32_shptr sum_table_single;
+    TileImage_SUM_INT64_shptr sum_table_squared;
+
   public:
 
     typedef struct {
@@ -49,6 +55,10 @@ namespace degate {
       double correlation; // the correlation value  
     } match_found;
 
+  private:
+
+    std::list<match_found> matches;
+
   public:
 
     ViaMatching();
@@ -77,10 +87,54 @@ namespace degate {
      */
     void set_diameter(unsigned int diameter);
 
+    /**
+     * Get the matches of the last run, sorted by correlation for each via
+     * direction. This includes matches, that were not inserted as vias,
+     * because they overlap a via with a higher correlation.
+     */
+    std::list<match_found> const& get_matches() const {
+      return matches;
+    }
+
   private:
-    void scan(BoundingBox const& bbox, BackgroundImage_shptr bg_img, 
+
+    /**
+     * A band of rows, that is scanned by a single thread.
+     */
+    struct scan_band {
+      int min_x, max_x, min_y, max_y; // absolut coordinates, max is exclusive
+      std::list<match_found> matches;
+    };
+
+    /**
+     * Create the greyscaled background image for the bounding box and
+     * calculate its summation tables.
+     */
+    void prepare_background();
+
+    /**
+     * Scan the bounding box for a via template. The rows are split into
+     * bands, that are scanned in parallel.
+     */
+    void scan(BoundingBox const& bbox,
 	      MemoryImage_GS_BYTE_shptr tmpl_img, Via::DIRECTION direction);
 
+    /**
+     * Scan a band for a via template.
+     */
+    void scan_band_for_vias(std::vector<scan_band> & bands,
+			    MemoryImage_GS_BYTE_shptr tmpl_img,
+			    double t_avg, double sigma_t,
+			    size_t i);
+
+    /**
+     * Calculate the correlation between the background image and the
+     * template at an absolut position.
+     */
+    double calc_xcorr(unsigned int x, unsigned int y,
+		      MemoryImage_GS_BYTE_shptr tmpl_img,
+		      double t_avg, double sigma_t) const;
+
     bool add_via(unsigned int x, unsigned int y,
 		 unsigned int diameter,
 		 Via::DIRECTION direction,
@@ -55,7 +55,7 @@ void WireMatching::init(BoundingBox const& bounding_box, Project_shptr project)
   ScalingManager_shptr sm = layer->get_scaling_manager();
   assert(sm != NULL);
 
-  img = sm->get_image(1).second;
+  img = sm->get_greyscale_cache()->get_gs_double_image(1, bounding_box);
   assert(img != NULL);
 }
 
@@ -36,7 +36,7 @@ namespace degate {
     LogicModel_shptr lmodel;
     unsigned int wire_diameter, median_filter_width;
     double sigma, min_edge_magnitude;
-    BackgroundImage_shptr img;
+    TileImage_GS_DOUBLE_shptr img;
 
     BoundingBox bounding_box;
 
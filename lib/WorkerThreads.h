@@ -0,0 +1,141 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __WORKERTHREADS_H__
+#define __WORKERTHREADS_H__
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+namespace degate {
+
+  /**
+   * Keeps the first exception, that is thrown in one of several threads.
+   */
+  class WorkerError {
+
+  private:
+
+    boost::mutex mtx;
+    std::exception_ptr error;
+
+  public:
+
+    /**
+     * Store the exception, that is currently handled. Call it from a catch block.
+     */
+    void capture() {
+      boost::mutex::scoped_lock lock(mtx);
+      if(!error) error = std::current_exception();
+    }
+
+    /**
+     * Rethrow the stored exception, if there is one.
+     */
+    void rethrow() {
+      boost::mutex::scoped_lock lock(mtx);
+      if(error) std::rethrow_exception(error);
+    }
+  };
+
+
+  /**
+   * Call a function in a worker thread and store its exception.
+   * This is a helper function for run_parallel().
+   */
+  template<typename Function>
+  void run_worker(Function const& fn, unsigned int thread, WorkerError & error) {
+    try {
+      fn(thread);
+    }
+    catch(...) {
+      error.capture();
+    }
+  }
+
+  /**
+   * Call fn(i) in a worker thread for each i in 0 .. num_threads - 1
+   * and wait until all threads are done. If workers throw exceptions,
+   * the first one is rethrown in the calling thread.
+   *
+   * A single worker is called from the calling thread.
+   */
+  template<typename Function>
+  void run_parallel(unsigned int num_threads, Function const& fn) {
+
+    if(num_threads == 0) return;
+    if(num_threads == 1) {
+      fn(0);
+      return;
+    }
+
+    WorkerError error;
+
+    boost::thread_group threads;
+    for(unsigned int i = 0; i < num_threads; i++)
+      threads.create_thread(boost::bind(&run_worker<Function>, boost::cref(fn), i,
+					boost::ref(error)));
+    threads.join_all();
+
+    error.rethrow();
+  }
+
+
+  /**
+   * Process the items of run_parallel_for() until none is left.
+   * This is a helper function for run_parallel_for().
+   */
+  template<typename Function>
+  void process_items(Function const& fn, size_t num_items, std::atomic<size_t> & next_item) {
+    try {
+      for(size_t i = next_item++; i < num_items; i = next_item++) fn(i);
+    }
+    catch(...) {
+      // The other workers do not start further items.
+      next_item = num_items;
+      throw;
+    }
+  }
+
+  /**
+   * Call fn(i) for each item i in 0 .. num_items - 1. The items are
+   * handed out one by one to at most \p num_threads worker threads,
+   * so that the load is balanced. If a call throws an exception, no
+   * further items are started and the first exception is rethrown in
+   * the calling thread.
+   */
+  template<typename Function>
+  void run_parallel_for(unsigned int num_threads, size_t num_items, Function const& fn) {
+
+    std::atomic<size_t> next_item(0);
+
+    run_parallel(std::min<size_t>(num_threads, num_items),
+		 boost::bind(&process_items<Function>, boost::cref(fn), num_items,
+			     boost::ref(next_item)));
+  }
+
+}
+
+#endif
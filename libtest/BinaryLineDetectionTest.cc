@@ -0,0 +1,84 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "BinaryLineDetectionTest.h"
+#include "BinaryLineDetection.h"
+#include "Image.h"
+
+#include "globals.h"
+#include <stdlib.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (BinaryLineDetectionTest);
+
+using namespace std;
+using namespace degate;
+
+/**
+ * Check, if two images have the same size and the same pixels.
+ */
+static bool equal_images(TileImage_GS_DOUBLE_shptr a, TileImage_GS_DOUBLE_shptr b) {
+
+  if(a == NULL || b == NULL ||
+     a->get_width() != b->get_width() ||
+     a->get_height() != b->get_height()) return false;
+
+  for(unsigned int y = 0; y < a->get_height(); y++)
+    for(unsigned int x = 0; x < a->get_width(); x++)
+      if(a->get_pixel(x, y) != b->get_pixel(x, y)) return false;
+
+  return true;
+}
+
+void BinaryLineDetectionTest::setUp(void) {
+}
+
+void BinaryLineDetectionTest::tearDown(void) {
+}
+
+void BinaryLineDetectionTest::test_tiled(void) {
+
+  const unsigned int w = 200, h = 150;
+  TileImage_GS_DOUBLE_shptr img(new TileImage_GS_DOUBLE(w, h));
+
+  // Horizontal wires on a noisy background.
+  srand(42);
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      img->set_pixel(x, y, (y % 20 < 6 ? 160 : 60) + rand() % 40);
+
+  // The second region is clipped by the input image.
+  const unsigned int regions[][4] = { { 10, 190, 20, 140 }, { 120, 260, 90, 190 } };
+
+  for(unsigned int i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+
+    BinaryLineDetection tiled(regions[i][0], regions[i][1], regions[i][2], regions[i][3], 6);
+    tiled.set_tiled(true);
+    TileImage_GS_DOUBLE_shptr tiled_bin = tiled.run(img, TileImage_GS_DOUBLE_shptr(), "");
+
+    BinaryLineDetection untiled(regions[i][0], regions[i][1], regions[i][2], regions[i][3], 6);
+    untiled.set_tiled(false);
+    TileImage_GS_DOUBLE_shptr untiled_bin = untiled.run(img, TileImage_GS_DOUBLE_shptr(), "");
+
+    CPPUNIT_ASSERT(equal_images(tiled.get_gray_image(), untiled.get_gray_image()));
+    CPPUNIT_ASSERT(equal_images(tiled_bin, untiled_bin));
+  }
+}
@@ -0,0 +1,145 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "FilterKernelTest.h"
+#include <Image.h>
+#include <FilterKernel.h>
+#include <ImageManipulation.h>
+
+#include <globals.h>
+#include <stdlib.h>
+#include <math.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (FilterKernelTest);
+
+using namespace std;
+using namespace degate;
+
+void FilterKernelTest::setUp(void) {
+  // The rows are convolved in parallel.
+  setenv("DEGATE_THREADS", "4", 1);
+}
+
+void FilterKernelTest::tearDown(void) {
+  unsetenv("DEGATE_THREADS");
+}
+
+/**
+ * Create a kernel, that is the sum of two outer products, whose
+ * vectors are not proportional.
+ */
+static FilterKernel_shptr create_rank_2_kernel(unsigned int columns, unsigned int rows) {
+
+  FilterKernel_shptr k(new FilterKernel(columns, rows));
+  for(unsigned int y = 0; y < rows; y++)
+    for(unsigned int x = 0; x < columns; x++)
+      k->set(x, y, (1.0 + x) * (2.0 - y) + (0.5 * x * x - 1.0) * (1.0 + y * y));
+  return k;
+}
+
+/**
+ * Create a kernel of random values. It is not separable.
+ */
+static FilterKernel_shptr create_random_kernel(unsigned int columns, unsigned int rows) {
+
+  FilterKernel_shptr k(new FilterKernel(columns, rows));
+  for(unsigned int y = 0; y < rows; y++)
+    for(unsigned int x = 0; x < columns; x++)
+      k->set(x, y, (rand() % 2001 - 1000) / 1000.0);
+  return k;
+}
+
+void FilterKernelTest::test_separable_terms(void) {
+
+  CPPUNIT_ASSERT(GaussianBlur(7, 7, 1.5).is_separable());
+  CPPUNIT_ASSERT(SobelXOperator().is_separable());
+  CPPUNIT_ASSERT(SobelYOperator().is_separable());
+  CPPUNIT_ASSERT(!SobelOperator().is_separable());
+  CPPUNIT_ASSERT(LoG(9, 9, 1.4).get_separable_terms().size() == 2);
+
+  srand(5);
+  std::vector<FilterKernel_shptr> kernels;
+  kernels.push_back(create_rank_2_kernel(5, 3));
+  kernels.push_back(create_rank_2_kernel(4, 6));
+  kernels.push_back(create_random_kernel(6, 4));
+
+  const size_t ranks[] = { 2, 2, 4 };
+
+  for(size_t n = 0; n < kernels.size(); n++) {
+
+    FilterKernel_shptr k = kernels[n];
+    std::vector<FilterKernel::separable_term> terms = k->get_separable_terms();
+    CPPUNIT_ASSERT(terms.size() == ranks[n]);
+
+    // The terms add up to the kernel.
+    for(unsigned int y = 0; y < k->get_rows(); y++)
+      for(unsigned int x = 0; x < k->get_columns(); x++) {
+	double sum = 0;
+	for(size_t t = 0; t < terms.size(); t++) sum += terms[t].column[y] * terms[t].row[x];
+	CPPUNIT_ASSERT(fabs(sum - k->get(x, y)) < 1e-9);
+      }
+  }
+}
+
+void FilterKernelTest::test_separable_convolution(void) {
+
+  const unsigned int w = 120, h = 90;
+  TileImage_GS_DOUBLE_shptr in(new TileImage_GS_DOUBLE(w, h));
+  srand(23);
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      in->set_pixel(x, y, rand() % 256);
+
+  std::vector<FilterKernel_shptr> kernels;
+  kernels.push_back(FilterKernel_shptr(new GaussianBlur(10, 10, 2)));
+  kernels.push_back(FilterKernel_shptr(new SobelXOperator()));
+  kernels.push_back(FilterKernel_shptr(new SobelOperator()));
+  kernels.push_back(FilterKernel_shptr(new LoG(9, 7, 1.4)));
+  // Rank 2 kernels of odd and even size.
+  kernels.push_back(create_rank_2_kernel(5, 3));
+  kernels.push_back(create_rank_2_kernel(4, 6));
+  // An even sized kernel, that is convolved directly.
+  kernels.push_back(create_random_kernel(6, 4));
+
+  for(std::vector<FilterKernel_shptr>::const_iterator iter = kernels.begin();
+      iter != kernels.end(); ++iter) {
+
+    FilterKernel_shptr k = *iter;
+    TileImage_GS_DOUBLE_shptr out(new TileImage_GS_DOUBLE(w, h));
+    convolve(out, in, k);
+
+    // Compare with a direct convolution.
+    const unsigned int
+      columns = k->get_columns(), rows = k->get_rows(),
+      cc = k->get_center_column(), cr = k->get_center_row();
+
+    for(unsigned int y = 0; y < h; y++)
+      for(unsigned int x = 0; x < w; x++) {
+	double expected = 0;
+	if(x >= cc && x < w - cc && y >= cr && y < h - cr)
+	  for(unsigned int j = 0; j < rows; j++)
+	    for(unsigned int i = 0; i < columns; i++)
+	      expected += k->get(columns - 1 - i, rows - 1 - j) * in->get_pixel(x - cc + i, y - cr + j);
+
+	CPPUNIT_ASSERT(fabs(out->get_pixel(x, y) - expected) < 1e-9);
+      }
+  }
+}
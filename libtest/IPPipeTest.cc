@@ -0,0 +1,167 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "IPPipeTest.h"
+#include <Image.h>
+#include <IPPipe.h>
+#include <IPCopy.h>
+#include <IPConvolve.h>
+#include <IPNormalize.h>
+#include <IPMedianFilter.h>
+#include <IPThresholding.h>
+#include <FilterKernel.h>
+
+#include <globals.h>
+#include <stdlib.h>
+#include <atomic>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (IPPipeTest);
+
+using namespace std;
+using namespace degate;
+
+void IPPipeTest::setUp(void) {
+  // The streamed pipe runs several strips in parallel.
+  setenv("DEGATE_THREADS", "4", 1);
+}
+
+void IPPipeTest::tearDown(void) {
+  unsetenv("DEGATE_THREADS");
+}
+
+void IPPipeTest::test_pipe_streaming(void) {
+
+  const unsigned int w = 300, h = 200;
+  BackgroundImage_shptr in(new BackgroundImage(w, h, 8));
+
+  srand(42);
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      in->set_pixel(x, y, MERGE_CHANNELS((rand() % 256), (rand() % 256), (rand() % 256), 255));
+
+  FilterKernel_shptr blur(new GaussianBlur(7, 7, 1.5));
+
+  // The fused pipe must give the same results as the processors
+  // run one after another.
+  ImageBase_shptr out[2];
+  for(int i = 0; i < 2; i++) {
+    IPPipe pipe;
+    pipe.set_streaming(i == 0);
+    CPPUNIT_ASSERT(pipe.is_streaming() == (i == 0));
+
+    pipe.add(ImageProcessorBase_shptr
+	     (new IPCopy<BackgroundImage, TileImage_GS_DOUBLE>(10, w - 13, 5, h - 7)));
+    pipe.add(ImageProcessorBase_shptr
+	     (new IPMedianFilter<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>(3)));
+    pipe.add(ImageProcessorBase_shptr
+	     (new IPNormalize<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>(0, 255)));
+    pipe.add(ImageProcessorBase_shptr
+	     (new IPConvolve<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>(blur)));
+    pipe.add(ImageProcessorBase_shptr
+	     (new IPThresholding<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>(128)));
+
+    out[i] = pipe.run(in);
+  }
+
+  TileImage_GS_DOUBLE_shptr streamed = std::dynamic_pointer_cast<TileImage_GS_DOUBLE>(out[0]);
+  TileImage_GS_DOUBLE_shptr stepwise = std::dynamic_pointer_cast<TileImage_GS_DOUBLE>(out[1]);
+  CPPUNIT_ASSERT(streamed != NULL && stepwise != NULL);
+  CPPUNIT_ASSERT(streamed->get_width() == w - 23);
+  CPPUNIT_ASSERT(streamed->get_height() == h - 12);
+  CPPUNIT_ASSERT(stepwise->get_width() == w - 23);
+  CPPUNIT_ASSERT(stepwise->get_height() == h - 12);
+
+  for(unsigned int y = 0; y < streamed->get_height(); y++)
+    for(unsigned int x = 0; x < streamed->get_width(); x++)
+      CPPUNIT_ASSERT(streamed->get_pixel(x, y) == stepwise->get_pixel(x, y));
+}
+
+
+/**
+ * A streamable processor, that copies its input. It keeps the number
+ * of the last row in its scratch buffer and checks, that a strip
+ * passes its own buffer for consecutive rows.
+ */
+class ScratchProcessor : public TypedImageProcessor<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE> {
+
+public:
+
+  mutable std::atomic<unsigned int> rows, strips, errors;
+
+  ScratchProcessor() :
+    TypedImageProcessor<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>("Scratch", "", false),
+    rows(0), strips(0), errors(0) {}
+
+  virtual ImageBase_shptr run(ImageBase_shptr in) {
+    return in;
+  }
+
+  virtual bool is_streamable() const {
+    return true;
+  }
+
+  virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			   unsigned int in_width, unsigned int in_height,
+			   unsigned int out_width, double * out,
+			   std::vector<double> & scratch) const {
+
+    // A new strip starts with an empty buffer.
+    if(scratch.empty()) {
+      scratch.resize(out_width);
+      strips++;
+    }
+    else if(scratch.size() != out_width || scratch[0] + 1 != y) errors++;
+
+    // Pass the row through the buffer.
+    std::copy(in[0], in[0] + out_width, scratch.begin());
+    for(unsigned int x = 0; x < out_width; x++) out[x] = scratch[x];
+    scratch[0] = y;
+
+    rows++;
+  }
+};
+
+void IPPipeTest::test_strip_scratch(void) {
+
+  const unsigned int w = 100, h = 500;
+  TileImage_GS_DOUBLE_shptr in(new TileImage_GS_DOUBLE(w, h));
+
+  srand(7);
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      in->set_pixel(x, y, rand() % 256);
+
+  std::shared_ptr<ScratchProcessor> processor(new ScratchProcessor());
+  IPPipe pipe;
+  pipe.add(processor);
+
+  TileImage_GS_DOUBLE_shptr out = std::dynamic_pointer_cast<TileImage_GS_DOUBLE>(pipe.run(in));
+  CPPUNIT_ASSERT(out != NULL && out != in);
+
+  // Each row is calculated once and the image is split into several strips.
+  CPPUNIT_ASSERT(processor->rows == h);
+  CPPUNIT_ASSERT(processor->strips > 1);
+  CPPUNIT_ASSERT(processor->errors == 0);
+
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      CPPUNIT_ASSERT(out->get_pixel(x, y) == in->get_pixel(x, y));
+}
@@ -28,9 +28,13 @@
 #include "TileImage.h"
 #include "ImageReaderBase.h"
 #include "ImageManipulation.h"
+#include "PixelKernels.h"
+#include "FFT.h"
+#include "IntegralImage.h"
 
 #include "globals.h"
 #include <stdlib.h>
+#include <vector>
 
 CPPUNIT_TEST_SUITE_REGISTRATION (ImageTest);
 
@@ -191,3 +195,275 @@ void ImageTest::test_copy_pixel(void) {
 
   img1->get_pixel_as<gs_byte_pixel_t>(5, 5);
 }
+
+void ImageTest::test_row_access(void) {
+
+  // tiles of size 16x16, the image width is not a multiple of it
+  TileImage_RGBA_shptr img(new TileImage_RGBA(50, 40, 4));
+
+  for(unsigned int y = 0; y < img->get_height(); y++)
+    for(unsigned int x = 0; x < img->get_width(); x++)
+      img->set_pixel(x, y, MERGE_CHANNELS(x, y, (x + y), 255));
+
+  std::vector<rgba_pixel_t> row(img->get_width());
+  read_row(img, 0, 17, img->get_width(), &row[0]);
+  for(unsigned int x = 0; x < img->get_width(); x++)
+    CPPUNIT_ASSERT(row[x] == img->get_pixel(x, 17));
+
+  MemoryImage_GS_BYTE_shptr part(new MemoryImage_GS_BYTE(30, 20));
+  extract_partial_image(part, img, 10, 40, 12, 32);
+  for(unsigned int y = 0; y < part->get_height(); y++)
+    for(unsigned int x = 0; x < part->get_width(); x++)
+      CPPUNIT_ASSERT(part->get_pixel(x, y) ==
+		     img->get_pixel_as<gs_byte_pixel_t>(x + 10, y + 12));
+
+  TileImage_RGBA_shptr scaled(new TileImage_RGBA(25, 20, 4));
+  scale_down_by_2(scaled, img);
+  rgba_pixel_t p = scaled->get_pixel(20, 10);
+  CPPUNIT_ASSERT(MASK_R(p) == 40 && MASK_G(p) == 20 && MASK_B(p) == 61);
+
+  TileImage_RGBA_shptr scaled2(new TileImage_RGBA(12, 10, 4));
+  scale_down_by_2(scaled2, scaled);
+  TileImage_RGBA_shptr scaled4(new TileImage_RGBA(12, 10, 4));
+  scale_down_by_power_of_2(scaled4, img);
+  for(unsigned int y = 0; y < scaled4->get_height(); y++)
+    for(unsigned int x = 0; x < scaled4->get_width(); x++)
+      CPPUNIT_ASSERT(scaled4->get_pixel(x, y) == scaled2->get_pixel(x, y));
+}
+
+void ImageTest::test_pixel_kernels(void) {
+
+  // odd length, so that the SIMD kernels have to process a remainder
+  const size_t n = 101;
+  std::vector<rgba_pixel_t> row0(2 * n), row1(2 * n);
+  for(size_t i = 0; i < 2 * n; i++) {
+    row0[i] = rand();
+    row1[i] = rand() ^ 0xff000000;
+  }
+
+  std::vector<PixelKernels const*> kernels = get_supported_pixel_kernels();
+  CPPUNIT_ASSERT(!kernels.empty());
+
+  for(std::vector<PixelKernels const*>::const_iterator iter = kernels.begin();
+      iter != kernels.end(); ++iter) {
+
+    std::vector<gs_byte_pixel_t> gs_byte(n);
+    std::vector<gs_double_pixel_t> gs_double(n);
+    std::vector<rgba_pixel_t> scaled(n);
+    std::vector<gs_byte_pixel_t> gs_byte2(n);
+
+    (*iter)->rgba_to_gs_byte(&row0[0], &gs_byte[0], n);
+    (*iter)->rgba_to_gs_double(&row0[0], &gs_double[0], n);
+    (*iter)->average_rgba_2x2(&row0[0], &row1[0], &scaled[0], n);
+    (*iter)->rgba_to_gs_byte(&row1[0], &gs_byte2[0], n);
+
+    uint64_t sum_a;
+    uint64_t sum_ab = (*iter)->dot_product_gs_byte(&gs_byte[0], &gs_byte2[0], n, &sum_a);
+    uint64_t expected_sum_a = 0, expected_sum_ab = 0;
+    for(size_t i = 0; i < n; i++) {
+      expected_sum_a += gs_byte[i];
+      expected_sum_ab += gs_byte[i] * gs_byte2[i];
+    }
+    CPPUNIT_ASSERT(sum_a == expected_sum_a);
+    CPPUNIT_ASSERT(sum_ab == expected_sum_ab);
+
+    std::vector<double> src(n), dst(n), expected_dst(n);
+    for(size_t i = 0; i < n; i++) {
+      src[i] = gs_double[i] / 7.0;
+      dst[i] = expected_dst[i] = gs_byte2[i] / 3.0;
+      expected_dst[i] += 0.3 * src[i];
+    }
+    (*iter)->add_scaled_double(&src[0], 0.3, &dst[0], n);
+    CPPUNIT_ASSERT(dst == expected_dst);
+
+    for(size_t i = 0; i < n; i++) {
+      CPPUNIT_ASSERT(gs_byte[i] == RGBA_TO_GS_BY_VAL(row0[i]));
+      CPPUNIT_ASSERT(gs_double[i] == RGBA_TO_GS_BY_VAL(row0[i]));
+
+      rgba_pixel_t p1 = row0[2*i], p2 = row0[2*i+1], p3 = row1[2*i], p4 = row1[2*i+1];
+      CPPUNIT_ASSERT(MASK_R(scaled[i]) == (MASK_R(p1) + MASK_R(p2) + MASK_R(p3) + MASK_R(p4)) / 4);
+      CPPUNIT_ASSERT(MASK_G(scaled[i]) == (MASK_G(p1) + MASK_G(p2) + MASK_G(p3) + MASK_G(p4)) / 4);
+      CPPUNIT_ASSERT(MASK_B(scaled[i]) == (MASK_B(p1) + MASK_B(p2) + MASK_B(p3) + MASK_B(p4)) / 4);
+      CPPUNIT_ASSERT(MASK_A(scaled[i]) == (MASK_A(p1) + MASK_A(p2) + MASK_A(p3) + MASK_A(p4)) / 4);
+    }
+  }
+}
+
+void ImageTest::test_fft(void) {
+
+  CPPUNIT_ASSERT(get_fft_size(1) == 1);
+  CPPUNIT_ASSERT(get_fft_size(33) == 64);
+  CPPUNIT_ASSERT(get_fft_size(64) == 64);
+
+  // Compare with a naive DFT.
+  const unsigned int w = 16, h = 8;
+  std::vector<complex_t> data(w * h), orig(w * h);
+  for(unsigned int i = 0; i < w * h; i++) orig[i] = data[i] = complex_t(rand() % 256, rand() % 256);
+
+  FFT2D fft(w, h);
+  fft.transform(&data[0]);
+
+  for(unsigned int v = 0; v < h; v++)
+    for(unsigned int u = 0; u < w; u++) {
+      complex_t sum = 0;
+      for(unsigned int y = 0; y < h; y++)
+	for(unsigned int x = 0; x < w; x++)
+	  sum += orig[y * w + x] * std::polar(1.0, -2.0 * M_PI * ((double)u * x / w + (double)v * y / h));
+      CPPUNIT_ASSERT(std::abs(sum - data[v * w + u]) < 1e-6);
+    }
+
+  // The inverse transform is not normalized.
+  fft.transform(&data[0], true);
+  for(unsigned int i = 0; i < w * h; i++)
+    CPPUNIT_ASSERT(std::abs(data[i] / (double)(w * h) - orig[i]) < 1e-9);
+
+  CPPUNIT_ASSERT_THROW(FFT2D(12, 8), DegateRuntimeException);
+}
+
+void ImageTest::test_integral_image(void) {
+
+  const unsigned int w = 50, h = 45;
+  TileImage_GS_BYTE_shptr img(new TileImage_GS_BYTE(w, h, 3));
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++)
+      img->set_pixel(x, y, rand() % 256);
+
+  TileImage_SUM_UINT32_shptr single(new TileImage_SUM_UINT32(w, h, 3));
+  TileImage_SUM_INT64_shptr squared(new TileImage_SUM_INT64(w, h, 3));
+  build_integral_images(single, squared, img, 3);
+
+  TileImage_GS_DOUBLE_shptr single_d(new TileImage_GS_DOUBLE(w, h, 3));
+  TileImage_GS_DOUBLE_shptr squared_d(new TileImage_GS_DOUBLE(w, h, 3));
+  build_integral_images(single_d, squared_d, img, 1);
+
+  // Compare with naive sums.
+  std::vector<int64_t> s1(w * h), s2(w * h);
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++) {
+      int64_t p = img->get_pixel(x, y);
+      unsigned int i = y * w + x;
+      s1[i] = p + (x > 0 ? s1[i - 1] : 0) + (y > 0 ? s1[i - w] : 0) - (x > 0 && y > 0 ? s1[i - w - 1] : 0);
+      s2[i] = p*p + (x > 0 ? s2[i - 1] : 0) + (y > 0 ? s2[i - w] : 0) - (x > 0 && y > 0 ? s2[i - w - 1] : 0);
+
+      CPPUNIT_ASSERT(single->get_pixel(x, y) == s1[i]);
+      CPPUNIT_ASSERT(squared->get_pixel(x, y) == s2[i]);
+      CPPUNIT_ASSERT(single_d->get_pixel(x, y) == s1[i]);
+      CPPUNIT_ASSERT(squared_d->get_pixel(x, y) == s2[i]);
+    }
+
+  // Sums over regions, including regions at the image border.
+  for(unsigned int i = 0; i < 100; i++) {
+    unsigned int
+      min_x = rand() % w, min_y = rand() % h,
+      rw = 1 + rand() % (w - min_x), rh = 1 + rand() % (h - min_y);
+
+    int64_t n1 = 0, n2 = 0;
+    for(unsigned int y = min_y; y < min_y + rh; y++)
+      for(unsigned int x = min_x; x < min_x + rw; x++) {
+	int64_t p = img->get_pixel(x, y);
+	n1 += p;
+	n2 += p * p;
+      }
+
+    double r1, r2;
+    get_region_sums(single, squared, min_x, min_y, rw, rh, r1, r2);
+    CPPUNIT_ASSERT(r1 == n1);
+    CPPUNIT_ASSERT(r2 == n2);
+  }
+}
+
+/**
+ * Write an RGB tiff file, either with strips of rows_per_strip rows or
+ * with tiles of tile_size x tile_size pixels, if tile_size is not zero.
+ */
+static void write_test_tiff(std::string const& filename,
+			    unsigned int width, unsigned int height,
+			    unsigned int rows_per_strip, unsigned int tile_size) {
+
+  TIFF * tif = TIFFOpen(filename.c_str(), "w");
+  CPPUNIT_ASSERT(tif != NULL);
+
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+
+  if(tile_size > 0) {
+    TIFFSetField(tif, TIFFTAG_TILEWIDTH, tile_size);
+    TIFFSetField(tif, TIFFTAG_TILELENGTH, tile_size);
+
+    std::vector<unsigned char> buf(tile_size * tile_size * 3);
+    for(unsigned int row = 0; row < height; row += tile_size)
+      for(unsigned int col = 0; col < width; col += tile_size) {
+	for(unsigned int y = 0; y < tile_size; y++)
+	  for(unsigned int x = 0; x < tile_size; x++) {
+	    unsigned char * p = &buf[(y * tile_size + x) * 3];
+	    p[0] = (col + x) & 0xff;
+	    p[1] = (row + y) & 0xff;
+	    p[2] = ((col + x) ^ (row + y)) & 0xff;
+	  }
+	CPPUNIT_ASSERT(TIFFWriteTile(tif, &buf[0], col, row, 0, 0) != -1);
+      }
+  }
+  else {
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+
+    std::vector<unsigned char> buf(width * 3);
+    for(unsigned int y = 0; y < height; y++) {
+      for(unsigned int x = 0; x < width; x++) {
+	buf[x * 3] = x & 0xff;
+	buf[x * 3 + 1] = y & 0xff;
+	buf[x * 3 + 2] = (x ^ y) & 0xff;
+      }
+      CPPUNIT_ASSERT(TIFFWriteScanline(tif, &buf[0], y, 0) != -1);
+    }
+  }
+
+  TIFFClose(tif);
+}
+
+void ImageTest::test_tiff_block_import(void) {
+
+  const unsigned int w = 300, h = 203;
+  std::string tiff_file("degate_block_import_test.tif");
+
+  // Several workers read the blocks of one image.
+  setenv("DEGATE_THREADS", "4", 1);
+
+  // Strips and tiles, that are clipped at the image border.
+  for(unsigned int i = 0; i < 2; i++) {
+
+    if(i == 0) write_test_tiff(tiff_file, w, h, 7, 0);
+    else write_test_tiff(tiff_file, w, h, 0, 32);
+
+    TIFFReader<TileImage_RGBA> reader(tiff_file);
+    CPPUNIT_ASSERT(reader.read() == true);
+    CPPUNIT_ASSERT(reader.get_width() == w);
+    CPPUNIT_ASSERT(reader.get_height() == h);
+
+    // tiles of size 64x64
+    TileImage_RGBA_shptr img(new TileImage_RGBA(w, h, 6));
+    CPPUNIT_ASSERT(reader.get_image(img) == true);
+
+    for(unsigned int y = 0; y < h; y++)
+      for(unsigned int x = 0; x < w; x++) {
+	rgba_pixel_t p = img->get_pixel(x, y);
+	CPPUNIT_ASSERT(MASK_R(p) == (x & 0xff));
+	CPPUNIT_ASSERT(MASK_G(p) == (y & 0xff));
+	CPPUNIT_ASSERT(MASK_B(p) == ((x ^ y) & 0xff));
+	CPPUNIT_ASSERT(MASK_A(p) == 255);
+      }
+
+    // A smaller destination image receives the upper left region only.
+    TileImage_RGBA_shptr part(new TileImage_RGBA(100, 50, 6));
+    CPPUNIT_ASSERT(reader.get_image(part) == true);
+    rgba_pixel_t p = part->get_pixel(99, 49);
+    CPPUNIT_ASSERT(MASK_R(p) == 99 && MASK_G(p) == 49 && MASK_B(p) == (99 ^ 49));
+  }
+
+  unsetenv("DEGATE_THREADS");
+  remove_file(tiff_file);
+}
@@ -38,8 +38,13 @@ class ImageTest : public CPPUNIT_NS :: TestFixture {
   
   CPPUNIT_TEST (test_type_traits);
   CPPUNIT_TEST (test_image_reader);
+  CPPUNIT_TEST (test_tiff_block_import);
   CPPUNIT_TEST (test_convert_pixel);
   CPPUNIT_TEST (test_copy_pixel);
+  CPPUNIT_TEST (test_row_access);
+  CPPUNIT_TEST (test_pixel_kernels);
+  CPPUNIT_TEST (test_fft);
+  CPPUNIT_TEST (test_integral_image);
   
   CPPUNIT_TEST_SUITE_END ();
   
@@ -52,8 +57,13 @@ protected:
   void test_rgba_in_temp_file(void);
   void test_type_traits(void);
   void test_image_reader(void);
+  void test_tiff_block_import(void);
   void test_convert_pixel(void);
   void test_copy_pixel(void);
+  void test_row_access(void);
+  void test_pixel_kernels(void);
+  void test_fft(void);
+  void test_integral_image(void);
   
   
   
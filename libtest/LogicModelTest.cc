@@ -27,6 +27,7 @@
 #include "QuadTree.h"
 #include "Wire.h"
 #include "Via.h"
+#include "PreparedTemplateCache.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION (LogicModelTest);
 
@@ -144,3 +145,31 @@ void LogicModelTest::test_add_and_retrieve_wire(void) {
 }
 
 
+
+void LogicModelTest::test_prepared_template_cache(void) {
+  GateLibrary_shptr glib(new GateLibrary());
+  PreparedTemplateCache_shptr cache = glib->get_prepared_template_cache();
+  CPPUNIT_ASSERT(cache != NULL);
+
+  GateTemplate_shptr tmpl(new GateTemplate(10, 10));
+  tmpl->set_object_id(42);
+  glib->add_template(tmpl);
+
+  GateTemplateImage_shptr img(new GateTemplateImage(10, 10));
+  tmpl->set_image(Layer::LOGIC, img);
+
+  PreparedTemplateImages_shptr images(new PreparedTemplateImages());
+  cache->put(tmpl, Gate::ORIENTATION_NORMAL, Layer::LOGIC, 4, images);
+  CPPUNIT_ASSERT(cache->size() == 1);
+  CPPUNIT_ASSERT(cache->get(tmpl, Gate::ORIENTATION_NORMAL, Layer::LOGIC, 4) == images);
+  CPPUNIT_ASSERT(cache->get(tmpl, Gate::ORIENTATION_FLIPPED_BOTH, Layer::LOGIC, 4) == NULL);
+  CPPUNIT_ASSERT(cache->get(tmpl, Gate::ORIENTATION_NORMAL, Layer::LOGIC, 2) == NULL);
+
+  // a new reference image makes the entry outdated
+  tmpl->set_image(Layer::LOGIC, img);
+  CPPUNIT_ASSERT(cache->get(tmpl, Gate::ORIENTATION_NORMAL, Layer::LOGIC, 4) == NULL);
+
+  cache->put(tmpl, Gate::ORIENTATION_NORMAL, Layer::LOGIC, 4, images);
+  glib->remove_template(tmpl);
+  CPPUNIT_ASSERT(cache->size() == 0);
+}
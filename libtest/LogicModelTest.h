@@ -37,6 +37,7 @@ class LogicModelTest : public CPPUNIT_NS::TestFixture {
   CPPUNIT_TEST (test_add_layer);
   CPPUNIT_TEST (test_add_and_retrieve_placed_lmo);
   CPPUNIT_TEST (test_add_and_retrieve_wire);
+  CPPUNIT_TEST (test_prepared_template_cache);
 
   CPPUNIT_TEST_SUITE_END ();
 	
@@ -53,6 +54,7 @@ protected:
   void test_add_layer(void);
   void test_add_and_retrieve_placed_lmo(void);
   void test_add_and_retrieve_wire(void);
+  void test_prepared_template_cache(void);
 
 };
 
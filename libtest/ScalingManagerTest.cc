@@ -63,3 +63,103 @@ void ScalingManagerTest::test_scaling_manager_shptrimg(void) {
   ScalingManager<BackgroundImage> sm(img, img->get_directory(), 256);
   sm.create_scalings();
 }
+
+void ScalingManagerTest::test_update_scalings(void) {
+
+  std::string img_dir(create_temp_directory());
+
+  // tiles of size 64x64
+  BackgroundImage_shptr img(new BackgroundImage(700, 500, img_dir, false, 6));
+  for(unsigned int y = 0; y < img->get_height(); y++)
+    for(unsigned int x = 0; x < img->get_width(); x++)
+      img->set_pixel(x, y, MERGE_CHANNELS((x & 0xff), (y & 0xff), 0, 255));
+
+  ScalingManager<BackgroundImage> sm(img, img->get_directory(), 64);
+  sm.create_scalings();
+
+  BackgroundImage_shptr scaled = sm.get_image(4).second;
+  CPPUNIT_ASSERT(scaled->get_width() == 175);
+  CPPUNIT_ASSERT(MASK_R(scaled->get_pixel(20, 10)) == 81);
+
+  // modify a region and update the prescaled images
+  for(unsigned int y = 100; y < 200; y++)
+    for(unsigned int x = 300; x < 400; x++)
+      img->set_pixel(x, y, MERGE_CHANNELS(255, 255, 255, 255));
+
+  sm.update_scalings(BoundingBox(300, 399, 100, 199));
+
+  CPPUNIT_ASSERT(scaled->get_pixel(90, 40) == (unsigned)MERGE_CHANNELS(255, 255, 255, 255));
+  CPPUNIT_ASSERT(MASK_R(scaled->get_pixel(20, 10)) == 81);
+
+  remove_directory(img_dir);
+}
+
+void ScalingManagerTest::test_sum_table_directory(void) {
+
+  std::string img_dir(create_temp_directory());
+
+  BackgroundImage_shptr img(new BackgroundImage(300, 200, img_dir, true, 6));
+  ScalingManager<BackgroundImage> sm(img, img->get_directory(), 64);
+  sm.create_scalings();
+
+  std::string dir = sm.get_sum_table_directory(4);
+  CPPUNIT_ASSERT(dir == join_pathes(img_dir, "sum_tables_4.dimg"));
+
+  // Summation tables are outdated, if the master image is modified.
+  create_directory(dir);
+  sm.update_scalings(BoundingBox(0, 10, 0, 10));
+  CPPUNIT_ASSERT(!file_exists(dir));
+
+  // Non persistent images have no place for summation tables.
+  BackgroundImage_shptr tmp_img(new BackgroundImage(300, 200, 6));
+  ScalingManager<BackgroundImage> tmp_sm(tmp_img, tmp_img->get_directory(), 64);
+  CPPUNIT_ASSERT(tmp_sm.get_sum_table_directory(4).empty());
+
+  // The master image is persistent.
+  remove_directory(img_dir);
+}
+
+void ScalingManagerTest::test_greyscale_cache(void) {
+
+  std::string img_dir(create_temp_directory());
+
+  // tiles of size 64x64
+  BackgroundImage_shptr img(new BackgroundImage(700, 500, img_dir, false, 6));
+  for(unsigned int y = 0; y < img->get_height(); y++)
+    for(unsigned int x = 0; x < img->get_width(); x++)
+      img->set_pixel(x, y, MERGE_CHANNELS((x & 0xff), (y & 0xff), 0, 255));
+
+  ScalingManager<BackgroundImage> sm(img, img->get_directory(), 64);
+  sm.create_scalings();
+
+  GreyscaleImageCache_shptr cache = sm.get_greyscale_cache();
+  CPPUNIT_ASSERT(cache == sm.get_greyscale_cache());
+
+  TileImage_GS_BYTE_shptr gs = cache->get_gs_byte_image(1, BoundingBox(100, 199, 50, 149));
+  CPPUNIT_ASSERT(gs->get_width() == 700);
+  for(unsigned int y = 50; y < 150; y++)
+    for(unsigned int x = 100; x < 200; x++)
+      CPPUNIT_ASSERT(gs->get_pixel(x, y) == RGBA_TO_GS_BY_VAL(img->get_pixel(x, y)));
+
+  BackgroundImage_shptr scaled = sm.get_image(4).second;
+  TileImage_GS_DOUBLE_shptr gs_double = cache->get_gs_double_image(4, BoundingBox(0, 174, 0, 124));
+  CPPUNIT_ASSERT(gs_double->get_width() == 175);
+  CPPUNIT_ASSERT(gs_double->get_pixel(20, 10) == RGBA_TO_GS_BY_VAL(scaled->get_pixel(20, 10)) / 255.0);
+
+  // modify a region, the cached tiles must be converted again
+  for(unsigned int y = 100; y < 200; y++)
+    for(unsigned int x = 100; x < 200; x++)
+      img->set_pixel(x, y, MERGE_CHANNELS(255, 255, 255, 255));
+
+  sm.update_scalings(BoundingBox(100, 199, 100, 199));
+
+  CPPUNIT_ASSERT(cache->get_gs_byte_image(1, BoundingBox(100, 199, 50, 149)) == gs);
+  CPPUNIT_ASSERT(gs->get_pixel(150, 120) == 255);
+  CPPUNIT_ASSERT(gs->get_pixel(150, 60) == RGBA_TO_GS_BY_VAL(img->get_pixel(150, 60)));
+
+  cache->get_gs_double_image(4, BoundingBox(0, 174, 0, 124));
+  CPPUNIT_ASSERT(gs_double->get_pixel(35, 35) == 1.0);
+  CPPUNIT_ASSERT(gs_double->get_pixel(20, 10) == RGBA_TO_GS_BY_VAL(scaled->get_pixel(20, 10)) / 255.0);
+
+  remove_directory(img_dir);
+}
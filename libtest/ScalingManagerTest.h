@@ -34,6 +34,9 @@ class ScalingManagerTest : public CPPUNIT_NS :: TestFixture {
   CPPUNIT_TEST_SUITE(ScalingManagerTest);
   
   CPPUNIT_TEST (test_scaling_manager_shptrimg);
+  CPPUNIT_TEST (test_update_scalings);
+  CPPUNIT_TEST (test_sum_table_directory);
+  CPPUNIT_TEST (test_greyscale_cache);
   
   CPPUNIT_TEST_SUITE_END ();
   
@@ -44,6 +47,9 @@ public:
 protected:
 
   void test_scaling_manager_shptrimg(void);
+  void test_update_scalings(void);
+  void test_sum_table_directory(void);
+  void test_greyscale_cache(void);
   
 };
 
@@ -0,0 +1,411 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TemplateMatchingTest.h"
+#include "TemplateMatching.h"
+#include "Project.h"
+#include "LogicModel.h"
+#include "GateLibrary.h"
+#include "FileSystem.h"
+
+#include "globals.h"
+#include <stdlib.h>
+#include <set>
+#include <map>
+#include <cmath>
+#include <boost/format.hpp>
+#include <boost/foreach.hpp>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (TemplateMatchingTest);
+
+using namespace std;
+using namespace degate;
+
+typedef std::list<TemplateMatching::match_found> match_list;
+
+struct placement {
+  unsigned int x, y, tmpl;
+  Gate::ORIENTATION orientation;
+};
+
+static const unsigned int project_width = 320, project_height = 240;
+
+static const unsigned int tmpl_sizes[][2] = { { 24, 20 }, { 16, 28 } };
+
+static const placement placements[] = {
+  {  20,  20, 0, Gate::ORIENTATION_NORMAL },
+  { 100,  30, 0, Gate::ORIENTATION_FLIPPED_LEFT_RIGHT },
+  { 200,  25, 1, Gate::ORIENTATION_NORMAL },
+  {  40, 120, 1, Gate::ORIENTATION_FLIPPED_UP_DOWN },
+  { 150, 140, 0, Gate::ORIENTATION_FLIPPED_BOTH },
+  { 250, 150, 1, Gate::ORIENTATION_FLIPPED_LEFT_RIGHT },
+  {  90, 190, 0, Gate::ORIENTATION_NORMAL }
+};
+
+/**
+ * Get a grey value of a texture with blocks of 4x4 pixels.
+ */
+static rgba_pixel_t get_texture(unsigned int x, unsigned int y, unsigned int seed) {
+  uint32_t h = (x / 4) * 73856093U ^ (y / 4) * 19349663U ^ (seed + 1) * 83492791U;
+  h ^= h >> 13;
+  h *= 0x5bd1e995U;
+  h ^= h >> 15;
+  const unsigned int grey = h & 0xff;
+  return MERGE_CHANNELS(grey, grey, grey, 255);
+}
+
+/**
+ * Create a project with a logic layer. The background image is a texture
+ * with copies of the gate templates in several orientations.
+ */
+static Project_shptr create_project(std::string const& dir,
+				    std::list<GateTemplate_shptr> & templates) {
+
+  Project_shptr project(new Project(project_width, project_height, dir));
+  LogicModel_shptr lmodel = project->get_logic_model();
+
+  BackgroundImage_shptr bg(new BackgroundImage(project_width, project_height,
+					       join_pathes(dir, "layer_0.dimg")));
+  for(unsigned int y = 0; y < project_height; y++)
+    for(unsigned int x = 0; x < project_width; x++)
+      bg->set_pixel(x, y, get_texture(x, y, 0));
+
+  templates.clear();
+  for(unsigned int i = 0; i < sizeof(tmpl_sizes) / sizeof(tmpl_sizes[0]); i++) {
+    const unsigned int w = tmpl_sizes[i][0], h = tmpl_sizes[i][1];
+
+    GateTemplateImage_shptr img(new GateTemplateImage(w, h));
+    for(unsigned int y = 0; y < h; y++)
+      for(unsigned int x = 0; x < w; x++)
+	img->set_pixel(x, y, get_texture(x, y, i + 1));
+
+    GateTemplate_shptr tmpl(new GateTemplate(w, h));
+    tmpl->set_object_id(lmodel->get_new_object_id());
+    tmpl->set_name(i == 0 ? "a" : "b");
+    tmpl->set_image(Layer::LOGIC, img);
+    lmodel->get_gate_library()->add_template(tmpl);
+    templates.push_back(tmpl);
+  }
+
+  for(unsigned int i = 0; i < sizeof(placements) / sizeof(placements[0]); i++) {
+    placement const& p = placements[i];
+    const unsigned int w = tmpl_sizes[p.tmpl][0], h = tmpl_sizes[p.tmpl][1];
+    const bool
+      flip_x = p.orientation == Gate::ORIENTATION_FLIPPED_LEFT_RIGHT ||
+      p.orientation == Gate::ORIENTATION_FLIPPED_BOTH,
+      flip_y = p.orientation == Gate::ORIENTATION_FLIPPED_UP_DOWN ||
+      p.orientation == Gate::ORIENTATION_FLIPPED_BOTH;
+
+    for(unsigned int y = 0; y < h; y++)
+      for(unsigned int x = 0; x < w; x++)
+	bg->set_pixel(p.x + x, p.y + y, get_texture(flip_x ? w - 1 - x : x,
+						    flip_y ? h - 1 - y : y, p.tmpl + 1));
+  }
+
+  Layer_shptr layer(new Layer(project->get_bounding_box(), Layer::LOGIC));
+  lmodel->add_layer(0, layer);
+  layer->set_image(bg);
+
+  return project;
+}
+
+/**
+ * Set up a template matching for all templates in all orientations.
+ */
+static void init_matching(TemplateMatching_shptr matching, Project_shptr project,
+			  std::list<GateTemplate_shptr> const& templates,
+			  BoundingBox const& search_area) {
+
+  Layer_shptr layer = project->get_logic_model()->get_layer(0);
+
+  std::list<Gate::ORIENTATION> orientations;
+  orientations.push_back(Gate::ORIENTATION_NORMAL);
+  orientations.push_back(Gate::ORIENTATION_FLIPPED_UP_DOWN);
+  orientations.push_back(Gate::ORIENTATION_FLIPPED_LEFT_RIGHT);
+  orientations.push_back(Gate::ORIENTATION_FLIPPED_BOTH);
+
+  // The texture correlates randomly with the templates at some places.
+  // The placed copies correlate with nearly 1.0.
+  matching->set_threshold_detection(0.9);
+
+  matching->set_templates(templates);
+  matching->set_orientations(orientations);
+  matching->set_layers(layer, layer);
+  matching->init(search_area, project);
+}
+
+/**
+ * Remove all gates, that intersect a region.
+ * @return Returns the number of removed gates.
+ */
+static unsigned int remove_gates(LogicModel_shptr lmodel, BoundingBox const& region) {
+
+  std::list<Gate_shptr> gates;
+  for(LogicModel::gate_collection::iterator iter = lmodel->gates_begin();
+      iter != lmodel->gates_end(); ++iter)
+    if(iter->second->get_bounding_box().intersects(region)) gates.push_back(iter->second);
+
+  BOOST_FOREACH(Gate_shptr gate, gates) lmodel->remove_object(gate);
+  return gates.size();
+}
+
+/**
+ * Get a description of all gates with their position, template and orientation.
+ */
+static std::set<std::string> get_gates(LogicModel_shptr lmodel) {
+
+  std::set<std::string> gates;
+  for(LogicModel::gate_collection::iterator iter = lmodel->gates_begin();
+      iter != lmodel->gates_end(); ++iter) {
+    Gate_shptr gate = iter->second;
+    boost::format f("%1% %2% %3% %4%");
+    f % gate->get_min_x() % gate->get_min_y()
+      % gate->get_gate_template()->get_name() % gate->get_orientation();
+    gates.insert(f.str());
+  }
+  return gates;
+}
+
+/**
+ * Run a template matching on a new test project.
+ * @param threads The number of worker threads.
+ * @param search_area The region to match. If NULL, the whole project is matched.
+ * @param grid_distance If not zero, regular grids with this distance are enabled.
+ * @return Returns the matches of the run.
+ */
+static match_list run_matching(TemplateMatching_shptr matching, char const* threads,
+			       BoundingBox const* search_area = NULL,
+			       double grid_distance = 0) {
+
+  std::string dir = create_temp_directory();
+  std::list<GateTemplate_shptr> templates;
+  Project_shptr project = create_project(dir, templates);
+
+  if(grid_distance > 0) {
+    RegularGrid_shptr h = project->get_regular_horizontal_grid();
+    h->set_range(0, project_width);
+    h->set_distance(grid_distance);
+    h->set_enabled(true);
+
+    RegularGrid_shptr v = project->get_regular_vertical_grid();
+    v->set_range(0, project_height);
+    v->set_distance(grid_distance);
+    v->set_enabled(true);
+  }
+
+  setenv("DEGATE_THREADS", threads, 1);
+
+  init_matching(matching, project, templates,
+		search_area != NULL ? *search_area : project->get_bounding_box());
+  matching->run();
+
+  unsetenv("DEGATE_THREADS");
+
+  match_list matches = matching->get_matches();
+  remove_directory(dir);
+  return matches;
+}
+
+static bool compare_position(TemplateMatching::match_found const& lhs,
+			     TemplateMatching::match_found const& rhs) {
+  if(lhs.y != rhs.y) return lhs.y < rhs.y;
+  if(lhs.x != rhs.x) return lhs.x < rhs.x;
+  if(lhs.tmpl->get_name() != rhs.tmpl->get_name()) return lhs.tmpl->get_name() < rhs.tmpl->get_name();
+  if(lhs.orientation != rhs.orientation) return lhs.orientation < rhs.orientation;
+  return lhs.correlation < rhs.correlation;
+}
+
+/**
+ * Check, if two runs found exactly the same matches.
+ */
+static bool equal_matches(match_list a, match_list b) {
+
+  if(a.size() != b.size()) return false;
+
+  a.sort(compare_position);
+  b.sort(compare_position);
+
+  for(match_list::const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+    if(i->x != j->x || i->y != j->y ||
+       i->tmpl->get_name() != j->tmpl->get_name() ||
+       i->orientation != j->orientation ||
+       i->correlation != j->correlation) return false;
+
+  return true;
+}
+
+/**
+ * Get the matches by their position, template and orientation. A position
+ * can be found more than once, but always with the same correlation.
+ */
+static std::map<std::string, double> get_match_positions(match_list const& matches) {
+
+  std::map<std::string, double> positions;
+  BOOST_FOREACH(TemplateMatching::match_found const& m, matches) {
+    boost::format f("%1% %2% %3% %4%");
+    f % m.x % m.y % m.tmpl->get_name() % m.orientation;
+    positions[f.str()] = m.correlation;
+  }
+  return positions;
+}
+
+/**
+ * Check, if two runs found matches at the same positions with nearly
+ * the same correlation.
+ */
+static bool similar_matches(match_list const& a, match_list const& b, double tolerance) {
+
+  std::map<std::string, double> pos_a = get_match_positions(a), pos_b = get_match_positions(b);
+  if(pos_a.size() != pos_b.size()) return false;
+
+  for(std::map<std::string, double>::const_iterator i = pos_a.begin(), j = pos_b.begin();
+      i != pos_a.end(); ++i, ++j)
+    if(i->first != j->first || fabs(i->second - j->second) > tolerance) return false;
+
+  return true;
+}
+
+
+void TemplateMatchingTest::setUp(void) {
+}
+
+void TemplateMatchingTest::tearDown(void) {
+}
+
+void TemplateMatchingTest::test_parallel_tasks(void) {
+
+  match_list serial = run_matching(TemplateMatching_shptr(new TemplateMatchingNormal()), "1");
+  match_list parallel = run_matching(TemplateMatching_shptr(new TemplateMatchingNormal()), "4");
+
+  CPPUNIT_ASSERT(!serial.empty());
+  CPPUNIT_ASSERT(equal_matches(serial, parallel));
+}
+
+void TemplateMatchingTest::test_early_rejection(void) {
+
+  TemplateMatching_shptr exact(new TemplateMatchingNormal());
+  exact->set_early_rejection(false);
+  match_list exact_matches = run_matching(exact, "1");
+
+  TemplateMatching_shptr bounded(new TemplateMatchingNormal());
+  bounded->set_early_rejection(true);
+  match_list bounded_matches = run_matching(bounded, "1");
+
+  CPPUNIT_ASSERT(!exact_matches.empty());
+  CPPUNIT_ASSERT(bounded->get_number_of_early_rejections() > 0);
+  CPPUNIT_ASSERT(equal_matches(exact_matches, bounded_matches));
+}
+
+void TemplateMatchingTest::test_batched(void) {
+
+  // The templates differ in size and are placed in all orientations.
+  TemplateMatching_shptr single(new TemplateMatchingNormal());
+  single->set_batched(false);
+  match_list single_matches = run_matching(single, "4");
+
+  TemplateMatching_shptr batched(new TemplateMatchingNormal());
+  batched->set_batched(true);
+  match_list batched_matches = run_matching(batched, "4");
+
+  CPPUNIT_ASSERT(!single_matches.empty());
+  CPPUNIT_ASSERT(equal_matches(single_matches, batched_matches));
+}
+
+/**
+ * Create a template matching along grid lines.
+ */
+static TemplateMatching_shptr create_grid_matching(bool in_cols, bool parallel_grid) {
+  TemplateMatchingAlongGrid * matching = NULL;
+  if(in_cols) matching = new TemplateMatchingInCols();
+  else matching = new TemplateMatchingInRows();
+  matching->set_parallel_grid(parallel_grid);
+  return TemplateMatching_shptr(matching);
+}
+
+void TemplateMatchingTest::test_parallel_grid(void) {
+
+  // The grid lines have a distance of 5 pixels. The size of the
+  // region is not a multiple of it.
+  BoundingBox search_area(7, 303, 11, 229);
+
+  for(int in_cols = 0; in_cols < 2; in_cols++) {
+
+    match_list serial = run_matching(create_grid_matching(in_cols, false), "4",
+				     &search_area, 5);
+    match_list parallel = run_matching(create_grid_matching(in_cols, true), "4",
+				       &search_area, 5);
+
+    CPPUNIT_ASSERT(!serial.empty());
+    CPPUNIT_ASSERT(equal_matches(serial, parallel));
+  }
+}
+
+void TemplateMatchingTest::test_incremental(void) {
+
+  std::string dir = create_temp_directory();
+  std::list<GateTemplate_shptr> templates;
+  Project_shptr project = create_project(dir, templates);
+  LogicModel_shptr lmodel = project->get_logic_model();
+
+  TemplateMatching_shptr matching(new TemplateMatchingNormal());
+  init_matching(matching, project, templates, project->get_bounding_box());
+  matching->run();
+
+  // The region covers two of the placed templates. Removing their
+  // gates makes the region look like it was edited after the run.
+  BoundingBox region(140, 280, 130, 185);
+  CPPUNIT_ASSERT(remove_gates(lmodel, region) == 2);
+
+  matching->run_incremental(std::list<BoundingBox>(1, region));
+  std::set<std::string> incremental = get_gates(lmodel);
+
+  // The scan of a full run passes the region with other step sizes and
+  // may find other candidates, that overlap the placed gates. So the
+  // placed gates are compared.
+  CPPUNIT_ASSERT(remove_gates(lmodel, region) == 2);
+
+  TemplateMatching_shptr full(new TemplateMatchingNormal());
+  init_matching(full, project, templates, project->get_bounding_box());
+  full->run();
+
+  CPPUNIT_ASSERT(incremental.size() == sizeof(placements) / sizeof(placements[0]));
+  CPPUNIT_ASSERT(incremental == get_gates(lmodel));
+
+  remove_directory(dir);
+}
+
+void TemplateMatchingTest::test_fft(void) {
+
+  TemplateMatching_shptr direct(new TemplateMatchingNormal());
+  direct->set_use_fft(false);
+  match_list direct_matches = run_matching(direct, "4");
+
+  TemplateMatching_shptr fft(new TemplateMatchingNormal());
+  fft->set_use_fft(true);
+  match_list fft_matches = run_matching(fft, "4");
+
+  // The scans visit other positions and may find a match more than
+  // once, but all placed templates are found at the same positions.
+  CPPUNIT_ASSERT(get_match_positions(direct_matches).size() ==
+		 sizeof(placements) / sizeof(placements[0]));
+  CPPUNIT_ASSERT(similar_matches(direct_matches, fft_matches, 1e-6));
+}
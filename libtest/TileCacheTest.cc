@@ -0,0 +1,340 @@
+/*
+ 
+ This file is part of the IC reverse engineering tool degate.
+ 
+ Copyright 2008, 2009, 2010 by Martin Schobert
+ 
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+ 
+*/
+
+
+#include "TileCacheTest.h"
+#include "Image.h"
+#include "TileCache.h"
+#include "FileSystem.h"
+#include "ScalingManager.h"
+
+#include "globals.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (TileCacheTest);
+
+using namespace std;
+using namespace degate;
+
+void TileCacheTest::setUp(void) { 
+}
+
+void TileCacheTest::tearDown(void) {
+}
+
+void TileCacheTest::test_statistics(void) {
+
+  GlobalTileCache & gtc = GlobalTileCache::get_instance();
+  gtc.reset_statistics();
+
+  // four tiles of size 256x256
+  TileImage_GS_BYTE_shptr img(new TileImage_GS_BYTE(512, 512, 8));
+
+  img->set_pixel(0, 0, 23);
+  img->set_pixel(300, 0, 42);
+  CPPUNIT_ASSERT(img->get_pixel(0, 0) == 23);
+  CPPUNIT_ASSERT(img->get_pixel(300, 0) == 42);
+
+  TileCacheStatistics s = gtc.get_statistics();
+  CPPUNIT_ASSERT(s.misses == 2);
+  CPPUNIT_ASSERT(s.hits == 2);
+  CPPUNIT_ASSERT(s.allocated_memory <= s.max_cache_memory);
+
+  size_t tiles_before = s.tiles;
+  img.reset();
+
+  // destroying an image releases its tiles
+  s = gtc.get_statistics();
+  CPPUNIT_ASSERT(s.tiles == tiles_before - 2);
+}
+
+void TileCacheTest::test_alternating_images(void) {
+
+  GlobalTileCache & gtc = GlobalTileCache::get_instance();
+
+  // single tiles of size 256x256
+  TileImage_GS_DOUBLE_shptr src(new TileImage_GS_DOUBLE(256, 256, 8));
+  TileImage_GS_DOUBLE_shptr dst(new TileImage_GS_DOUBLE(256, 256, 8));
+  src->set_pixel(0, 0, 1);
+  dst->set_pixel(0, 0, 1);
+
+  gtc.reset_statistics();
+
+  // Reading from one image and writing to another one, as normalize()
+  // does, must not look up the tiles per pixel.
+  for(unsigned int y = 0; y < 256; y++)
+    for(unsigned int x = 0; x < 256; x++)
+      dst->set_pixel(x, y, src->get_pixel(x, y) + 1);
+
+  TileCacheStatistics s = gtc.get_statistics();
+  CPPUNIT_ASSERT(s.hits + s.misses <= 2);
+  CPPUNIT_ASSERT(dst->get_pixel(0, 0) == 2);
+}
+
+void TileCacheTest::test_recreated_images(void) {
+
+  // A new image may get the address of a destroyed one. The thread's
+  // tile handle must not return the old tile for it.
+  for(unsigned int i = 0; i < 16; i++) {
+    TileImage_GS_BYTE_shptr img(new TileImage_GS_BYTE(64, 64, 6));
+    img->set_pixel(10, 10, i);
+    CPPUNIT_ASSERT(img->get_pixel(10, 10) == i);
+    CPPUNIT_ASSERT(img->get_pixel(11, 10) == 0);
+  }
+}
+
+static void read_alternating(TileImage_GS_BYTE_shptr a, TileImage_GS_BYTE_shptr b,
+			     unsigned int * errors) {
+  for(unsigned int y = 0; y < a->get_height(); y++)
+    for(unsigned int x = 0; x < a->get_width(); x++) {
+      if(a->get_pixel(x, y) != (x & 0xff)) (*errors)++;
+      if(b->get_pixel(x, y) != (y & 0xff)) (*errors)++;
+    }
+}
+
+void TileCacheTest::test_parallel_alternating_images(void) {
+
+  // 4x4 tiles of size 128x128
+  TileImage_GS_BYTE_shptr a(new TileImage_GS_BYTE(512, 512, 7));
+  TileImage_GS_BYTE_shptr b(new TileImage_GS_BYTE(512, 512, 7));
+
+  for(unsigned int y = 0; y < a->get_height(); y++)
+    for(unsigned int x = 0; x < a->get_width(); x++) {
+      a->set_pixel(x, y, x & 0xff);
+      b->set_pixel(x, y, y & 0xff);
+    }
+
+  // Each thread has its own handles for both images.
+  const unsigned int n = 4;
+  unsigned int errors[n] = { 0 };
+  boost::thread_group threads;
+
+  for(unsigned int i = 0; i < n; i++)
+    threads.create_thread(boost::bind(read_alternating, a, b, &errors[i]));
+  threads.join_all();
+
+  for(unsigned int i = 0; i < n; i++)
+    CPPUNIT_ASSERT(errors[i] == 0);
+}
+
+static void read_rows(TileImage_GS_BYTE_shptr img, unsigned int first_row, unsigned int step,
+		      unsigned int * errors) {
+  for(unsigned int y = first_row; y < img->get_height(); y += step)
+    for(unsigned int x = 0; x < img->get_width(); x++)
+      if(img->get_pixel(x, y) != ((x + y) & 0xff)) (*errors)++;
+}
+
+void TileCacheTest::test_parallel_access(void) {
+
+  TileImage_GS_BYTE_shptr img(new TileImage_GS_BYTE(1024, 1024, 7));
+
+  for(unsigned int y = 0; y < img->get_height(); y++)
+    for(unsigned int x = 0; x < img->get_width(); x++)
+      img->set_pixel(x, y, (x + y) & 0xff);
+
+  const unsigned int n = 4;
+  unsigned int errors[n] = { 0 };
+  boost::thread_group threads;
+
+  for(unsigned int i = 0; i < n; i++)
+    threads.create_thread(boost::bind(read_rows, img, i, n, &errors[i]));
+  threads.join_all();
+
+  for(unsigned int i = 0; i < n; i++)
+    CPPUNIT_ASSERT(errors[i] == 0);
+}
+
+void TileCacheTest::test_compressed_tiles(void) {
+
+  std::string dir = create_temp_directory();
+
+  // 3x2 tiles of size 64x64, the last row and column are partially used
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    CPPUNIT_ASSERT(img->get_tile_storage() == MAP_STORAGE_TYPE_COMPRESSED_FILE);
+
+    for(unsigned int y = 0; y < 100; y++)
+      for(unsigned int x = 0; x < 150; x++)
+	img->set_pixel(x, y, MERGE_CHANNELS(x, y, (x ^ y), 255));
+  }
+
+  // Modified tiles are written back, when the image is destroyed.
+  CPPUNIT_ASSERT(file_exists(join_pathes(dir, "2_1.dtz")));
+  CPPUNIT_ASSERT(!file_exists(join_pathes(dir, "2_1.dat")));
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    for(unsigned int y = 0; y < 100; y++)
+      for(unsigned int x = 0; x < 150; x++)
+	CPPUNIT_ASSERT(img->get_pixel(x, y) == MERGE_CHANNELS(x, y, (x ^ y), 255));
+
+    img->set_pixel(10, 10, 0);
+    img->sync();
+  }
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    CPPUNIT_ASSERT(img->get_pixel(10, 10) == 0U);
+    CPPUNIT_ASSERT(img->get_pixel(11, 10) == MERGE_CHANNELS(11, 10, (11 ^ 10), 255));
+
+    // Writes via tile views mark the tile as modified, too.
+    rgba_pixel_t row[4] = { 1, 2, 3, 4 };
+    write_row<rgba_pixel_t>(img, 20, 70, 4, row);
+  }
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    CPPUNIT_ASSERT(img->get_pixel(20, 70) == 1U);
+    CPPUNIT_ASSERT(img->get_pixel(23, 70) == 4U);
+  }
+
+  remove_directory(dir);
+}
+
+void TileCacheTest::test_corrupted_compressed_tile(void) {
+
+  std::string dir = create_temp_directory();
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(64, 64, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    for(unsigned int y = 0; y < 64; y++)
+      for(unsigned int x = 0; x < 64; x++)
+	img->set_pixel(x, y, MERGE_CHANNELS(x, y, (x * y), 255));
+  }
+
+  // Cut the tile file within the compressed data.
+  std::string filename = join_pathes(dir, "0_0.dtz");
+  CPPUNIT_ASSERT(truncate(filename.c_str(), 40) == 0);
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(64, 64, dir, true, 6,
+						  MAP_STORAGE_TYPE_COMPRESSED_FILE));
+    CPPUNIT_ASSERT_THROW(img->get_pixel(0, 0), DegateRuntimeException);
+  }
+
+  remove_directory(dir);
+}
+
+void TileCacheTest::test_pack_file(void) {
+
+  std::string dir = create_temp_directory();
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_PACK_FILE));
+    CPPUNIT_ASSERT(img->get_tile_storage() == MAP_STORAGE_TYPE_PACK_FILE);
+    CPPUNIT_ASSERT(img->get_pack_file() != NULL);
+
+    for(unsigned int y = 0; y < 100; y++)
+      for(unsigned int x = 0; x < 150; x++)
+	img->set_pixel(x, y, MERGE_CHANNELS(x, y, (x ^ y), 255));
+
+    // The prescaled images are stored in the pack file, too.
+    ScalingManager<BackgroundImage> sm(img, dir, 32);
+    sm.create_scalings();
+    CPPUNIT_ASSERT(img->get_pack_file()->is_level_valid(1));
+    CPPUNIT_ASSERT(img->get_pack_file()->is_level_valid(2));
+
+    BackgroundImage_shptr half = sm.get_image(2).second;
+    CPPUNIT_ASSERT(half->get_pack_file() == img->get_pack_file());
+    CPPUNIT_ASSERT(MASK_A(half->get_pixel(74, 49)) == 255);
+  }
+
+  CPPUNIT_ASSERT(file_exists(join_pathes(dir, "tiles.pack")));
+  CPPUNIT_ASSERT(!file_exists(join_pathes(dir, "2_1.dat")));
+  CPPUNIT_ASSERT(!file_exists(join_pathes(dir, "scaling_2.dimg")));
+
+  {
+    BackgroundImage_shptr img(new BackgroundImage(150, 100, dir, true, 6,
+						  MAP_STORAGE_TYPE_PACK_FILE));
+    for(unsigned int y = 0; y < 100; y++)
+      for(unsigned int x = 0; x < 150; x++)
+	CPPUNIT_ASSERT(img->get_pixel(x, y) == MERGE_CHANNELS(x, y, (x ^ y), 255));
+    CPPUNIT_ASSERT(img->get_pack_file()->is_level_valid(1));
+  }
+
+  // A pack file for a different geometry is rejected.
+  CPPUNIT_ASSERT_THROW(BackgroundImage(200, 100, dir, true, 6, MAP_STORAGE_TYPE_PACK_FILE),
+		       InvalidFileFormatException);
+
+  remove_directory(dir);
+}
+
+void TileCacheTest::test_prefetch(void) {
+
+  if(!TilePrefetcher::get_instance().is_enabled()) return;
+
+  std::string dir = create_temp_directory();
+
+  // 8x4 tiles of size 64x64
+  {
+    BackgroundImage_shptr img(new BackgroundImage(512, 256, dir, true, 6));
+    for(unsigned int y = 0; y < 256; y++)
+      for(unsigned int x = 0; x < 512; x++)
+	img->set_pixel(x, y, x + y);
+  }
+
+  GlobalTileCache & gtc = GlobalTileCache::get_instance();
+
+  // Prefetch a region explicitly.
+  {
+    BackgroundImage_shptr img(new BackgroundImage(512, 256, dir, true, 6));
+    gtc.reset_statistics();
+
+    img->prefetch(0, 128, 0, 128);
+    TilePrefetcher::get_instance().wait();
+    CPPUNIT_ASSERT_EQUAL((uint64_t)4, gtc.get_statistics().prefetches);
+
+    for(unsigned int y = 0; y < 128; y++)
+      for(unsigned int x = 0; x < 128; x++)
+	CPPUNIT_ASSERT(img->get_pixel(x, y) == x + y);
+
+    TileCacheStatistics s = gtc.get_statistics();
+    CPPUNIT_ASSERT_EQUAL((uint64_t)4, s.prefetch_hits);
+    CPPUNIT_ASSERT_EQUAL((uint64_t)0, s.misses);
+    CPPUNIT_ASSERT(s.get_prefetch_hit_rate() > 0);
+  }
+
+  // A scan in raster order triggers prefetching of the next tiles.
+  {
+    BackgroundImage_shptr img(new BackgroundImage(512, 256, dir, true, 6));
+    gtc.reset_statistics();
+
+    for(unsigned int x = 0; x < 512; x++) {
+      CPPUNIT_ASSERT(img->get_pixel(x, 0) == x);
+      if(x == 64) TilePrefetcher::get_instance().wait();
+    }
+
+    TileCacheStatistics s = gtc.get_statistics();
+    CPPUNIT_ASSERT(s.prefetches >= 4);
+    CPPUNIT_ASSERT(s.prefetch_hits >= 4);
+  }
+
+  remove_directory(dir);
+}
@@ -0,0 +1,64 @@
+/* -*-c++-*-
+ 
+ This file is part of the IC reverse engineering tool degate.
+ 
+ Copyright 2008, 2009, 2010 by Martin Schobert
+ 
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+#ifndef __TILECACHETEST_H__
+#define __TILECACHETEST_H__
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <memory>
+
+#include <Image.h>
+
+class TileCacheTest : public CPPUNIT_NS :: TestFixture {
+  
+  CPPUNIT_TEST_SUITE(TileCacheTest);
+  
+  CPPUNIT_TEST (test_statistics);
+  CPPUNIT_TEST (test_alternating_images);
+  CPPUNIT_TEST (test_recreated_images);
+  CPPUNIT_TEST (test_parallel_alternating_images);
+  CPPUNIT_TEST (test_parallel_access);
+  CPPUNIT_TEST (test_compressed_tiles);
+  CPPUNIT_TEST (test_corrupted_compressed_tile);
+  CPPUNIT_TEST (test_pack_file);
+  CPPUNIT_TEST (test_prefetch);
+  
+  CPPUNIT_TEST_SUITE_END ();
+  
+public:
+  void setUp (void);
+  void tearDown (void);
+  
+protected:
+  void test_statistics(void);
+  void test_alternating_images(void);
+  void test_recreated_images(void);
+  void test_parallel_alternating_images(void);
+  void test_parallel_access(void);
+  void test_compressed_tiles(void);
+  void test_corrupted_compressed_tile(void);
+  void test_pack_file(void);
+  void test_prefetch(void);
+  
+};
+
+#endif
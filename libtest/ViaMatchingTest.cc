@@ -0,0 +1,163 @@
+/*
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "ViaMatchingTest.h"
+#include "ViaMatching.h"
+#include "Project.h"
+#include "LogicModel.h"
+#include "LogicModelHelper.h"
+#include "ImageStatistics.h"
+#include "FileSystem.h"
+
+#include "globals.h"
+#include <map>
+#include <cmath>
+#include <boost/foreach.hpp>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (ViaMatchingTest);
+
+using namespace std;
+using namespace degate;
+
+static const unsigned int project_width = 96, project_height = 80;
+
+static const unsigned int via_diameter = 9;
+
+static const unsigned int via_positions[][2] = { { 20, 20 }, { 60, 25 }, { 30, 55 }, { 75, 60 } };
+
+/**
+ * Get the grey value of the background. Vias are bright disks on a
+ * texture with blocks of 2x2 pixels.
+ */
+static unsigned int get_background(unsigned int x, unsigned int y) {
+
+  for(unsigned int i = 0; i < sizeof(via_positions) / sizeof(via_positions[0]); i++) {
+    int dx = (int)x - (int)via_positions[i][0], dy = (int)y - (int)via_positions[i][1];
+    if(dx * dx + dy * dy <= 16) return 230;
+  }
+
+  uint32_t h = (x / 2) * 73856093U ^ (y / 2) * 19349663U;
+  h ^= h >> 13;
+  h *= 0x5bd1e995U;
+  h ^= h >> 15;
+  return 80 + (h & 0x3f);
+}
+
+/**
+ * Calculate the correlation at a position pixel by pixel, as the via
+ * matching did before it used summation tables.
+ */
+static double calc_xcorr_per_pixel(BackgroundImage_shptr bg_img,
+				   MemoryImage_GS_BYTE_shptr tmpl_img,
+				   unsigned int start_x, unsigned int start_y) {
+
+  const unsigned int w = tmpl_img->get_width(), h = tmpl_img->get_height();
+  double f_avg, sigma_f, t_avg, sigma_t;
+  average_and_stddev(bg_img, start_x, start_y, w, h, &f_avg, &sigma_f);
+  average_and_stddev(tmpl_img, 0, 0, w, h, &t_avg, &sigma_t);
+
+  double sum = 0;
+  for(unsigned int y = 0; y < h; y++)
+    for(unsigned int x = 0; x < w; x++) {
+      double f_xy = bg_img->get_pixel_as<double>(start_x + x, start_y + y);
+      double t_xy = tmpl_img->get_pixel_as<double>(x, y);
+      sum += (f_xy - f_avg) * (t_xy - t_avg) / (sigma_f * sigma_t);
+    }
+
+  return sum / (w * h - 1);
+}
+
+
+void ViaMatchingTest::setUp(void) {
+}
+
+void ViaMatchingTest::tearDown(void) {
+}
+
+void ViaMatchingTest::test_correlation(void) {
+
+  std::string dir = create_temp_directory();
+
+  Project_shptr project(new Project(project_width, project_height, dir));
+  LogicModel_shptr lmodel = project->get_logic_model();
+
+  BackgroundImage_shptr bg(new BackgroundImage(project_width, project_height,
+					       join_pathes(dir, "layer_0.dimg")));
+  for(unsigned int y = 0; y < project_height; y++)
+    for(unsigned int x = 0; x < project_width; x++) {
+      unsigned int grey = get_background(x, y);
+      bg->set_pixel(x, y, MERGE_CHANNELS(grey, grey, grey, 255));
+    }
+
+  Layer_shptr layer(new Layer(project->get_bounding_box(), Layer::METAL));
+  lmodel->add_layer(0, layer);
+  layer->set_image(bg);
+  lmodel->set_current_layer(0);
+
+  // The first via is the template for the others.
+  const unsigned int via_x = via_positions[0][0], via_y = via_positions[0][1];
+  lmodel->add_object(layer, Via_shptr(new Via(via_x, via_y, via_diameter, Via::DIRECTION_UP)));
+
+  const double threshold = 0.7;
+
+  ViaMatching matching;
+  matching.set_diameter(via_diameter);
+  matching.set_merge_n_vias(0);
+  matching.set_threshold_match(threshold);
+  matching.init(project->get_bounding_box(), project);
+  matching.run();
+
+  // The via matching grabs the template around the placed via.
+  const int r = (via_diameter + 1) / 2;
+  MemoryImage_shptr via_img =
+    grab_image<MemoryImage>(lmodel, layer, BoundingBox(via_x - r, via_x + r, via_y - r, via_y + r));
+  MemoryImage_GS_BYTE_shptr tmpl_img(new MemoryImage_GS_BYTE(via_img->get_width(),
+							      via_img->get_height()));
+  copy_image(tmpl_img, via_img);
+
+  std::map<std::pair<unsigned int, unsigned int>, double> expected;
+  for(unsigned int y = 0; y < project_height - tmpl_img->get_height(); y++)
+    for(unsigned int x = 0; x < project_width - tmpl_img->get_width(); x++) {
+      double corr = calc_xcorr_per_pixel(bg, tmpl_img, x, y);
+      if(corr > threshold) expected[std::make_pair(x, y)] = corr;
+    }
+
+  std::list<ViaMatching::match_found> const& matches = matching.get_matches();
+
+  CPPUNIT_ASSERT(expected.size() >= sizeof(via_positions) / sizeof(via_positions[0]));
+  CPPUNIT_ASSERT(matches.size() == expected.size());
+
+  BOOST_FOREACH(ViaMatching::match_found const& m, matches) {
+    std::map<std::pair<unsigned int, unsigned int>, double>::const_iterator found =
+      expected.find(std::make_pair(m.x, m.y));
+    CPPUNIT_ASSERT(found != expected.end());
+    CPPUNIT_ASSERT(fabs(found->second - m.correlation) < 1e-9);
+  }
+
+  // A via is added for each of the other disks.
+  unsigned int vias = 0;
+  for(LogicModel::via_collection::iterator iter = lmodel->vias_begin();
+      iter != lmodel->vias_end(); ++iter) vias++;
+  CPPUNIT_ASSERT(vias == sizeof(via_positions) / sizeof(via_positions[0]));
+
+  remove_directory(dir);
+}
@@ -0,0 +1,138 @@
+/*
+ 
+ This file is part of the IC reverse engineering tool degate.
+ 
+ Copyright 2008, 2009 by Martin Schobert
+ 
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+ 
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+ 
+*/
+
+#include "WorkerThreadsTest.h"
+#include <WorkerThreads.h>
+#include <Image.h>
+#include <IPPipe.h>
+#include <ImageProcessorBase.h>
+#include <degate_exceptions.h>
+
+#include <stdlib.h>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION (WorkerThreadsTest);
+
+using namespace std;
+using namespace degate;
+
+void WorkerThreadsTest::setUp(void) { 
+  // Several workers run in parallel.
+  setenv("DEGATE_THREADS", "4", 1);
+}
+
+void WorkerThreadsTest::tearDown(void) {
+  unsetenv("DEGATE_THREADS");
+}
+
+static void count_call(vector<unsigned int> & calls, size_t i) {
+  calls[i]++;
+}
+
+static void throw_at(size_t failing, size_t i) {
+  if(i == failing) throw DegateRuntimeException("Worker failed.");
+}
+
+void WorkerThreadsTest::test_run_parallel(void) {
+
+  for(unsigned int n = 0; n <= 5; n++) {
+    vector<unsigned int> calls(n, 0);
+    run_parallel(n, boost::bind(&count_call, boost::ref(calls), _1));
+
+    for(unsigned int i = 0; i < n; i++)
+      CPPUNIT_ASSERT(calls[i] == 1);
+  }
+}
+
+void WorkerThreadsTest::test_run_parallel_for(void) {
+
+  vector<unsigned int> calls(1000, 0);
+  run_parallel_for(4, calls.size(), boost::bind(&count_call, boost::ref(calls), _1));
+
+  for(size_t i = 0; i < calls.size(); i++)
+    CPPUNIT_ASSERT(calls[i] == 1);
+
+  // There are more threads than items.
+  vector<unsigned int> few(3, 0);
+  run_parallel_for(8, few.size(), boost::bind(&count_call, boost::ref(few), _1));
+  CPPUNIT_ASSERT(few[0] == 1 && few[1] == 1 && few[2] == 1);
+
+  run_parallel_for(4, 0, boost::bind(&throw_at, 0, _1));
+}
+
+void WorkerThreadsTest::test_worker_exception(void) {
+
+  // The exception is passed on with its type, from a single worker and from several.
+  CPPUNIT_ASSERT_THROW(run_parallel(1, boost::bind(&throw_at, 0, _1)), DegateRuntimeException);
+  CPPUNIT_ASSERT_THROW(run_parallel(4, boost::bind(&throw_at, 2, _1)), DegateRuntimeException);
+
+  for(unsigned int threads = 1; threads <= 4; threads++)
+    CPPUNIT_ASSERT_THROW(run_parallel_for(threads, 1000, boost::bind(&throw_at, 500, _1)),
+			 DegateRuntimeException);
+
+  CPPUNIT_ASSERT_NO_THROW(run_parallel_for(4, 500, boost::bind(&throw_at, 500, _1)));
+}
+
+
+/**
+ * A streamable processor, that copies its input and fails at a row.
+ */
+class FailingProcessor : public TypedImageProcessor<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE> {
+
+private:
+
+  unsigned int failing_row;
+
+public:
+
+  FailingProcessor(unsigned int failing_row) :
+    TypedImageProcessor<TileImage_GS_DOUBLE, TileImage_GS_DOUBLE>("Failing", "", false),
+    failing_row(failing_row) {}
+
+  virtual ImageBase_shptr run(ImageBase_shptr in) {
+    return in;
+  }
+
+  virtual bool is_streamable() const {
+    return true;
+  }
+
+  virtual void process_row(std::vector<double const *> const& in, unsigned int y,
+			   unsigned int in_width, unsigned int in_height,
+			   unsigned int out_width, double * out,
+			   std::vector<double> & scratch) const {
+    if(y == failing_row) throw DegateRuntimeException("Processing failed.");
+    for(unsigned int x = 0; x < out_width; x++) out[x] = in[0][x];
+  }
+};
+
+void WorkerThreadsTest::test_exception_in_pipe(void) {
+
+  TileImage_GS_DOUBLE_shptr img(new TileImage_GS_DOUBLE(200, 500));
+
+  IPPipe pipe;
+  pipe.add(ImageProcessorBase_shptr(new FailingProcessor(450)));
+  CPPUNIT_ASSERT_THROW(pipe.run(img), DegateRuntimeException);
+
+  IPPipe good_pipe;
+  good_pipe.add(ImageProcessorBase_shptr(new FailingProcessor(500)));
+  CPPUNIT_ASSERT_NO_THROW(good_pipe.run(img));
+}
@@ -29,6 +29,7 @@
 #include "FileSystemTest.h"
 #include "ShapeTest.h"
 #include "MemoryMapTest.h"
+#include "TileCacheTest.h"
 #include "ImageTest.h"
 #include "QuadTreeTest.h"
 #include "LMOinQTreeTest.h"
@@ -41,8 +42,14 @@
 #include "ProjectExporterTest.h"
 #include "LogicModelDOTExporterTest.h"
 #include "ScalingManagerTest.h"
+#include "TemplateMatchingTest.h"
+#include "ViaMatchingTest.h"
+#include "BinaryLineDetectionTest.h"
+#include "IPPipeTest.h"
+#include "FilterKernelTest.h"
 #include "ImageProcessingTest.h"
 #include "LookupSubcircuitTest.h"
+#include "WorkerThreadsTest.h"
 
 using namespace degate;
 
@@ -63,8 +70,7 @@ int main(void) {
   // Test-Suite ueber die Registry im Test-Runner einfuegen
   CPPUNIT_NS :: TestRunner testrunner;
 
-  /*
-  testrunner.addTest(FileSystemTest::suite());
+  //testrunner.addTest(FileSystemTest::suite());
   //testrunner.addTest(ShapeTest::suite());
   testrunner.addTest(MemoryMapTest::suite());
   testrunner.addTest(ImageTest::suite());
@@ -73,6 +79,7 @@ int main(void) {
   testrunner.addTest(LogicModelTest::suite());
   testrunner.addTest(LMOinQTreeTest::suite());
 
+  /*
   testrunner.addTest(GateLibraryImporterTest::suite());
   testrunner.addTest(LogicModelImporterTest::suite());
   testrunner.addTest(ProjectImporterTest::suite());
@@ -82,12 +89,20 @@ int main(void) {
   testrunner.addTest(ProjectExporterTest::suite());
   
   testrunner.addTest(LogicModelDOTExporterTest::suite());
+  */
+
   testrunner.addTest(ScalingManagerTest::suite());
+  testrunner.addTest(TemplateMatchingTest::suite());
+  testrunner.addTest(ViaMatchingTest::suite());
+  testrunner.addTest(BinaryLineDetectionTest::suite());
+  testrunner.addTest(IPPipeTest::suite());
+  testrunner.addTest(FilterKernelTest::suite());
 
   //  testrunner.addTest(ImageProcessingTest::suite());
-  */
 
   testrunner.addTest(LookupSubcircuitTest::suite());
+  testrunner.addTest(TileCacheTest::suite());
+  testrunner.addTest(WorkerThreadsTest::suite());
 
   testrunner.run(testresult);
 
@@ -0,0 +1,88 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <ProjectImporter.h>
+#include <ProjectExporter.h>
+#include <Project.h>
+#include <LogicModelHelper.h>
+
+#include <string>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+using namespace boost::program_options;
+using namespace degate;
+
+
+/**
+ * Main program. Convert the background images of a project into raw tiles,
+ * compressed tiles or a pack file.
+ */
+
+int main(int argc, char ** argv) {
+
+  // Parse program options.
+
+  options_description desc("Options");
+  desc.add_options()
+    ("help", "Show help message.")
+    ("project-dir", value<std::string>(), "Directory of the project to convert.")
+    ("format", value<std::string>(), "Tile format. Either 'raw', 'compressed' or 'pack'.")
+    ;
+
+  variables_map vm;
+  store(parse_command_line(argc, argv, desc), vm);
+  notify(vm);
+
+  if(vm.count("help") || vm.empty() ||
+     !vm.count("project-dir") ||
+     !vm.count("format")) {
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  MAP_STORAGE_TYPE tile_storage;
+  std::string format = vm["format"].as<std::string>();
+  if(format == "raw") tile_storage = MAP_STORAGE_TYPE_PERSISTENT_FILE;
+  else if(format == "compressed") tile_storage = MAP_STORAGE_TYPE_COMPRESSED_FILE;
+  else if(format == "pack") tile_storage = MAP_STORAGE_TYPE_PACK_FILE;
+  else {
+    std::cout << "Unknown tile format " << format << ".\n\n" << desc << std::endl;
+    return 1;
+  }
+
+  // Import project.
+
+  std::string project_dir = vm["project-dir"].as<std::string>();
+  ProjectImporter importer;
+  Project_shptr prj(importer.import_all(project_dir));
+
+  std::cout << "Converting background images into " << format << " tiles.\n";
+  convert_background_images(prj, tile_storage);
+
+  // Store the new tile format in the project file.
+  ProjectExporter exporter;
+  exporter.export_all(prj->get_project_directory(), prj, false);
+
+  std::cout << "Done.\n";
+  return 0;
+}
@@ -0,0 +1,138 @@
+/* -*-c++-*-
+
+ This file is part of the IC reverse engineering tool degate.
+
+ Copyright 2008, 2009, 2010 by Martin Schobert
+
+ Degate is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ any later version.
+
+ Degate is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with degate. If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <PixelKernels.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+
+using namespace boost::program_options;
+using namespace degate;
+
+
+/**
+ * Run a kernel \p iterations times and return the throughput in GB/s.
+ * The throughput is calculated from the number of bytes, that are read
+ * and written.
+ */
+
+template<typename F>
+double measure(F f, unsigned int iterations, double bytes) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(unsigned int i = 0; i < iterations; i++) f();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return bytes * iterations / elapsed.count() / 1e9;
+}
+
+
+/**
+ * Main program.
+ */
+
+int main(int argc, char ** argv) {
+
+  // Parse program options.
+
+  options_description desc("Options");
+  desc.add_options()
+    ("help", "Show help message.")
+    ("tile-size", value<unsigned int>()->default_value(1024), "Edge length of the processed tile in pixels.")
+    ("iterations", value<unsigned int>()->default_value(200), "Number of iterations per kernel.")
+    ;
+
+  variables_map vm;
+  store(parse_command_line(argc, argv, desc), vm);
+  notify(vm);
+
+  if(vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 1;
+  }
+
+  const unsigned int tile_size = vm["tile-size"].as<unsigned int>();
+  const unsigned int iterations = vm["iterations"].as<unsigned int>();
+  const size_t n = tile_size * tile_size;
+
+  std::vector<rgba_pixel_t> src(n);
+  for(size_t i = 0; i < n; i++) src[i] = rand();
+
+  std::vector<gs_byte_pixel_t> dst_byte(n);
+  std::vector<gs_double_pixel_t> dst_double(n);
+  std::vector<rgba_pixel_t> dst_rgba(n / 4);
+
+  std::vector<gs_byte_pixel_t> src_byte(n);
+  std::vector<double> src_double(n);
+  for(size_t i = 0; i < n; i++) {
+    src_byte[i] = rand() & 0xff;
+    src_double[i] = (double)rand() / RAND_MAX;
+  }
+
+  // Results of the dot products, so that they are not optimized away.
+  volatile uint64_t dot_sink = 0;
+
+  std::cout << boost::format("%1% x %2% pixels, %3% iterations, selected kernels: %4%")
+    % tile_size % tile_size % iterations % get_pixel_kernels().name << std::endl;
+
+  std::vector<PixelKernels const*> kernels = get_supported_pixel_kernels();
+
+  for(std::vector<PixelKernels const*>::const_iterator iter = kernels.begin();
+      iter != kernels.end(); ++iter) {
+
+    PixelKernels const& k = **iter;
+
+    double gs_byte = measure([&]() { k.rgba_to_gs_byte(&src[0], &dst_byte[0], n); },
+			     iterations, n * (sizeof(rgba_pixel_t) + sizeof(gs_byte_pixel_t)));
+
+    double gs_double = measure([&]() { k.rgba_to_gs_double(&src[0], &dst_double[0], n); },
+			       iterations, n * (sizeof(rgba_pixel_t) + sizeof(gs_double_pixel_t)));
+
+    // Each pair of rows is scaled down into a single row of half width.
+    double average = measure([&]() {
+	for(unsigned int y = 0; y + 1 < tile_size; y += 2)
+	  k.average_rgba_2x2(&src[y * tile_size], &src[(y + 1) * tile_size],
+			     &dst_rgba[y / 2 * (tile_size / 2)], tile_size / 2);
+      }, iterations, n * sizeof(rgba_pixel_t) * 5 / 4);
+
+    // The template rows of the correlation are dot products of byte rows.
+    double dot_product = measure([&]() {
+	uint64_t sum_a = 0;
+	dot_sink = dot_sink + k.dot_product_gs_byte(&src_byte[0], &dst_byte[0], n, &sum_a) + sum_a;
+      }, iterations, n * 2 * sizeof(gs_byte_pixel_t));
+
+    // The separable convolution accumulates scaled rows. The destination
+    // is read and written.
+    double add_scaled = measure([&]() { k.add_scaled_double(&src_double[0], 1e-3, &dst_double[0], n); },
+				iterations, n * 3 * sizeof(double));
+
+    std::cout << boost::format("%1$-8s rgba->gs_byte %2$6.2f GB/s  rgba->gs_double %3$6.2f GB/s  2x2 average %4$6.2f GB/s")
+      % k.name % gs_byte % gs_double % average << std::endl
+	      << boost::format("%1$-8s dot product   %2$6.2f GB/s  add scaled      %3$6.2f GB/s")
+      % "" % dot_product % add_scaled << std::endl;
+  }
+
+  return 0;
+}